@@ -5,11 +5,15 @@ in vec2 TexCoords;
 
 uniform sampler2D scene;
 uniform sampler2D bloomBlur;
+// part of the texture covered by the (dynamic resolution) viewport
+uniform vec2 renderScale = vec2(1.0);
 
 void main()
 {             
-    vec3 sceneColor = texture(scene, TexCoords).rgb;   
-    vec3 bloomColor = texture(bloomBlur, TexCoords).rgb;
+    // bilinear upscale, without filtering in texels outside the rendered part
+    vec2 coords = min(TexCoords, renderScale - 0.5 / vec2(textureSize(scene, 0)));
+    vec3 sceneColor = texture(scene, coords).rgb;   
+    vec3 bloomColor = texture(bloomBlur, coords).rgb;
 
     float exposure = 2.2f;
     vec3 total_color = sceneColor + bloomColor;
@@ -4,9 +4,12 @@ layout (location = 1) in vec2 aTexCoords;
 
 out vec2 TexCoords;
 
+// part of the texture covered by the (dynamic resolution) viewport, stretched to the whole screen
+uniform vec2 renderScale = vec2(1.0);
+
 void main()
 {
-    TexCoords = aTexCoords;
+    TexCoords = aTexCoords * renderScale;
     // Render on the screen -> z = 0.0
     gl_Position = vec4(aPos.x, aPos.y, 0.0, 1.0);
 }
\ No newline at end of file
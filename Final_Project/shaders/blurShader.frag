@@ -6,6 +6,8 @@ in vec2 TexCoords;
 uniform sampler2D image;
 
 uniform bool horizontal;
+// part of the texture covered by the (dynamic resolution) viewport
+uniform vec2 renderScale = vec2(1.0);
 // gauss weight
 uniform float weight[5] = float[] (0.2270270270, 0.1945945946, 0.1216216216, 0.0540540541, 0.0162162162);
 
@@ -13,22 +15,25 @@ void main()
 {             
      vec2 tex_offset = 1.0 / textureSize(image, 0); // gets size of single texel
      vec3 result = texture(image, TexCoords).rgb * weight[0];
+     // don't sample outside the rendered part of the texture
+     vec2 minCoord = tex_offset * 0.5;
+     vec2 maxCoord = renderScale - tex_offset * 0.5;
 
      // Start from this fragment, sample the fragment on the same row/column, and mix them with gauss weight
      if(horizontal)
      {
          for(int i = 1; i < 5; ++i)
          {
-            result += texture(image, TexCoords + vec2(tex_offset.x * i, 0.0)).rgb * weight[i];
-            result += texture(image, TexCoords - vec2(tex_offset.x * i, 0.0)).rgb * weight[i];
+            result += texture(image, clamp(TexCoords + vec2(tex_offset.x * i, 0.0), minCoord, maxCoord)).rgb * weight[i];
+            result += texture(image, clamp(TexCoords - vec2(tex_offset.x * i, 0.0), minCoord, maxCoord)).rgb * weight[i];
          }
      }
      else
      {
          for(int i = 1; i < 5; ++i)
          {
-             result += texture(image, TexCoords + vec2(0.0, tex_offset.y * i)).rgb * weight[i];
-             result += texture(image, TexCoords - vec2(0.0, tex_offset.y * i)).rgb * weight[i];
+             result += texture(image, clamp(TexCoords + vec2(0.0, tex_offset.y * i), minCoord, maxCoord)).rgb * weight[i];
+             result += texture(image, clamp(TexCoords - vec2(0.0, tex_offset.y * i), minCoord, maxCoord)).rgb * weight[i];
          }
      }
      FragColor = vec4(result, 1.0);
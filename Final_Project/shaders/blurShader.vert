@@ -4,8 +4,11 @@ layout (location = 1) in vec2 aTexCoords;
 
 out vec2 TexCoords;
 
+// part of the texture covered by the (dynamic resolution) viewport
+uniform vec2 renderScale = vec2(1.0);
+
 void main()
 {
-    TexCoords = aTexCoords;
+    TexCoords = aTexCoords * renderScale;
     gl_Position = vec4(aPos, 1.0);
 }
\ No newline at end of file
@@ -0,0 +1,46 @@
+// Point shadow with PCF (percentage-closer filtering), included by pointShadowShader.frag
+// PCF_TAPS: number of samples around the fragment (1-20)
+#ifndef PCF_TAPS
+#define PCF_TAPS 20
+#endif
+
+uniform samplerCube shadowMap;
+uniform float far_plane;
+
+vec3 sampleOffsetDirections[20] = vec3[]
+(
+   vec3( 1,  1,  1), vec3( 1, -1,  1), vec3(-1, -1,  1), vec3(-1,  1,  1), 
+   vec3( 1,  1, -1), vec3( 1, -1, -1), vec3(-1, -1, -1), vec3(-1,  1, -1),
+   vec3( 1,  1,  0), vec3( 1, -1,  0), vec3(-1, -1,  0), vec3(-1,  1,  0),
+   vec3( 1,  0,  1), vec3(-1,  0,  1), vec3( 1,  0, -1), vec3(-1,  0, -1),
+   vec3( 0,  1,  1), vec3( 0, -1,  1), vec3( 0, -1, -1), vec3( 0,  1, -1)
+);
+
+// ratio of the samples in the shadow (0: lit, 1: in the shadow)
+float pointShadow(vec3 fragPos, vec3 lightPos)
+{
+    // use vector between fragment position(in camera-view) and light position to sample the cubemap
+    vec3 fragToLight = fragPos - lightPos;
+
+    // Compare the distance between light and fragment position under camera-view with that under light-view
+    float cameraViewDepth = length(fragToLight);
+
+    // Add the bias preventing from stripe
+    // Note that the bias should be large enough since the depth is in [0, far_plane] rather than [0, 1]
+    float bias = 0.35;
+    float diskRadius = 0.05;
+    float shadow = 0.0;
+    for(int i = 0; i < PCF_TAPS; ++i)
+    {
+        // use vector between fragment position(in camera-view) and light position to sample the cubemap
+        float lightViewDepth = texture(shadowMap, fragToLight + sampleOffsetDirections[i] * diskRadius).r;
+
+        // Since we stored a normalized depth in cubemap, we use far_plane to transform it back to the original length
+        lightViewDepth *= far_plane;
+
+        // If the dis under camera-view > dis under light-view, then this fragment is in the shadow
+        if(cameraViewDepth - bias > lightViewDepth)
+            shadow += 1.0;
+    }
+    return shadow / float(PCF_TAPS);
+}
@@ -1,5 +1,10 @@
 #version 330 core
-//out vec4 FragColor;
+// One source for every lit mesh, specialized with defines (see ShaderVariants):
+//   TOON         : discretized Blinn-Phong (toon shading) instead of Blinn-Phong
+//   SHADOW       : point shadow (PCF_TAPS samples of the depth cubemap)
+//   INVISIBLE    : blend with the scene behind, part of the color goes to the bright part to blur it
+//   MESH_TEXTURE : colors from meshTexture (floor) instead of the textures of the model
+//   MATERIAL_ARRAYS : the textures of the model from texture arrays (see MaterialArrays), indexed by materialID
 layout (location = 0) out vec4 FragColor;
 layout (location = 1) out vec4 BrightColor;
 
@@ -9,35 +14,54 @@ in VS_OUT {
     vec2 TexCoords;
 } fs_in;
 
+#ifdef MESH_TEXTURE
 uniform sampler2D meshTexture;
-uniform samplerCube shadowMap;
-uniform sampler2D scene;
+#elif defined(MATERIAL_ARRAYS)
+uniform sampler2DArray materialArray0;
+uniform sampler2DArray materialArray1;
+uniform sampler2DArray materialArray2;
+uniform sampler2DArray materialArray3;
+uniform sampler2DArray materialArray4;
+uniform sampler2DArray materialArray5;
+uniform sampler2DArray materialArray6;
+uniform sampler2DArray materialArray7;
+// diffuse array & layer, specular array & layer (array -1: no texture)
+uniform ivec4 materials[64];
+uniform int materialID;
+
+// GLSL 3.30 can't index an array of samplers with a variable (the branch is the same for the whole draw)
+vec3 sampleMaterial(int array, int layer, vec2 uv)
+{
+    vec3 coords = vec3(uv, float(layer));
+    if (array == 0) return texture(materialArray0, coords).xyz;
+    if (array == 1) return texture(materialArray1, coords).xyz;
+    if (array == 2) return texture(materialArray2, coords).xyz;
+    if (array == 3) return texture(materialArray3, coords).xyz;
+    if (array == 4) return texture(materialArray4, coords).xyz;
+    if (array == 5) return texture(materialArray5, coords).xyz;
+    if (array == 6) return texture(materialArray6, coords).xyz;
+    if (array == 7) return texture(materialArray7, coords).xyz;
+    return vec3(0.0);
+}
+#else
 uniform sampler2D texture_diffuse1;
 uniform sampler2D texture_specular1;
-uniform sampler2D texture_normal1;
-
-uniform vec3 lightPos;
-uniform vec3 viewPos;
-
-uniform bool meshOrModel;
-uniform bool drawShadow;
+#endif
 
-uniform float far_plane;
+#ifdef INVISIBLE
+uniform sampler2D scene;
 uniform float invisible;
+#endif
+
+#ifdef SHADOW
+#include "pointShadowPCF.glsl"
+#endif
 
-vec3 sampleOffsetDirections[20] = vec3[]
-(
-   vec3( 1,  1,  1), vec3( 1, -1,  1), vec3(-1, -1,  1), vec3(-1,  1,  1), 
-   vec3( 1,  1, -1), vec3( 1, -1, -1), vec3(-1, -1, -1), vec3(-1,  1, -1),
-   vec3( 1,  1,  0), vec3( 1, -1,  0), vec3(-1, -1,  0), vec3(-1,  1,  0),
-   vec3( 1,  0,  1), vec3(-1,  0,  1), vec3( 1,  0, -1), vec3(-1,  0, -1),
-   vec3( 0,  1,  1), vec3( 0, -1,  1), vec3( 0, -1, -1), vec3( 0,  1, -1)
-);
+uniform vec3 lightPos;
+uniform vec3 viewPos;
 
 void main()
 {           
-    // implementing discretized Blinn-Phong model (toon shading)
-
     // strength of lights
     vec3 light = vec3(1.0f, 1.0f, 1.0f);
 
@@ -50,86 +74,73 @@ void main()
     vec3 fragNormal = fs_in.Normal;
 
     // colors (from texture)
-    vec3 diffuseColor = meshOrModel? texture(meshTexture, fs_in.TexCoords).xyz : texture(texture_diffuse1, fs_in.TexCoords).xyz;
-    vec3 specularColor = meshOrModel? texture(meshTexture, fs_in.TexCoords).xyz : texture(texture_specular1, fs_in.TexCoords).xyz;
+#ifdef MESH_TEXTURE
+    vec3 diffuseColor = texture(meshTexture, fs_in.TexCoords).xyz;
+    vec3 specularColor = diffuseColor;
+#elif defined(MATERIAL_ARRAYS)
+    ivec4 material = materials[materialID];
+    vec3 diffuseColor = sampleMaterial(material.x, material.y, fs_in.TexCoords);
+    vec3 specularColor = sampleMaterial(material.z, material.w, fs_in.TexCoords);
+#else
+    vec3 diffuseColor = texture(texture_diffuse1, fs_in.TexCoords).xyz;
+    vec3 specularColor = texture(texture_specular1, fs_in.TexCoords).xyz;
+#endif
 
     // ambient
     float ka = 0.2;
     vec3 ambient = ka * light;
     vec3 total_ambient = ambient * diffuseColor;
 
-    //diffuse
+#ifdef INVISIBLE
+    // invisible: the lighting isn't visible, only the ambient color blended with the scene behind
+    // trick: bring part of the color into brightcolor part to blur it
+    vec2 screen_coord = vec2(gl_FragCoord) / textureSize(scene, 0);
+    vec3 scene_color = texture(scene, screen_coord).xyz;
+    vec3 total_color = scene_color * invisible + total_ambient * (1.0-invisible);
+
+    float blur_weight = 0.7f;
+    FragColor = vec4(total_color * blur_weight, 1.0);
+    BrightColor = vec4(total_color * (1.0 - blur_weight), 1.0);
+#else
     float kd = 0.7;
-    vec3 diffuse = kd * light * max(dot(fragNormal, lightDir), 0.0);  
-    vec3 total_diffuse = diffuse * diffuseColor;
-
-    //specular
     float ks = 0.9;
     float alpha = 10;
     vec3 viewDir = normalize(viewPos - fs_in.Pos);
-
     vec3 halfway = normalize(lightDir + viewDir);
-    vec3 specular = ks * light * pow(max(dot(fragNormal, halfway), 0.0), alpha);
-    vec3 total_specular =  specular * specularColor;
 
-    vec3 total_point_light = total_ambient + total_diffuse + total_specular;
-
-    vec3 total_color = total_point_light;
-
-    // -----Shadow Test-----
+#ifdef SHADOW
+    float shadow = pointShadow(fs_in.Pos, lightPos);
+#else
     float shadow = 0.0;
+#endif
+
+#ifdef TOON
+    // discretized color into 3 part (Ambient, diffuse, diffuse + specular)
+    vec3 total_diffuse = kd * light * diffuseColor;
+    vec3 total_specular = ks * light * specularColor;
+
+    float NdotL = max(dot(fragNormal, lightDir), 0);
+    vec3 total_point_light = total_ambient;
+    if(NdotL >= 0.3)
+        total_point_light += total_diffuse;
+    if(NdotL >= 0.85)
+        total_point_light += total_specular;
+
+    // if in shadow -> ambient, else -> direct
+    vec3 total_color = shadow > 0.0 ? total_ambient : total_point_light;
+#else
+    //diffuse
+    vec3 total_diffuse = kd * light * max(dot(fragNormal, lightDir), 0.0) * diffuseColor;
 
-    if(drawShadow)
-    {
-        // use vector between fragment position(in camera-view) and light position to sample the cubemap
-        vec3 fragToLight = fs_in.Pos - lightPos;
-
-        // Compare the distance between light and fragment position under camera-view with that under light-view
-        float cameraViewDepth = length(fragToLight);
-
-        // Add the bias preventing from stripe
-        // Note that the bias should be large enough since the depth is in [0, far_plane] rather than [0, 1]
-        float bias = 0.35;
-        int samples = 20;
-        float viewDistance = length(viewPos - fs_in.Pos);
-        float diskRadius = 0.05;
-        for(int i = 0; i < samples; ++i)
-        {
-            // use vector between fragment position(in camera-view) and light position to sample the cubemap
-            float lightViewDepth = texture(shadowMap, fragToLight + sampleOffsetDirections[i] * diskRadius).r;
-
-            // Since we stored a normalized depth in cubemap, we use far_plane to transform it back to the original length
-            lightViewDepth *= far_plane;
-
-            // If the dis under camera-view > dis under light-view, then this fragment is in the shadow
-            if(cameraViewDepth - bias > lightViewDepth)
-                shadow += 1.0;
-        }
-        shadow /= float(samples);
-    }
+    //specular
+    vec3 total_specular = ks * light * pow(max(dot(fragNormal, halfway), 0.0), alpha) * specularColor;
 
     // if in shadow -> ambient
-    total_color = total_ambient + (1.0-shadow) * (total_diffuse + total_specular);
-
-    //FragColor = vec4(vec3(closestDepth / far_plane), 1.0);
-
-    // invisible
-    // trick: if invisible, bring part of the color into brightcolor part to blur it
-    if(invisible > 0.1f)
-    {
-        vec2 screen_coord = vec2(gl_FragCoord) / textureSize(scene, 0);
-        vec3 scene_color = texture(scene, screen_coord).xyz;
-        total_color = total_ambient;
-        total_color = scene_color * invisible + total_color * (1.0-invisible);
-
-        float blur_weight = 0.7f;
-        FragColor = vec4(total_color * blur_weight, 1.0);
-        BrightColor = vec4(total_color * (1.0 - blur_weight), 1.0);
-    }
-    else
-    {
-        // Assign the black color to bright color, telling it that this part is not bright
-        FragColor = vec4(total_color, 1.0);
-        BrightColor = vec4(0.0, 0.0, 0.0, 1.0);
-    }
-}
\ No newline at end of file
+    vec3 total_color = total_ambient + (1.0-shadow) * (total_diffuse + total_specular);
+#endif
+
+    // Assign the black color to bright color, telling it that this part is not bright
+    FragColor = vec4(total_color, 1.0);
+    BrightColor = vec4(0.0, 0.0, 0.0, 1.0);
+#endif
+}
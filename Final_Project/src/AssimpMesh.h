@@ -7,6 +7,11 @@
 #include <glm/gtc/matrix_transform.hpp>
 
 #include "shader.h"
+#include "TextureCache.h"
+#include "IndexBuffer.h"
+#include "MeshSimplifier.h"
+#include "Meshlets.h"
+#include "Bvh.h"
 
 #include <string>
 #include <vector>
@@ -45,15 +50,46 @@ public:
     vector<unsigned int> indices;
     vector<Texture>      textures;
     unsigned int VAO;
+    // levels of detail: the simplified index sets follow the full one in the element buffer
+    vector<MeshSimplifier::Lod> lods;
+    MeshSimplifier::Sphere boundingSphere; // object space
+    vector<Meshlets::Meshlet> meshlets;    // of the full level (empty for the small meshes)
+    unsigned int lod;       // drawn by the camera passes
+    unsigned int shadowLod; // drawn into the shadow cubemap
+    GLenum indexType;   // GL_UNSIGNED_SHORT or GL_UNSIGNED_INT (IndexBuffer)
+    size_t indexBytes;
+    int materialID; // in the MaterialArrays of the model (-1: binds its own textures)
+    int node;              // in the SceneGraph of the model
+    glm::mat4 modelMatrix; // world matrix of the node (Model::updateTransforms)
+    bool visible;          // from the camera, by the BVH of the renderer (the hidden meshes aren't drawn)
+    bool shadowVisible;    // from a face of the shadow cubemap
 
     // constructor
-    AssimpMesh(vector<Vertex> vertices, vector<unsigned int> indices, vector<Texture> textures)
-        : xAngle(0.0f), yAngle(0.0f), zAngle(0.0f), xmax(0.0f), xmin(0.0f), ymax(0.0f), ymin(0.0f), zmax(0.0f), zmin(0.0f), rotation(glm::mat4(1.0f)), translateDiff(glm::vec3(0.0f)), bloomR(0.027)
+    // indices: every level of lods
+    AssimpMesh(vector<Vertex> vertices, vector<unsigned int> indices, vector<Texture> textures, vector<MeshSimplifier::Lod> lods, MeshSimplifier::Sphere boundingSphere, vector<Meshlets::Meshlet> meshlets)
+        : lods(lods), boundingSphere(boundingSphere), meshlets(meshlets), lod(0), shadowLod(0), indexType(GL_UNSIGNED_INT), indexBytes(0), materialID(-1), node(-1), modelMatrix(glm::mat4(1.0f)), visible(true), shadowVisible(true), lodLevel(0), shadowLodLevel(0), meshletsCulled(false), xAngle(0.0f), yAngle(0.0f), zAngle(0.0f), bloomR(0.027), xmax(0.0f), xmin(0.0f), ymax(0.0f), ymin(0.0f), zmax(0.0f), zmin(0.0f)
     {
         this->vertices = vertices;
         this->indices = indices;
         this->textures = textures;
 
+        // object space bounds
+        if (!vertices.empty())
+        {
+            xmin = xmax = vertices[0].Position.x;
+            ymin = ymax = vertices[0].Position.y;
+            zmin = zmax = vertices[0].Position.z;
+        }
+        for (unsigned int i = 1; i < vertices.size(); i++)
+        {
+            xmin = std::min(xmin, vertices[i].Position.x);
+            xmax = std::max(xmax, vertices[i].Position.x);
+            ymin = std::min(ymin, vertices[i].Position.y);
+            ymax = std::max(ymax, vertices[i].Position.y);
+            zmin = std::min(zmin, vertices[i].Position.z);
+            zmax = std::max(zmax, vertices[i].Position.z);
+        }
+
         // now that we have all the required data, set the vertex buffers and its attribute pointers.
         setupMesh();
     }
@@ -85,19 +121,121 @@ public:
             glUniform1i(glGetUniformLocation(shader.ID, (name + number).c_str()), i + textureOffset);
             // and finally bind the texture
             glBindTexture(GL_TEXTURE_2D, textures[i].id);
+            TextureCache::instance().touch(textures[i].id);
         }
     }
 
-    glm::mat4 getModelMatrix()
+    // the first texture of this type (0 if none)
+    unsigned int getTexture(const string& type) const
     {
-        // model matrix
-        glm::mat4 identity(1.0f);
-        glm::mat4 model = identity;
-        model = rotation * model;
-        model = glm::translate(identity, translateDiff) * model;
-        model = glm::scale(identity, glm::vec3(0.2f)) * model; // scale it to be smaller
-        model = glm::translate(identity, glm::vec3(0.0f, -1.3f, 0.0f));
-        return model;
+        for (unsigned int i = 0; i < textures.size(); i++)
+        {
+            if (textures[i].type == type)
+                return textures[i].id;
+        }
+        return 0;
+    }
+
+    const glm::mat4& getModelMatrix() const
+    {
+        return modelMatrix;
+    }
+
+    Bvh::Aabb getWorldBounds() const
+    {
+        Bvh::Aabb box = { glm::vec3(xmin, ymin, zmin), glm::vec3(xmax, ymax, zmax) };
+        return Bvh::transform(box, modelMatrix);
+    }
+
+    glm::vec3 getCenter() const
+    {
+        return glm::vec3((xmin + xmax) * 0.5f, (ymin + ymax) * 0.5f, (zmin + zmax) * 0.5f);
+    }
+
+    // nearest triangle of the full level hit by a world space ray, t in units of direction
+    bool intersectRay(const glm::vec3& origin, const glm::vec3& direction, float& t) const
+    {
+        // in object space (t doesn't change)
+        glm::mat4 inverse = glm::inverse(modelMatrix);
+        glm::vec3 o = glm::vec3(inverse * glm::vec4(origin, 1.0f));
+        glm::vec3 d = glm::vec3(inverse * glm::vec4(direction, 0.0f));
+        bool hit = false;
+        unsigned int end = lods.empty() ? static_cast<unsigned int>(indices.size()) : lods[0].offset + lods[0].count;
+        for (unsigned int i = lods.empty() ? 0 : lods[0].offset; i + 2 < end; i += 3)
+        {
+            float distance;
+            if (Bvh::intersectTriangle(o, d, vertices[indices[i]].Position, vertices[indices[i + 1]].Position, vertices[indices[i + 2]].Position, distance) &&
+                (!hit || distance < t))
+            {
+                t = distance;
+                hit = true;
+            }
+        }
+        return hit;
+    }
+
+    // the levels of detail of the camera & of the shadow cubemap for the projected size of the bounding sphere
+    // viewScale/shadowScale: pixels per unit at distance 1 (projection[1][1] * half the viewport height)
+    // the bias is added after the selection (more is coarser)
+    void selectLod(const glm::vec3& viewPos, float viewScale, int lodBias, const glm::vec3& lightPos, float shadowScale, int shadowLodBias)
+    {
+        const float pixelError = 1.0f;
+        const float hysteresis = 0.25f;
+        glm::mat4 model = getModelMatrix();
+        glm::vec3 center = glm::vec3(model * glm::vec4(boundingSphere.center[0], boundingSphere.center[1], boundingSphere.center[2], 1.0f));
+        float scale = std::max(glm::length(glm::vec3(model[0])), std::max(glm::length(glm::vec3(model[1])), glm::length(glm::vec3(model[2]))));
+        float radius = boundingSphere.radius * scale;
+
+        lodLevel = MeshSimplifier::selectLod(lods, lodLevel, getRadiusPixels(center, radius, viewPos, viewScale), pixelError, hysteresis);
+        shadowLodLevel = MeshSimplifier::selectLod(lods, shadowLodLevel, getRadiusPixels(center, radius, lightPos, shadowScale), pixelError, hysteresis);
+        lod = static_cast<unsigned int>(std::min(std::max(static_cast<int>(lodLevel) + lodBias, 0), static_cast<int>(lods.size()) - 1));
+        shadowLod = static_cast<unsigned int>(std::min(std::max(static_cast<int>(shadowLodLevel) + shadowLodBias, 0), static_cast<int>(lods.size()) - 1));
+    }
+
+    // after selectLod: the meshlets of the full level which the camera can see, as the ranges drawn by
+    // draw_point_shadow & draw_material (the whole level is drawn at the other levels or without meshlets)
+    void cullMeshlets(const glm::mat4& viewProjection, const glm::vec3& viewPos, bool backfaceCulling, Meshlets::Stats& stats)
+    {
+        drawCounts.clear();
+        drawOffsets.clear();
+        meshletsCulled = !meshlets.empty() && lod == 0;
+        if (!meshletsCulled)
+            return;
+        if (!visible)
+        {
+            // culled as a whole by the BVH
+            stats.triangles += lods[0].count / 3;
+            stats.culledTriangles += lods[0].count / 3;
+            return;
+        }
+
+        // the tests are done in object space
+        glm::mat4 model = getModelMatrix();
+        glm::vec4 planes[6];
+        Meshlets::extractPlanes(viewProjection * model, planes);
+        glm::vec3 eye = glm::vec3(glm::inverse(model) * glm::vec4(viewPos, 1.0f));
+
+        size_t indexSize = indexType == GL_UNSIGNED_SHORT ? sizeof(unsigned short) : sizeof(unsigned int);
+        unsigned int end = 0;
+        for (unsigned int i = 0; i < meshlets.size(); i++)
+        {
+            const Meshlets::Meshlet& meshlet = meshlets[i];
+            stats.triangles += meshlet.indexCount / 3;
+            if (!Meshlets::isVisible(meshlet, planes, eye, backfaceCulling))
+            {
+                stats.culledTriangles += meshlet.indexCount / 3;
+                continue;
+            }
+            // continues the last range
+            if (!drawCounts.empty() && meshlet.firstIndex == end)
+                drawCounts.back() += meshlet.indexCount;
+            else
+            {
+                drawCounts.push_back(meshlet.indexCount);
+                drawOffsets.push_back((const void*)(meshlet.firstIndex * indexSize));
+            }
+            end = meshlet.firstIndex + meshlet.indexCount;
+        }
     }
 
 
@@ -109,7 +247,7 @@ public:
 
         // draw mesh
         glBindVertexArray(VAO);
-        glDrawElements(GL_TRIANGLES, static_cast<unsigned int>(indices.size()), GL_UNSIGNED_INT, 0);
+        drawElements(lod);
         glBindVertexArray(0);
 
         // always good practice to set everything back to defaults once configured.
@@ -128,7 +266,7 @@ public:
         // render 
         glBindVertexArray(this->VAO);
 
-        glDrawElements(GL_TRIANGLES, static_cast<unsigned int>(indices.size()), GL_UNSIGNED_INT, 0);
+        drawElements(shadowLod);
 
         glBindVertexArray(0);
     }
@@ -142,12 +280,12 @@ public:
         singleColorShader.setMat4("view", view);
         singleColorShader.setFloat("bloomR", bloomR);
         glBindVertexArray(this->VAO);
-        glDrawElements(GL_TRIANGLES, static_cast<unsigned int>(indices.size()), GL_UNSIGNED_INT, 0);
+        drawElements(lod);
         glBindVertexArray(0);
     }
 
-    // Can accept toon or blinn-phong(non-toon)
-    void draw_point_shadow(Shader& pointShadowShader, Shader& singleColorShader, const glm::mat4& projection, const glm::mat4& view, const glm::vec3 viewPos, const glm::vec3 lightPos, myTexture2D& texture, unsigned int& depthCubeMap, unsigned int& sceneTexture, const float& invisible, const float& far_plane, const bool& drawShadow)
+    // Can accept any variant of pointShadowShader (toon or blinn-phong, with or without shadow)
+    void draw_point_shadow(Shader& pointShadowShader, Shader& singleColorShader, const glm::mat4& projection, const glm::mat4& view, const glm::vec3 viewPos, const glm::vec3 lightPos, myTexture2D& texture, unsigned int& depthCubeMap, unsigned int& sceneTexture, const float& invisible, const float& far_plane)
     {
         // use the shader
         pointShadowShader.use();
@@ -162,9 +300,6 @@ public:
         pointShadowShader.setFloat("far_plane", far_plane);
         pointShadowShader.setFloat("invisible", invisible);
 
-        pointShadowShader.setBool("meshOrModel", false);
-        pointShadowShader.setBool("drawShadow", drawShadow);
-
         // model matrix
         auto model = getModelMatrix();
         pointShadowShader.setMat4("model", model);
@@ -185,11 +320,22 @@ public:
         // render the frame of the object
         glBindVertexArray(this->VAO);
 
-        glDrawElements(GL_TRIANGLES, static_cast<unsigned int>(indices.size()), GL_UNSIGNED_INT, 0);
+        drawElements(lod, true);
 
         glBindVertexArray(0);
     }
 
+    // with the MaterialArrays of the model: the shader & the textures are already set by the model
+    void draw_material(Shader& shader)
+    {
+        shader.setMat4("model", getModelMatrix());
+        shader.setInt("materialID", materialID);
+
+        glBindVertexArray(this->VAO);
+        drawElements(lod, true);
+        glBindVertexArray(0);
+    }
+
     // render the mesh
     void draw_blinn_phong(Shader& blinnPhongShader, const glm::vec3& lightPos, const glm::vec3& viewPos, const glm::mat4& view, const glm::mat4& projection)
     {
@@ -202,38 +348,17 @@ public:
         blinnPhongShader.setVec3("viewPos", viewPos);
         blinnPhongShader.setVec3("lightPos", lightPos);
 
-        // model matrix
-        glm::mat4 identity(1.0f);
-        glm::mat4 model = identity;
-        model = rotation * model;
-        model = glm::translate(identity, translateDiff) * model;
-        model = glm::scale(identity, glm::vec3(0.3f)) * model;
-
-        blinnPhongShader.setMat4("model", model);
+        blinnPhongShader.setMat4("model", getModelMatrix());
 
         // draw mesh
         glBindVertexArray(VAO);
-        glDrawElements(GL_TRIANGLES, static_cast<unsigned int>(indices.size()), GL_UNSIGNED_INT, 0);
+        drawElements(lod);
         glBindVertexArray(0);
 
         // always good practice to set everything back to defaults once configured.
         glActiveTexture(GL_TEXTURE0);
     }
 
-    void updateTranslateDiff(glm::vec3 diff)
-    {
-        translateDiff += diff;
-    }
-
-    void updateRotation(std::pair<glm::vec3, float> p)
-    {
-        glm::vec3 axis = p.first;
-        float angle = p.second;
-
-        glm::mat4 newRotation = glm::rotate(glm::mat4(1.0f), angle, axis);
-        rotation = newRotation * rotation;
-    }
-
     void updateAngle(const float& deltaAngle, const unsigned int& angleIndex)
     {
         switch (angleIndex)
@@ -260,6 +385,34 @@ public:
 private:
     // render data 
     unsigned int VBO, EBO;
+    unsigned int lodLevel, shadowLodLevel; // before the bias (they keep the hysteresis)
+    // the visible ranges of the meshlets, from cullMeshlets
+    bool meshletsCulled;
+    vector<GLsizei> drawCounts;
+    vector<const void*> drawOffsets;
+
+    // projected radius of a sphere seen from eye (the whole screen when eye is inside)
+    static float getRadiusPixels(const glm::vec3& center, float radius, const glm::vec3& eye, float pixelsPerUnit)
+    {
+        float distance = glm::length(center - eye);
+        if (distance <= radius)
+            return 1e9f;
+        return radius / std::sqrt(distance * distance - radius * radius) * pixelsPerUnit;
+    }
+
+    // the level of the bound VAO (culled: only the visible meshlets of the full level)
+    void drawElements(unsigned int level, bool culled = false)
+    {
+        if (culled && meshletsCulled && level == 0)
+        {
+            if (!drawCounts.empty())
+                glMultiDrawElements(GL_TRIANGLES, &drawCounts[0], indexType, &drawOffsets[0], static_cast<GLsizei>(drawCounts.size()));
+            return;
+        }
+        const MeshSimplifier::Lod& selected = lods[level];
+        size_t indexSize = indexType == GL_UNSIGNED_SHORT ? sizeof(unsigned short) : sizeof(unsigned int);
+        glDrawElements(GL_TRIANGLES, selected.count, indexType, (void*)(selected.offset * indexSize));
+    }
 
     // initializes all the buffer objects/arrays
     void setupMesh()
@@ -278,7 +431,8 @@ private:
         glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(Vertex), &vertices[0], GL_STATIC_DRAW);
 
         glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
-        glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned int), &indices[0], GL_STATIC_DRAW);
+        indexType = IndexBuffer::getType(vertices.size());
+        indexBytes = IndexBuffer::upload(indices, indexType);
 
         // set the vertex attribute pointers
         // vertex Positions
@@ -311,9 +465,6 @@ private:
     float yAngle;
     float zAngle;
 
-    glm::mat4 rotation;
-    glm::vec3 translateDiff;
-
     float bloomR;
 
     float xmax;
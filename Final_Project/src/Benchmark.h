@@ -0,0 +1,232 @@
+#ifndef BENCHMARK_H
+#define BENCHMARK_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+// Deterministic benchmark
+// Everything depends on the frame index only: the camera and the light follow a scripted orbit with a fixed
+// timestep, and the effects are toggled at fixed frames. So two runs render exactly the same frames.
+// CPU time = time spent to submit the frame, GPU time = GL_TIMESTAMP at the start & end of the frame.
+// The queries of every frame are kept and read at the end, so measuring never stalls the pipeline.
+class Benchmark
+{
+public:
+    enum Effect
+    {
+        EFFECT_TOON,
+        EFFECT_STENCIL,
+        EFFECT_BLOOM,
+        EFFECT_INVISIBLE
+    };
+
+    struct Toggle
+    {
+        unsigned int frame;
+        Effect effect;
+    };
+
+    Benchmark(unsigned int _frames, float _timeStep = 1.0f / 60.0f)
+        : frames(_frames), timeStep(_timeStep), cameraSpeed(30.0f), lightSpeed(-45.0f), cpuStart(0.0)
+    {
+        cpuMs.resize(frames, 0.0f);
+        gpuMs.resize(frames, 0.0f);
+        startQueries.resize(frames);
+        endQueries.resize(frames);
+    }
+
+    // toggle every effect once, and turn them back in the last part of the run
+    void addDefaultToggles()
+    {
+        unsigned int step = std::max(1u, frames / 6);
+        addToggle(step, EFFECT_TOON);
+        addToggle(step * 2, EFFECT_STENCIL);
+        addToggle(step * 3, EFFECT_BLOOM);
+        addToggle(step * 4, EFFECT_INVISIBLE);
+        addToggle(step * 5, EFFECT_INVISIBLE);
+        addToggle(step * 5, EFFECT_BLOOM);
+    }
+
+    void addToggle(unsigned int frame, Effect effect)
+    {
+        Toggle toggle = { frame, effect };
+        toggles.push_back(toggle);
+    }
+
+    // effects to toggle before rendering this frame
+    std::vector<Effect> getToggles(unsigned int frame) const
+    {
+        std::vector<Effect> effects;
+        for (unsigned int i = 0; i < toggles.size(); i++)
+        {
+            if (toggles[i].frame == frame)
+                effects.push_back(toggles[i].effect);
+        }
+        return effects;
+    }
+
+    float getTime(unsigned int frame) const
+    {
+        return frame * timeStep;
+    }
+
+    float getTimeStep() const
+    {
+        return timeStep;
+    }
+
+    // theta (degrees) of the camera orbit and of the light at this frame
+    float getCameraTheta(unsigned int frame) const
+    {
+        return 90.0f + cameraSpeed * getTime(frame);
+    }
+
+    float getLightTheta(unsigned int frame) const
+    {
+        return lightSpeed * getTime(frame);
+    }
+
+    void init()
+    {
+        glGenQueries(frames, startQueries.data());
+        glGenQueries(frames, endQueries.data());
+    }
+
+    void beginFrame(unsigned int frame)
+    {
+        glQueryCounter(startQueries[frame], GL_TIMESTAMP);
+        cpuStart = now();
+    }
+
+    void endFrame(unsigned int frame)
+    {
+        cpuMs[frame] = static_cast<float>(now() - cpuStart);
+        glQueryCounter(endQueries[frame], GL_TIMESTAMP);
+    }
+
+    // wait for the GPU and collect the GPU times
+    void finish()
+    {
+        glFinish();
+        for (unsigned int i = 0; i < frames; i++)
+        {
+            GLuint64 startTime = 0, endTime = 0;
+            glGetQueryObjectui64v(startQueries[i], GL_QUERY_RESULT, &startTime);
+            glGetQueryObjectui64v(endQueries[i], GL_QUERY_RESULT, &endTime);
+            gpuMs[i] = static_cast<float>(endTime - startTime) / 1.0e6f;
+        }
+        glDeleteQueries(frames, startQueries.data());
+        glDeleteQueries(frames, endQueries.data());
+    }
+
+    // one line per frame
+    bool writeCSV(const std::string& path) const
+    {
+        std::ofstream out(path);
+        if (!out)
+        {
+            std::cout << "Benchmark: can't write " << path << std::endl;
+            return false;
+        }
+        out << "frame,cpu_ms,gpu_ms" << std::endl;
+        for (unsigned int i = 0; i < frames; i++)
+            out << i << "," << cpuMs[i] << "," << gpuMs[i] << std::endl;
+        return true;
+    }
+
+    // summary statistics (the first frames are skipped: they include driver warm-up)
+    bool writeJSON(const std::string& path) const
+    {
+        std::ofstream out(path);
+        if (!out)
+        {
+            std::cout << "Benchmark: can't write " << path << std::endl;
+            return false;
+        }
+        out << "{" << std::endl;
+        out << "  \"frames\": " << frames << "," << std::endl;
+        out << "  \"warmup_frames\": " << getWarmupFrames() << "," << std::endl;
+        out << "  \"time_step\": " << timeStep << "," << std::endl;
+        out << "  \"cpu_ms\": ";
+        writeStatsJSON(out, cpuMs);
+        out << "," << std::endl << "  \"gpu_ms\": ";
+        writeStatsJSON(out, gpuMs);
+        out << std::endl << "}" << std::endl;
+        return true;
+    }
+
+    void printSummary(std::ostream& out) const
+    {
+        Stats cpu = getStats(cpuMs);
+        Stats gpu = getStats(gpuMs);
+        out << "Benchmark: " << frames << " frames (" << getWarmupFrames() << " warm-up frames skipped)" << std::endl;
+        out << "  CPU ms: avg " << cpu.avg << ", p50 " << cpu.p50 << ", p95 " << cpu.p95 << ", p99 " << cpu.p99 << ", max " << cpu.max << std::endl;
+        out << "  GPU ms: avg " << gpu.avg << ", p50 " << gpu.p50 << ", p95 " << gpu.p95 << ", p99 " << gpu.p99 << ", max " << gpu.max << std::endl;
+    }
+
+private:
+    struct Stats
+    {
+        float min, avg, p50, p95, p99, max;
+    };
+
+    unsigned int getWarmupFrames() const
+    {
+        return std::min(10u, frames / 10);
+    }
+
+    Stats getStats(const std::vector<float>& samples) const
+    {
+        Stats stats = { 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f };
+        std::vector<float> sorted(samples.begin() + getWarmupFrames(), samples.end());
+        if (sorted.empty())
+            return stats;
+        std::sort(sorted.begin(), sorted.end());
+
+        float sum = 0.0f;
+        for (unsigned int i = 0; i < sorted.size(); i++)
+            sum += sorted[i];
+        stats.min = sorted.front();
+        stats.avg = sum / sorted.size();
+        stats.p50 = sorted[static_cast<size_t>((sorted.size() - 1) * 0.5f)];
+        stats.p95 = sorted[static_cast<size_t>((sorted.size() - 1) * 0.95f)];
+        stats.p99 = sorted[static_cast<size_t>((sorted.size() - 1) * 0.99f)];
+        stats.max = sorted.back();
+        return stats;
+    }
+
+    void writeStatsJSON(std::ostream& out, const std::vector<float>& samples) const
+    {
+        Stats stats = getStats(samples);
+        out << "{ \"min\": " << stats.min << ", \"avg\": " << stats.avg << ", \"p50\": " << stats.p50
+            << ", \"p95\": " << stats.p95 << ", \"p99\": " << stats.p99 << ", \"max\": " << stats.max << " }";
+    }
+
+    static double now()
+    {
+        return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+    unsigned int frames;
+    float timeStep;
+    // degrees per second
+    float cameraSpeed;
+    float lightSpeed;
+
+    std::vector<Toggle> toggles;
+
+    double cpuStart;
+    std::vector<float> cpuMs;
+    std::vector<float> gpuMs;
+    std::vector<unsigned int> startQueries;
+    std::vector<unsigned int> endQueries;
+};
+
+#endif
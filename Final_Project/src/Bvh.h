@@ -0,0 +1,377 @@
+#ifndef BVH_H
+#define BVH_H
+
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <iomanip>
+#include <ostream>
+#include <sstream>
+#include <utility>
+#include <vector>
+
+#include "CpuProfiler.h"
+
+// Bounding volume hierarchy over the world bounds of the objects of the scene (an object is an index in the
+// bounds given to build). Built top-down with the surface area heuristic; when the objects move, refit updates
+// the boxes bottom-up without changing the tree, and the tree is rebuilt once the refitted one costs twice as
+// much as a fresh one. The nodes are stored parents first, so refit is one reverse linear pass.
+class Bvh
+{
+public:
+    struct Aabb
+    {
+        glm::vec3 minimum;
+        glm::vec3 maximum;
+    };
+
+    // accumulated since the start
+    struct Timings
+    {
+        double buildMs;
+        double refitMs;
+        double queryMs;
+        unsigned int builds;
+        unsigned int refits;
+        unsigned int queries;
+    };
+
+    Bvh() : objectCount(0), builtCost(0.0f), timings() {}
+
+    unsigned int size() const { return objectCount; }
+    const Timings& getTimings() const { return timings; }
+
+    void build(const std::vector<Aabb>& bounds)
+    {
+        CPU_PROFILE_SCOPE("Bvh::build");
+        double start = now();
+        objectCount = static_cast<unsigned int>(bounds.size());
+        objectBounds = bounds;
+        nodes.clear();
+        objects.resize(bounds.size());
+        for (unsigned int i = 0; i < objects.size(); i++)
+            objects[i] = i;
+        if (!objects.empty())
+            buildNode(bounds, 0, objectCount);
+        builtCost = getCost();
+        timings.buildMs += now() - start;
+        timings.builds++;
+    }
+
+    // same objects, new bounds
+    void refit(const std::vector<Aabb>& bounds)
+    {
+        if (bounds.size() != objectCount)
+        {
+            build(bounds);
+            return;
+        }
+        CPU_PROFILE_SCOPE("Bvh::refit");
+        double start = now();
+        objectBounds = bounds;
+        for (int i = static_cast<int>(nodes.size()) - 1; i >= 0; i--)
+        {
+            Node& node = nodes[i];
+            if (node.count > 0)
+            {
+                node.bounds = bounds[objects[node.first]];
+                for (unsigned int j = 1; j < node.count; j++)
+                    node.bounds = merge(node.bounds, bounds[objects[node.first + j]]);
+            }
+            else
+                node.bounds = merge(nodes[i + 1].bounds, nodes[node.right].bounds);
+        }
+        timings.refitMs += now() - start;
+        timings.refits++;
+        if (getCost() > 2.0f * builtCost)
+            build(bounds);
+    }
+
+    // planes: normalized, inside when dot >= 0 (see Meshlets::extractPlanes). Sets visible[object] of the
+    // objects whose box intersects the frustum (the others are left as they are, so that frusta can be combined)
+    void queryFrustum(const glm::vec4 planes[6], std::vector<unsigned char>& visible)
+    {
+        CPU_PROFILE_SCOPE("Bvh::queryFrustum");
+        double start = now();
+        visible.resize(objectCount, 0);
+        if (!nodes.empty())
+        {
+            // (node, inside every plane)
+            std::vector<std::pair<unsigned int, bool> > stack(1, std::make_pair(0u, false));
+            while (!stack.empty())
+            {
+                unsigned int index = stack.back().first;
+                bool inside = stack.back().second;
+                stack.pop_back();
+                const Node& node = nodes[index];
+                if (!inside)
+                {
+                    int result = classify(node.bounds, planes);
+                    if (result < 0)
+                        continue;
+                    inside = result > 0;
+                }
+                if (node.count > 0)
+                {
+                    for (unsigned int j = 0; j < node.count; j++)
+                    {
+                        unsigned int object = objects[node.first + j];
+                        if (inside || node.count == 1 || classify(objectBounds[object], planes) >= 0)
+                            visible[object] = 1;
+                    }
+                    continue;
+                }
+                stack.push_back(std::make_pair(node.right, inside));
+                stack.push_back(std::make_pair(index + 1, inside));
+            }
+        }
+        timings.queryMs += now() - start;
+        timings.queries++;
+    }
+
+    // the objects whose box is hit by the ray, as (entry distance in units of direction, object) nearest first
+    void queryRay(const glm::vec3& origin, const glm::vec3& direction, std::vector<std::pair<float, unsigned int> >& hits)
+    {
+        CPU_PROFILE_SCOPE("Bvh::queryRay");
+        double start = now();
+        hits.clear();
+        glm::vec3 inverse(1.0f / direction.x, 1.0f / direction.y, 1.0f / direction.z);
+        std::vector<unsigned int> stack;
+        if (!nodes.empty())
+            stack.push_back(0);
+        while (!stack.empty())
+        {
+            const Node& node = nodes[stack.back()];
+            unsigned int index = stack.back();
+            stack.pop_back();
+            float entry;
+            if (!intersect(node.bounds, origin, inverse, entry))
+                continue;
+            if (node.count > 0)
+            {
+                for (unsigned int j = 0; j < node.count; j++)
+                {
+                    unsigned int object = objects[node.first + j];
+                    if (node.count == 1 || intersect(objectBounds[object], origin, inverse, entry))
+                        hits.push_back(std::make_pair(entry, object));
+                }
+                continue;
+            }
+            stack.push_back(node.right);
+            stack.push_back(index + 1);
+        }
+        std::sort(hits.begin(), hits.end());
+        timings.queryMs += now() - start;
+        timings.queries++;
+    }
+
+    void printTimings(std::ostream& out) const
+    {
+        std::ostringstream line;
+        line << std::fixed << std::setprecision(3) << "BVH (" << objectCount << " objects, " << nodes.size() << " nodes): "
+            << timings.builds << " builds " << average(timings.buildMs, timings.builds) << " ms, "
+            << timings.refits << " refits " << average(timings.refitMs, timings.refits) << " ms, "
+            << timings.queries << " queries " << average(timings.queryMs, timings.queries) << " ms";
+        out << line.str() << std::endl;
+    }
+
+    // world box of an object box moved by a matrix (Arvo)
+    static Aabb transform(const Aabb& box, const glm::mat4& matrix)
+    {
+        Aabb result;
+        result.minimum = result.maximum = glm::vec3(matrix[3]);
+        for (int column = 0; column < 3; column++)
+        {
+            for (int row = 0; row < 3; row++)
+            {
+                float a = matrix[column][row] * box.minimum[column];
+                float b = matrix[column][row] * box.maximum[column];
+                result.minimum[row] += std::min(a, b);
+                result.maximum[row] += std::max(a, b);
+            }
+        }
+        return result;
+    }
+
+    // ray & triangle (Moller-Trumbore, both sides), distance: in units of direction (> 0 only)
+    static bool intersectTriangle(const glm::vec3& origin, const glm::vec3& direction, const glm::vec3& a, const glm::vec3& b, const glm::vec3& c, float& distance)
+    {
+        glm::vec3 e1 = b - a;
+        glm::vec3 e2 = c - a;
+        glm::vec3 p = glm::cross(direction, e2);
+        float determinant = glm::dot(e1, p);
+        if (std::abs(determinant) < 1e-12f)
+            return false;
+        glm::vec3 s = (origin - a) / determinant;
+        float u = glm::dot(s, p);
+        if (u < 0.0f || u > 1.0f)
+            return false;
+        glm::vec3 q = glm::cross(s, e1);
+        float v = glm::dot(direction, q);
+        if (v < 0.0f || u + v > 1.0f)
+            return false;
+        distance = glm::dot(e2, q);
+        return distance > 0.0f;
+    }
+
+private:
+    // an inner node has its left child right after it, a leaf has objects[first, first + count)
+    struct Node
+    {
+        Aabb bounds;
+        unsigned int right;
+        unsigned int first;
+        unsigned int count;
+    };
+
+    static const unsigned int MAX_LEAF_OBJECTS = 4;
+
+    std::vector<Node> nodes;
+    std::vector<unsigned int> objects;
+    std::vector<Aabb> objectBounds; // of the last build/refit (queryRay, when a leaf holds several objects)
+    unsigned int objectCount;
+    float builtCost; // SAH cost after the last build
+    Timings timings;
+
+    static double now()
+    {
+        return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+    static double average(double total, unsigned int count)
+    {
+        return count > 0 ? total / count : 0.0;
+    }
+
+    static Aabb merge(const Aabb& a, const Aabb& b)
+    {
+        Aabb result = { glm::min(a.minimum, b.minimum), glm::max(a.maximum, b.maximum) };
+        return result;
+    }
+
+    static float area(const Aabb& box)
+    {
+        glm::vec3 size = glm::max(box.maximum - box.minimum, glm::vec3(0.0f));
+        return 2.0f * (size.x * size.y + size.y * size.z + size.z * size.x);
+    }
+
+    // -1: outside a plane, 1: inside every plane, 0: intersects
+    static int classify(const Aabb& box, const glm::vec4 planes[6])
+    {
+        int result = 1;
+        for (int i = 0; i < 6; i++)
+        {
+            glm::vec3 normal(planes[i]);
+            glm::vec3 positive(normal.x >= 0.0f ? box.maximum.x : box.minimum.x, normal.y >= 0.0f ? box.maximum.y : box.minimum.y, normal.z >= 0.0f ? box.maximum.z : box.minimum.z);
+            glm::vec3 negative(normal.x >= 0.0f ? box.minimum.x : box.maximum.x, normal.y >= 0.0f ? box.minimum.y : box.maximum.y, normal.z >= 0.0f ? box.minimum.z : box.maximum.z);
+            if (glm::dot(normal, positive) + planes[i].w < 0.0f)
+                return -1;
+            if (glm::dot(normal, negative) + planes[i].w < 0.0f)
+                result = 0;
+        }
+        return result;
+    }
+
+    // slab test, entry: distance of the entry point (0 when the origin is inside)
+    static bool intersect(const Aabb& box, const glm::vec3& origin, const glm::vec3& inverse, float& entry)
+    {
+        glm::vec3 t0 = (box.minimum - origin) * inverse;
+        glm::vec3 t1 = (box.maximum - origin) * inverse;
+        glm::vec3 closest = glm::min(t0, t1), farthest = glm::max(t0, t1);
+        entry = std::max(std::max(closest.x, closest.y), std::max(closest.z, 0.0f));
+        float exit = std::min(std::min(farthest.x, farthest.y), farthest.z);
+        return entry <= exit;
+    }
+
+    // SAH cost of the tree (traversal 1, object 1), relative to the root area
+    float getCost() const
+    {
+        if (nodes.empty())
+            return 0.0f;
+        float rootArea = std::max(area(nodes[0].bounds), 1e-20f);
+        float cost = 0.0f;
+        for (unsigned int i = 0; i < nodes.size(); i++)
+            cost += area(nodes[i].bounds) / rootArea * (nodes[i].count > 0 ? static_cast<float>(nodes[i].count) : 1.0f);
+        return cost;
+    }
+
+    unsigned int buildNode(const std::vector<Aabb>& bounds, unsigned int first, unsigned int count)
+    {
+        unsigned int index = static_cast<unsigned int>(nodes.size());
+        nodes.push_back(Node());
+        Aabb box = bounds[objects[first]];
+        for (unsigned int i = 1; i < count; i++)
+            box = merge(box, bounds[objects[first + i]]);
+        nodes[index].bounds = box;
+
+        // the best split of the objects sorted by their center along an axis, by sweeping from both sides
+        float leafCost = static_cast<float>(count);
+        float bestCost = leafCost;
+        int bestAxis = -1;
+        unsigned int bestSplit = 0;
+        if (count > 1)
+        {
+            std::vector<unsigned int> sorted(objects.begin() + first, objects.begin() + first + count);
+            std::vector<float> rightAreas(count);
+            float boxArea = std::max(area(box), 1e-20f);
+            for (int axis = 0; axis < 3; axis++)
+            {
+                sortByCenter(bounds, sorted, axis);
+                Aabb right = bounds[sorted[count - 1]];
+                for (unsigned int i = count - 1; i > 0; i--)
+                {
+                    right = merge(right, bounds[sorted[i]]);
+                    rightAreas[i] = area(right);
+                }
+                Aabb left = bounds[sorted[0]];
+                for (unsigned int i = 1; i < count; i++)
+                {
+                    // objects [0, i) on the left
+                    float cost = 1.0f + (area(left) * i + rightAreas[i] * (count - i)) / boxArea;
+                    if (cost < bestCost)
+                    {
+                        bestCost = cost;
+                        bestAxis = axis;
+                        bestSplit = i;
+                    }
+                    left = merge(left, bounds[sorted[i]]);
+                }
+            }
+        }
+        // no split is better: a leaf, unless it holds too many objects (split at the median)
+        if (bestAxis < 0)
+        {
+            if (count <= MAX_LEAF_OBJECTS)
+            {
+                nodes[index].first = first;
+                nodes[index].count = count;
+                nodes[index].right = 0;
+                return index;
+            }
+            glm::vec3 size = box.maximum - box.minimum;
+            bestAxis = size.x > size.y ? (size.x > size.z ? 0 : 2) : (size.y > size.z ? 1 : 2);
+            bestSplit = count / 2;
+        }
+        std::vector<unsigned int> sorted(objects.begin() + first, objects.begin() + first + count);
+        sortByCenter(bounds, sorted, bestAxis);
+        std::copy(sorted.begin(), sorted.end(), objects.begin() + first);
+
+        nodes[index].first = 0;
+        nodes[index].count = 0;
+        buildNode(bounds, first, bestSplit);
+        unsigned int right = buildNode(bounds, first + bestSplit, count - bestSplit);
+        nodes[index].right = right;
+        return index;
+    }
+
+    static void sortByCenter(const std::vector<Aabb>& bounds, std::vector<unsigned int>& sorted, int axis)
+    {
+        std::sort(sorted.begin(), sorted.end(), [&](unsigned int a, unsigned int b) {
+            return bounds[a].minimum[axis] + bounds[a].maximum[axis] < bounds[b].minimum[axis] + bounds[b].maximum[axis];
+        });
+    }
+};
+
+#endif
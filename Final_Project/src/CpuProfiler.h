@@ -0,0 +1,225 @@
+#ifndef CPU_PROFILER_H
+#define CPU_PROFILER_H
+
+#include <atomic>
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// CPU profiler
+// Scoped timers record (name, start, duration) events into a buffer owned by the current thread.
+// Only the owner thread writes its buffer, so recording an event is lock-free: the event is stored first,
+// then the count is published with a release store. The mutex is only taken once per thread (to register
+// its buffer) and when the trace is written.
+// The trace is written in the Chrome trace-event JSON format (chrome://tracing, Perfetto, Speedscope...).
+class CpuProfiler
+{
+public:
+    struct Event
+    {
+        const char* name; // must point to a string literal (stored as a pointer)
+        long long startUs;
+        long long durationUs;
+    };
+
+    static CpuProfiler& instance()
+    {
+        static CpuProfiler profiler;
+        return profiler;
+    }
+
+    void setEnabled(bool _enabled)
+    {
+        enabled.store(_enabled, std::memory_order_relaxed);
+    }
+
+    bool isEnabled() const
+    {
+        return enabled.load(std::memory_order_relaxed);
+    }
+
+    // the calling thread is named "main" in the trace (call it at startup, before the workers record anything)
+    void registerMainThread()
+    {
+        std::lock_guard<std::mutex> lock(buffersMutex);
+        mainThread = std::this_thread::get_id();
+    }
+
+    long long now() const
+    {
+        return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - epoch).count();
+    }
+
+    void record(const char* name, long long startUs, long long durationUs)
+    {
+        ThreadBuffer* buffer = getThreadBuffer();
+        size_t count = buffer->count.load(std::memory_order_relaxed);
+        if (count >= EVENTS_PER_THREAD)
+        {
+            buffer->dropped++;
+            return;
+        }
+        Event& e = buffer->events[count];
+        e.name = name;
+        e.startUs = startUs;
+        e.durationUs = durationUs;
+        buffer->count.store(count + 1, std::memory_order_release);
+    }
+
+    // write every recorded event as a Chrome trace ("X" = complete events)
+    bool writeChromeTrace(const std::string& path)
+    {
+        std::ofstream out(path);
+        if (!out)
+        {
+            std::cout << "CpuProfiler: can't write " << path << std::endl;
+            return false;
+        }
+
+        std::lock_guard<std::mutex> lock(buffersMutex);
+        size_t total = 0;
+        size_t dropped = 0;
+        bool first = true;
+        out << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+        for (size_t t = 0; t < buffers.size(); t++)
+        {
+            const ThreadBuffer& buffer = *buffers[t];
+            // thread name metadata
+            out << (first ? "\n" : ",\n") << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << buffer.threadId
+                << ",\"args\":{\"name\":\"" << (buffer.mainThread ? "main" : "worker " + std::to_string(buffer.threadId)) << "\"}}";
+            first = false;
+
+            size_t count = buffer.count.load(std::memory_order_acquire);
+            for (size_t i = 0; i < count; i++)
+            {
+                const Event& e = buffer.events[i];
+                out << ",\n{\"name\":\"";
+                writeEscaped(out, e.name);
+                out << "\",\"cat\":\"cpu\",\"ph\":\"X\",\"pid\":1,\"tid\":" << buffer.threadId
+                    << ",\"ts\":" << e.startUs << ",\"dur\":" << e.durationUs << "}";
+            }
+            total += count;
+            dropped += buffer.dropped;
+        }
+        out << "\n]}" << std::endl;
+
+        std::cout << "CPU trace: " << total << " events written to " << path;
+        if (dropped > 0)
+            std::cout << " (" << dropped << " dropped, buffers full)";
+        std::cout << std::endl;
+        return true;
+    }
+
+private:
+    static const size_t EVENTS_PER_THREAD = 1 << 16;
+
+    struct ThreadBuffer
+    {
+        ThreadBuffer(int _threadId, bool _mainThread) : threadId(_threadId), mainThread(_mainThread), events(EVENTS_PER_THREAD), count(0), dropped(0) {}
+
+        int threadId;
+        bool mainThread;
+        std::vector<Event> events;
+        std::atomic<size_t> count;
+        size_t dropped;
+    };
+
+    CpuProfiler() : enabled(false), epoch(std::chrono::steady_clock::now()) {}
+
+    ThreadBuffer* getThreadBuffer()
+    {
+        // the buffers are owned by the profiler (they outlive their threads, so the trace can still be written)
+        static thread_local ThreadBuffer* buffer = nullptr;
+        if (buffer == nullptr)
+        {
+            std::lock_guard<std::mutex> lock(buffersMutex);
+            buffers.push_back(std::unique_ptr<ThreadBuffer>(new ThreadBuffer(static_cast<int>(buffers.size()), std::this_thread::get_id() == mainThread)));
+            buffer = buffers.back().get();
+        }
+        return buffer;
+    }
+
+    static void writeEscaped(std::ostream& out, const char* s)
+    {
+        for (; *s; s++)
+        {
+            if (*s == '"' || *s == '\\')
+                out << '\\';
+            out << *s;
+        }
+    }
+
+    std::atomic<bool> enabled;
+    std::chrono::steady_clock::time_point epoch;
+
+    std::mutex buffersMutex;
+    std::vector<std::unique_ptr<ThreadBuffer>> buffers;
+    std::thread::id mainThread;
+};
+
+// Measures the lifetime of the object (does nothing if the profiler is disabled)
+class ScopedCpuTimer
+{
+public:
+    ScopedCpuTimer(const char* _name) : name(_name), startUs(-1)
+    {
+        if (CpuProfiler::instance().isEnabled())
+            startUs = CpuProfiler::instance().now();
+    }
+
+    ~ScopedCpuTimer()
+    {
+        if (startUs >= 0)
+            CpuProfiler::instance().record(name, startUs, CpuProfiler::instance().now() - startUs);
+    }
+
+private:
+    const char* name;
+    long long startUs;
+};
+
+// Measures consecutive stages: next() ends the current stage and starts a new one
+// (for long sequential code like the render loop, where a scope per stage doesn't fit)
+class CpuStageTimer
+{
+public:
+    CpuStageTimer() : name(nullptr), startUs(-1) {}
+
+    ~CpuStageTimer()
+    {
+        end();
+    }
+
+    void next(const char* _name)
+    {
+        end();
+        if (CpuProfiler::instance().isEnabled())
+        {
+            name = _name;
+            startUs = CpuProfiler::instance().now();
+        }
+    }
+
+    void end()
+    {
+        if (startUs >= 0)
+            CpuProfiler::instance().record(name, startUs, CpuProfiler::instance().now() - startUs);
+        startUs = -1;
+    }
+
+private:
+    const char* name;
+    long long startUs;
+};
+
+#define CPU_PROFILE_CONCAT_INNER(a, b) a##b
+#define CPU_PROFILE_CONCAT(a, b) CPU_PROFILE_CONCAT_INNER(a, b)
+// usage: CPU_PROFILE_SCOPE("name"); -> measures until the end of the current scope
+#define CPU_PROFILE_SCOPE(name) ScopedCpuTimer CPU_PROFILE_CONCAT(cpuProfileScope, __LINE__)(name)
+
+#endif
@@ -0,0 +1,287 @@
+#ifndef DDS_FILE_H
+#define DDS_FILE_H
+
+#include <glad/glad.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <sys/stat.h>
+
+#include "GLExtensions.h"
+
+// S3TC isn't core OpenGL, but every desktop driver has EXT_texture_compression_s3tc
+#ifndef GL_COMPRESSED_RGB_S3TC_DXT1_EXT
+#define GL_COMPRESSED_RGB_S3TC_DXT1_EXT 0x83F0
+#endif
+#ifndef GL_COMPRESSED_RGBA_S3TC_DXT5_EXT
+#define GL_COMPRESSED_RGBA_S3TC_DXT5_EXT 0x83F3
+#endif
+
+// Block-compressed 2D textures with their mip chain, in DDS files (BC1 "DXT1", BC3 "DXT5", BC5 "ATI2")
+// The cooked file of an image is next to it: textures/a/b.png -> textures/a/b.dds (see TextureCooker).
+// The rows are stored top to bottom (like the PNGs), flipVertically() turns them for OpenGL.
+namespace DDSFile
+{
+    struct Level
+    {
+        int width;
+        int height;
+        size_t offset; // in data
+        size_t size;
+    };
+
+    struct Image
+    {
+        GLenum format; // GL_COMPRESSED_RGB_S3TC_DXT1_EXT, GL_COMPRESSED_RGBA_S3TC_DXT5_EXT or GL_COMPRESSED_RG_RGTC2
+        std::vector<Level> levels;
+        std::vector<unsigned char> data;
+    };
+
+    inline unsigned int makeFourCC(char a, char b, char c, char d)
+    {
+        return static_cast<unsigned int>(a) | (static_cast<unsigned int>(b) << 8) | (static_cast<unsigned int>(c) << 16) | (static_cast<unsigned int>(d) << 24);
+    }
+
+    inline int getBlockSize(GLenum format)
+    {
+        return format == GL_COMPRESSED_RGB_S3TC_DXT1_EXT ? 8 : 16;
+    }
+
+    inline size_t getLevelSize(GLenum format, int width, int height)
+    {
+        return static_cast<size_t>((width + 3) / 4) * ((height + 3) / 4) * getBlockSize(format);
+    }
+
+    // the extension of the image is kept (a.png -> a.png.dds), so a.png & a.jpg don't share a cooked file
+    inline std::string getCookedPath(const std::string& source)
+    {
+        return source + ".dds";
+    }
+
+    // the cooked file exists and isn't older than the image
+    inline bool isCooked(const std::string& source)
+    {
+        struct stat sourceStatus, cookedStatus;
+        if (stat(getCookedPath(source).c_str(), &cookedStatus) != 0)
+            return false;
+        return stat(source.c_str(), &sourceStatus) != 0 || cookedStatus.st_mtime >= sourceStatus.st_mtime;
+    }
+
+    struct Header
+    {
+        uint32_t size;
+        uint32_t flags;
+        uint32_t height;
+        uint32_t width;
+        uint32_t linearSize;
+        uint32_t depth;
+        uint32_t mipMapCount;
+        uint32_t reserved1[11];
+        // pixel format
+        uint32_t pfSize;
+        uint32_t pfFlags;
+        uint32_t fourCC;
+        uint32_t rgbBitCount;
+        uint32_t masks[4];
+        uint32_t caps[4];
+        uint32_t reserved2;
+    };
+
+    inline bool write(const std::string& path, const Image& image)
+    {
+        Header header;
+        std::memset(&header, 0, sizeof(header));
+        header.size = 124;
+        header.flags = 0x1 | 0x2 | 0x4 | 0x1000 | 0x20000 | 0x80000; // caps, height, width, pixel format, mip count, linear size
+        header.width = image.levels[0].width;
+        header.height = image.levels[0].height;
+        header.linearSize = static_cast<uint32_t>(image.levels[0].size);
+        header.mipMapCount = static_cast<uint32_t>(image.levels.size());
+        header.pfSize = 32;
+        header.pfFlags = 0x4; // fourCC
+        if (image.format == GL_COMPRESSED_RGB_S3TC_DXT1_EXT)
+            header.fourCC = makeFourCC('D', 'X', 'T', '1');
+        else if (image.format == GL_COMPRESSED_RGBA_S3TC_DXT5_EXT)
+            header.fourCC = makeFourCC('D', 'X', 'T', '5');
+        else
+            header.fourCC = makeFourCC('A', 'T', 'I', '2');
+        header.caps[0] = 0x1000 | 0x8 | 0x400000; // texture, complex, mipmap
+
+        std::ofstream out(path, std::ios::binary);
+        if (!out)
+        {
+            std::cout << "DDSFile: can't write " << path << std::endl;
+            return false;
+        }
+        out.write("DDS ", 4);
+        out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        out.write(reinterpret_cast<const char*>(image.data.data()), image.data.size());
+        return static_cast<bool>(out);
+    }
+
+    inline bool read(const std::string& path, Image& image)
+    {
+        std::ifstream in(path, std::ios::binary);
+        char magic[4];
+        Header header;
+        in.read(magic, 4);
+        in.read(reinterpret_cast<char*>(&header), sizeof(header));
+        if (!in || std::memcmp(magic, "DDS ", 4) != 0 || header.size != 124 || !(header.pfFlags & 0x4))
+        {
+            std::cout << "DDSFile: not a DDS file: " << path << std::endl;
+            return false;
+        }
+
+        if (header.fourCC == makeFourCC('D', 'X', 'T', '1'))
+            image.format = GL_COMPRESSED_RGB_S3TC_DXT1_EXT;
+        else if (header.fourCC == makeFourCC('D', 'X', 'T', '5'))
+            image.format = GL_COMPRESSED_RGBA_S3TC_DXT5_EXT;
+        else if (header.fourCC == makeFourCC('A', 'T', 'I', '2') || header.fourCC == makeFourCC('B', 'C', '5', 'U'))
+            image.format = GL_COMPRESSED_RG_RGTC2;
+        else
+        {
+            std::cout << "DDSFile: unsupported format in " << path << std::endl;
+            return false;
+        }
+
+        // a corrupt file mustn't size the allocation: the size, the mip count & the data are checked
+        if (header.width == 0 || header.height == 0 || header.width > 65536 || header.height > 65536)
+        {
+            std::cout << "DDSFile: invalid size " << header.width << "x" << header.height << " in " << path << std::endl;
+            return false;
+        }
+        uint32_t fullChain = 1;
+        for (uint32_t size = std::max(header.width, header.height); size > 1; size /= 2)
+            fullChain++;
+        uint32_t mipMapCount = std::min(std::max(header.mipMapCount, 1u), fullChain);
+
+        int width = header.width;
+        int height = header.height;
+        size_t total = 0;
+        image.levels.clear();
+        for (uint32_t i = 0; i < mipMapCount; i++)
+        {
+            Level level = { width, height, total, getLevelSize(image.format, width, height) };
+            image.levels.push_back(level);
+            total += level.size;
+            width = width > 1 ? width / 2 : 1;
+            height = height > 1 ? height / 2 : 1;
+        }
+        std::streampos dataStart = in.tellg();
+        in.seekg(0, std::ios::end);
+        std::streamoff available = in.tellg() - dataStart;
+        in.seekg(dataStart);
+        if (!in || available < static_cast<std::streamoff>(total))
+        {
+            std::cout << "DDSFile: truncated file " << path << std::endl;
+            return false;
+        }
+        image.data.resize(total);
+        in.read(reinterpret_cast<char*>(image.data.data()), total);
+        if (!in)
+        {
+            std::cout << "DDSFile: truncated file " << path << std::endl;
+            return false;
+        }
+        return true;
+    }
+
+    // the cooked file of source, ready to be uploaded (flipped for OpenGL if flip)
+    // false if there's none, or if the driver can't use it: the image is decoded instead
+    inline bool loadCooked(const std::string& source, bool flip, Image& image);
+
+    // BC1 color block: 2 colors, then one byte of 2-bit indices per row
+    inline void flipColorBlock(unsigned char* block, int rows)
+    {
+        for (int r = 0; r < rows / 2; r++)
+            std::swap(block[4 + r], block[4 + rows - 1 - r]);
+    }
+
+    // BC4 block (alpha of BC3, channels of BC5): 2 values, then 16 3-bit indices (12 bits per row)
+    inline void flipValueBlock(unsigned char* block, int rows)
+    {
+        uint64_t indices = 0;
+        for (int i = 0; i < 6; i++)
+            indices |= static_cast<uint64_t>(block[2 + i]) << (8 * i);
+        uint64_t flipped = indices;
+        for (int r = 0; r < rows; r++)
+        {
+            uint64_t row = (indices >> (12 * r)) & 0xFFF;
+            int target = rows - 1 - r;
+            flipped &= ~(static_cast<uint64_t>(0xFFF) << (12 * target));
+            flipped |= row << (12 * target);
+        }
+        for (int i = 0; i < 6; i++)
+            block[2 + i] = static_cast<unsigned char>(flipped >> (8 * i));
+    }
+
+    // flip the rows without decoding: the block rows are reversed and the rows inside each block too.
+    // Only possible when the height of every level is a multiple of 4 (or is less than 4).
+    inline bool flipVertically(Image& image)
+    {
+        for (unsigned int l = 0; l < image.levels.size(); l++)
+        {
+            if (image.levels[l].height > 4 && image.levels[l].height % 4 != 0)
+                return false;
+        }
+
+        int blockSize = getBlockSize(image.format);
+        std::vector<unsigned char> row;
+        for (unsigned int l = 0; l < image.levels.size(); l++)
+        {
+            const Level& level = image.levels[l];
+            int blocksX = (level.width + 3) / 4;
+            int blocksY = (level.height + 3) / 4;
+            int rows = level.height < 4 ? level.height : 4;
+            unsigned char* data = &image.data[level.offset];
+            size_t rowSize = static_cast<size_t>(blocksX) * blockSize;
+
+            for (int i = 0; i < blocksX * blocksY; i++)
+            {
+                unsigned char* block = data + i * blockSize;
+                if (image.format == GL_COMPRESSED_RGB_S3TC_DXT1_EXT)
+                    flipColorBlock(block, rows);
+                else if (image.format == GL_COMPRESSED_RGBA_S3TC_DXT5_EXT)
+                {
+                    flipValueBlock(block, rows);
+                    flipColorBlock(block + 8, rows);
+                }
+                else
+                {
+                    flipValueBlock(block, rows);
+                    flipValueBlock(block + 8, rows);
+                }
+            }
+            row.resize(rowSize);
+            for (int y = 0; y < blocksY / 2; y++)
+            {
+                std::memcpy(row.data(), data + y * rowSize, rowSize);
+                std::memcpy(data + y * rowSize, data + (blocksY - 1 - y) * rowSize, rowSize);
+                std::memcpy(data + (blocksY - 1 - y) * rowSize, row.data(), rowSize);
+            }
+        }
+        return true;
+    }
+
+    inline bool loadCooked(const std::string& source, bool flip, Image& image)
+    {
+        if (!isCooked(source) || !read(getCookedPath(source), image))
+            return false;
+        if (image.format != GL_COMPRESSED_RG_RGTC2 && !GLExtensions::get().textureCompressionS3TC)
+            return false;
+        if (flip && !flipVertically(image))
+        {
+            std::cout << "DDSFile: can't flip " << getCookedPath(source) << " (height not a multiple of 4)" << std::endl;
+            return false;
+        }
+        return true;
+    }
+}
+
+#endif
@@ -0,0 +1,155 @@
+#ifndef DYNAMIC_RESOLUTION_H
+#define DYNAMIC_RESOLUTION_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <cmath>
+
+// Dynamic resolution controller
+// The lit scene is rendered into the lower-left part of the (full size) post-processing FBO,
+// and the final composite stretches that part back to the screen.
+// The GPU frame time is measured with GL_TIMESTAMP queries, so it doesn't collide with GL_TIME_ELAPSED queries.
+// Results are read a few frames later (ring of queries), so the CPU never waits for the GPU.
+class DynamicResolution
+{
+public:
+    DynamicResolution(unsigned int _fullWidth, unsigned int _fullHeight, float _targetMs = 16.6f, float _minScale = 0.5f, float _maxScale = 1.0f)
+        : fullWidth(_fullWidth), fullHeight(_fullHeight), targetMs(_targetMs), minScale(_minScale), maxScale(_maxScale),
+          scale(_maxScale), smoothedMs(0.0f), enabled(true), initialized(false), frameIndex(0)
+    {
+        for (int i = 0; i < NUM_QUERY_FRAMES; i++)
+            pending[i] = false;
+    }
+
+    // create the query objects (needs a current OpenGL context)
+    void init()
+    {
+        glGenQueries(NUM_QUERY_FRAMES, startQueries);
+        glGenQueries(NUM_QUERY_FRAMES, endQueries);
+        initialized = true;
+    }
+
+    void beginFrame()
+    {
+        if (!initialized || !enabled)
+            return;
+        glQueryCounter(startQueries[frameIndex], GL_TIMESTAMP);
+    }
+
+    void endFrame()
+    {
+        if (!initialized || !enabled)
+            return;
+        glQueryCounter(endQueries[frameIndex], GL_TIMESTAMP);
+        pending[frameIndex] = true;
+        frameIndex = (frameIndex + 1) % NUM_QUERY_FRAMES;
+
+        // the slot we will overwrite next is the oldest one, read it if the GPU is done with it
+        if (!pending[frameIndex])
+            return;
+        GLint available = 0;
+        glGetQueryObjectiv(endQueries[frameIndex], GL_QUERY_RESULT_AVAILABLE, &available);
+        if (!available)
+            return;
+
+        GLuint64 startTime = 0, endTime = 0;
+        glGetQueryObjectui64v(startQueries[frameIndex], GL_QUERY_RESULT, &startTime);
+        glGetQueryObjectui64v(endQueries[frameIndex], GL_QUERY_RESULT, &endTime);
+        pending[frameIndex] = false;
+
+        updateScale(static_cast<float>(endTime - startTime) / 1.0e6f);
+    }
+
+    // feed a GPU frame time (ms) into the controller
+    void updateScale(float gpuMs)
+    {
+        smoothedMs = smoothedMs <= 0.0f ? gpuMs : smoothedMs * 0.9f + gpuMs * 0.1f;
+
+        // stay inside a small band around the target to avoid oscillation
+        float ratio = targetMs / smoothedMs;
+        if (ratio > 0.95f && ratio < 1.05f)
+            return;
+
+        // fill cost grows with the number of pixels (scale^2)
+        float desired = scale * std::sqrt(ratio);
+        desired = std::min(maxScale, std::max(minScale, desired));
+        // move slowly and in small steps, so the resolution doesn't change every frame
+        float next = scale + (desired - scale) * 0.25f;
+        next = std::round(next * 64.0f) / 64.0f;
+        scale = std::min(maxScale, std::max(minScale, next));
+    }
+
+    void toggle()
+    {
+        setEnabled(!enabled);
+    }
+
+    void setEnabled(bool _enabled)
+    {
+        enabled = _enabled;
+        if (!enabled)
+        {
+            // go back to native resolution and drop the in-flight measurements
+            scale = maxScale;
+            smoothedMs = 0.0f;
+            for (int i = 0; i < NUM_QUERY_FRAMES; i++)
+                pending[i] = false;
+        }
+    }
+
+    bool isEnabled() const
+    {
+        return enabled;
+    }
+
+    unsigned int getWidth() const
+    {
+        return std::max(1u, static_cast<unsigned int>(fullWidth * scale));
+    }
+
+    unsigned int getHeight() const
+    {
+        return std::max(1u, static_cast<unsigned int>(fullHeight * scale));
+    }
+
+    // part of the full size render target covered by the scaled viewport (for sampling in [0, uvScale])
+    glm::vec2 getUVScale() const
+    {
+        return glm::vec2(static_cast<float>(getWidth()) / fullWidth, static_cast<float>(getHeight()) / fullHeight);
+    }
+
+    float getScale() const
+    {
+        return scale;
+    }
+
+    float getGPUTime() const
+    {
+        return smoothedMs;
+    }
+
+private:
+    static const int NUM_QUERY_FRAMES = 3;
+
+    unsigned int fullWidth;
+    unsigned int fullHeight;
+
+    float targetMs;
+    float minScale;
+    float maxScale;
+
+    float scale;
+    float smoothedMs;
+
+    bool enabled;
+    bool initialized;
+
+    int frameIndex;
+    bool pending[NUM_QUERY_FRAMES];
+    unsigned int startQueries[NUM_QUERY_FRAMES];
+    unsigned int endQueries[NUM_QUERY_FRAMES];
+};
+
+#endif
@@ -0,0 +1,88 @@
+#ifndef GL_EXTENSIONS_H
+#define GL_EXTENSIONS_H
+
+#include <glad/glad.h>
+
+#include <cstring>
+#include <iostream>
+
+// OpenGL extensions which aren't part of the generated glad loader (core 4.3 only)
+// Their entry points are loaded with the same loader function as glad, after gladLoadGLLoader.
+
+// KHR_parallel_shader_compile (same values as ARB_parallel_shader_compile)
+#ifndef GL_MAX_SHADER_COMPILER_THREADS_KHR
+#define GL_MAX_SHADER_COMPILER_THREADS_KHR 0x91B0
+#endif
+#ifndef GL_COMPLETION_STATUS_KHR
+#define GL_COMPLETION_STATUS_KHR 0x91B1
+#endif
+typedef void (APIENTRYP PFNGLMAXSHADERCOMPILERTHREADSKHRPROC)(GLuint count);
+
+// ARB_buffer_storage (core in 4.4): persistently mapped buffers
+#ifndef GL_MAP_PERSISTENT_BIT
+#define GL_MAP_PERSISTENT_BIT 0x0040
+#endif
+#ifndef GL_MAP_COHERENT_BIT
+#define GL_MAP_COHERENT_BIT 0x0080
+#endif
+typedef void (APIENTRYP PFNGLBUFFERSTORAGEPROC)(GLenum target, GLsizeiptr size, const void* data, GLbitfield flags);
+
+namespace GLExtensions
+{
+    struct Extensions
+    {
+        bool parallelShaderCompile;
+        PFNGLMAXSHADERCOMPILERTHREADSKHRPROC glMaxShaderCompilerThreadsKHR;
+
+        bool bufferStorage;
+        PFNGLBUFFERSTORAGEPROC glBufferStorage;
+
+        bool textureCompressionS3TC;
+    };
+
+    inline Extensions& get()
+    {
+        static Extensions extensions = { false, NULL, false, NULL, false };
+        return extensions;
+    }
+
+    inline bool hasExtension(const char* name)
+    {
+        GLint numExtensions = 0;
+        glGetIntegerv(GL_NUM_EXTENSIONS, &numExtensions);
+        for (GLint i = 0; i < numExtensions; i++)
+        {
+            const char* extension = reinterpret_cast<const char*>(glGetStringi(GL_EXTENSIONS, i));
+            if (extension && std::strcmp(extension, name) == 0)
+                return true;
+        }
+        return false;
+    }
+
+    inline void load(GLADloadproc loadProc)
+    {
+        Extensions& extensions = get();
+
+        if (hasExtension("GL_KHR_parallel_shader_compile"))
+            extensions.glMaxShaderCompilerThreadsKHR = (PFNGLMAXSHADERCOMPILERTHREADSKHRPROC)loadProc("glMaxShaderCompilerThreadsKHR");
+        else if (hasExtension("GL_ARB_parallel_shader_compile"))
+            extensions.glMaxShaderCompilerThreadsKHR = (PFNGLMAXSHADERCOMPILERTHREADSKHRPROC)loadProc("glMaxShaderCompilerThreadsARB");
+        extensions.parallelShaderCompile = extensions.glMaxShaderCompilerThreadsKHR != NULL;
+
+        if (extensions.parallelShaderCompile)
+        {
+            // let the driver use as many compiler threads as it wants
+            extensions.glMaxShaderCompilerThreadsKHR(0xFFFFFFFF);
+        }
+        std::cout << "Parallel shader compile: " << (extensions.parallelShaderCompile ? "On" : "Off (not supported)") << std::endl;
+
+        if (GLVersion.major > 4 || (GLVersion.major == 4 && GLVersion.minor >= 4) || hasExtension("GL_ARB_buffer_storage"))
+            extensions.glBufferStorage = (PFNGLBUFFERSTORAGEPROC)loadProc("glBufferStorage");
+        extensions.bufferStorage = extensions.glBufferStorage != NULL;
+
+        // BC1 & BC3 (BC5 is core)
+        extensions.textureCompressionS3TC = hasExtension("GL_EXT_texture_compression_s3tc");
+    }
+}
+
+#endif
@@ -0,0 +1,137 @@
+#ifndef GOLDEN_IMAGE_H
+#define GOLDEN_IMAGE_H
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <vector>
+
+// Comparison of a rendered frame with a stored golden image (both RGBA8, same size)
+// Two metrics are used, because GPU drivers never give bit-exact results:
+//   - per-pixel delta: max channel difference, a pixel is "bad" above pixelTolerance
+//   - SSIM of the luminance (8x8 windows), which catches structural changes (missing shadow, outline...)
+//     even when each pixel only moves a little
+namespace GoldenImage
+{
+    struct Tolerance
+    {
+        int pixelTolerance;    // 0-255, difference allowed for a pixel
+        float maxBadPixels;    // ratio of pixels allowed above pixelTolerance
+        float minSSIM;
+    };
+
+    struct DiffResult
+    {
+        int maxDelta;
+        float meanDelta;
+        float badPixels;       // ratio
+        float ssim;
+        bool passed;
+    };
+
+    inline Tolerance defaultTolerance()
+    {
+        Tolerance tolerance = { 8, 0.005f, 0.98f };
+        return tolerance;
+    }
+
+    inline float luminance(const unsigned char* pixel)
+    {
+        return 0.299f * pixel[0] + 0.587f * pixel[1] + 0.114f * pixel[2];
+    }
+
+    // mean SSIM over 8x8 windows (stride 4)
+    inline float computeSSIM(const unsigned char* a, const unsigned char* b, int width, int height)
+    {
+        const int window = 8;
+        const int stride = 4;
+        const float C1 = (0.01f * 255.0f) * (0.01f * 255.0f);
+        const float C2 = (0.03f * 255.0f) * (0.03f * 255.0f);
+
+        std::vector<float> lumA(static_cast<size_t>(width) * height), lumB(lumA.size());
+        for (size_t i = 0; i < lumA.size(); i++)
+        {
+            lumA[i] = luminance(a + i * 4);
+            lumB[i] = luminance(b + i * 4);
+        }
+
+        double sum = 0.0;
+        int count = 0;
+        for (int y = 0; y + window <= height; y += stride)
+        {
+            for (int x = 0; x + window <= width; x += stride)
+            {
+                float meanA = 0.0f, meanB = 0.0f;
+                for (int j = 0; j < window; j++)
+                {
+                    for (int i = 0; i < window; i++)
+                    {
+                        meanA += lumA[(y + j) * width + x + i];
+                        meanB += lumB[(y + j) * width + x + i];
+                    }
+                }
+                meanA /= window * window;
+                meanB /= window * window;
+
+                float varA = 0.0f, varB = 0.0f, covariance = 0.0f;
+                for (int j = 0; j < window; j++)
+                {
+                    for (int i = 0; i < window; i++)
+                    {
+                        float da = lumA[(y + j) * width + x + i] - meanA;
+                        float db = lumB[(y + j) * width + x + i] - meanB;
+                        varA += da * da;
+                        varB += db * db;
+                        covariance += da * db;
+                    }
+                }
+                varA /= window * window - 1;
+                varB /= window * window - 1;
+                covariance /= window * window - 1;
+
+                sum += ((2.0f * meanA * meanB + C1) * (2.0f * covariance + C2)) / ((meanA * meanA + meanB * meanB + C1) * (varA + varB + C2));
+                count++;
+            }
+        }
+        return count > 0 ? static_cast<float>(sum / count) : 1.0f;
+    }
+
+    // heatmap: dimmed golden image, the differences are drawn in red (4x amplified)
+    inline DiffResult compare(const unsigned char* rendered, const unsigned char* golden, int width, int height, const Tolerance& tolerance, std::vector<unsigned char>& heatmap)
+    {
+        DiffResult result = { 0, 0.0f, 0.0f, 1.0f, false };
+        size_t numPixels = static_cast<size_t>(width) * height;
+        heatmap.resize(numPixels * 4);
+
+        double deltaSum = 0.0;
+        size_t badCount = 0;
+        for (size_t i = 0; i < numPixels; i++)
+        {
+            const unsigned char* p = rendered + i * 4;
+            const unsigned char* q = golden + i * 4;
+            int delta = 0;
+            for (int c = 0; c < 3; c++)
+                delta = std::max(delta, std::abs(static_cast<int>(p[c]) - static_cast<int>(q[c])));
+
+            result.maxDelta = std::max(result.maxDelta, delta);
+            deltaSum += delta;
+            if (delta > tolerance.pixelTolerance)
+                badCount++;
+
+            unsigned char base = static_cast<unsigned char>(luminance(q) * 0.3f);
+            unsigned char heat = static_cast<unsigned char>(std::min(255, delta * 4));
+            heatmap[i * 4 + 0] = std::max(base, heat);
+            heatmap[i * 4 + 1] = base;
+            heatmap[i * 4 + 2] = base;
+            heatmap[i * 4 + 3] = 255;
+        }
+
+        result.meanDelta = static_cast<float>(deltaSum / numPixels);
+        result.badPixels = static_cast<float>(badCount) / numPixels;
+        result.ssim = computeSSIM(rendered, golden, width, height);
+        result.passed = result.badPixels <= tolerance.maxBadPixels && result.ssim >= tolerance.minSSIM;
+        return result;
+    }
+}
+
+#endif
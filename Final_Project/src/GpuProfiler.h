@@ -0,0 +1,233 @@
+#ifndef GPU_PROFILER_H
+#define GPU_PROFILER_H
+
+#include <glad/glad.h>
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+
+// GPU profiler
+// Every pass is wrapped with a GL_TIME_ELAPSED query. Each pass owns a ring of QUERY_SETS queries:
+// the results are read back as soon as they are available, a query of frame N is reused at frame N+QUERY_SETS.
+// A result which still isn't available by then is dropped (and counted) instead of waiting,
+// so the profiler never stalls the pipeline.
+// Note that GL_TIME_ELAPSED queries can't be nested, so passes must not overlap.
+class GpuProfiler
+{
+public:
+    GpuProfiler(unsigned int _windowSize = 240)
+        : windowSize(_windowSize), enabled(false), frameIndex(0), activePass(-1), droppedResults(0), framesSincePrint(0) {}
+
+    void toggle()
+    {
+        enabled = !enabled;
+        // results of a previous session are meaningless now
+        for (unsigned int i = 0; i < passes.size(); i++)
+        {
+            std::fill(passes[i].issued, passes[i].issued + QUERY_SETS, false);
+            passes[i].samples.clear();
+            passes[i].next = 0;
+        }
+        droppedResults = 0;
+        framesSincePrint = 0;
+    }
+
+    bool isEnabled() const
+    {
+        return enabled;
+    }
+
+    // collect the results which are available (oldest set first), then switch to the oldest set:
+    // a query of that set which still has no result is dropped
+    void beginFrame()
+    {
+        if (!enabled)
+            return;
+
+        frameIndex = (frameIndex + 1) % QUERY_SETS;
+        for (unsigned int i = 0; i < passes.size(); i++)
+        {
+            Pass& pass = passes[i];
+            for (int age = 0; age < QUERY_SETS; age++)
+            {
+                int set = (frameIndex + age) % QUERY_SETS;
+                if (!pass.issued[set])
+                    continue;
+
+                GLint available = 0;
+                glGetQueryObjectiv(pass.queries[set], GL_QUERY_RESULT_AVAILABLE, &available);
+                if (!available)
+                {
+                    if (set == frameIndex)
+                    {
+                        pass.issued[set] = false;
+                        droppedResults++;
+                    }
+                    continue;
+                }
+                pass.issued[set] = false;
+                GLuint64 elapsed = 0;
+                glGetQueryObjectui64v(pass.queries[set], GL_QUERY_RESULT, &elapsed);
+                addSample(pass, static_cast<float>(elapsed) / 1.0e6f);
+            }
+        }
+
+        // print the table every time the sliding window has been refilled
+        if (++framesSincePrint >= windowSize)
+        {
+            framesSincePrint = 0;
+            printTable(std::cout);
+        }
+    }
+
+    void begin(const char* name)
+    {
+        if (!enabled)
+            return;
+        if (activePass >= 0)
+        {
+            std::cout << "GpuProfiler: pass '" << name << "' begins inside '" << passes[activePass].name << "'" << std::endl;
+            return;
+        }
+        activePass = findPass(name);
+        glBeginQuery(GL_TIME_ELAPSED, passes[activePass].queries[frameIndex]);
+    }
+
+    void end()
+    {
+        if (!enabled || activePass < 0)
+            return;
+        glEndQuery(GL_TIME_ELAPSED);
+        passes[activePass].issued[frameIndex] = true;
+        activePass = -1;
+    }
+
+    // min/avg/p99 (ms) of every pass over the sliding window
+    void printTable(std::ostream& out) const
+    {
+        float totalAvg = 0.0f;
+        out << std::endl << "GPU profile (last " << windowSize << " frames, " << droppedResults << " results dropped)" << std::endl;
+        out << std::left << std::setw(20) << "pass" << std::right << std::setw(10) << "min(ms)" << std::setw(10) << "avg(ms)" << std::setw(10) << "p99(ms)" << std::endl;
+        for (unsigned int i = 0; i < passes.size(); i++)
+        {
+            float minMs, avgMs, p99Ms;
+            getStats(passes[i], minMs, avgMs, p99Ms);
+            totalAvg += avgMs;
+            out << std::left << std::setw(20) << passes[i].name << std::right << std::fixed << std::setprecision(3)
+                << std::setw(10) << minMs << std::setw(10) << avgMs << std::setw(10) << p99Ms << std::endl;
+        }
+        out << std::left << std::setw(20) << "total" << std::right << std::setw(20) << totalAvg << std::endl;
+        out.unsetf(std::ios::fixed);
+    }
+
+    void exportCSV(const std::string& path) const
+    {
+        std::ofstream out(path);
+        if (!out)
+        {
+            std::cout << "GpuProfiler: can't write " << path << std::endl;
+            return;
+        }
+        out << "pass,samples,min_ms,avg_ms,p99_ms" << std::endl;
+        for (unsigned int i = 0; i < passes.size(); i++)
+        {
+            float minMs, avgMs, p99Ms;
+            getStats(passes[i], minMs, avgMs, p99Ms);
+            out << passes[i].name << "," << passes[i].samples.size() << "," << minMs << "," << avgMs << "," << p99Ms << std::endl;
+        }
+        std::cout << "GPU profile exported to " << path << std::endl;
+    }
+
+    // average of the latest samples of a pass (0 if the pass was never measured)
+    float getAverage(const char* name) const
+    {
+        for (unsigned int i = 0; i < passes.size(); i++)
+        {
+            if (passes[i].name == name)
+            {
+                float minMs, avgMs, p99Ms;
+                getStats(passes[i], minMs, avgMs, p99Ms);
+                return avgMs;
+            }
+        }
+        return 0.0f;
+    }
+
+private:
+    // frames a query can take to deliver its result before it's reused
+    static const int QUERY_SETS = 4;
+
+    struct Pass
+    {
+        std::string name;
+        unsigned int queries[QUERY_SETS];
+        bool issued[QUERY_SETS];
+        // sliding window (ring buffer) of the measured times in ms
+        std::vector<float> samples;
+        unsigned int next;
+    };
+
+    int findPass(const char* name)
+    {
+        for (unsigned int i = 0; i < passes.size(); i++)
+        {
+            if (std::strcmp(passes[i].name.c_str(), name) == 0)
+                return i;
+        }
+        // first time we see this pass: create its queries (lazily, so the profiler costs nothing until it's turned on)
+        Pass pass;
+        pass.name = name;
+        glGenQueries(QUERY_SETS, pass.queries);
+        std::fill(pass.issued, pass.issued + QUERY_SETS, false);
+        pass.next = 0;
+        passes.push_back(pass);
+        return static_cast<int>(passes.size()) - 1;
+    }
+
+    void addSample(Pass& pass, float ms)
+    {
+        if (pass.samples.size() < windowSize)
+        {
+            pass.samples.push_back(ms);
+        }
+        else
+        {
+            pass.samples[pass.next] = ms;
+            pass.next = (pass.next + 1) % windowSize;
+        }
+    }
+
+    static void getStats(const Pass& pass, float& minMs, float& avgMs, float& p99Ms)
+    {
+        minMs = avgMs = p99Ms = 0.0f;
+        if (pass.samples.empty())
+            return;
+
+        std::vector<float> sorted(pass.samples);
+        std::sort(sorted.begin(), sorted.end());
+        float sum = 0.0f;
+        for (unsigned int i = 0; i < sorted.size(); i++)
+            sum += sorted[i];
+
+        minMs = sorted.front();
+        avgMs = sum / sorted.size();
+        p99Ms = sorted[std::min(sorted.size() - 1, static_cast<size_t>(sorted.size() * 0.99f))];
+    }
+
+    unsigned int windowSize;
+    bool enabled;
+
+    int frameIndex;
+    int activePass;
+    unsigned int droppedResults;
+    unsigned int framesSincePrint;
+
+    std::vector<Pass> passes;
+};
+
+#endif
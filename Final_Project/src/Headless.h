@@ -0,0 +1,255 @@
+#ifndef HEADLESS_H
+#define HEADLESS_H
+
+#include <glad/glad.h>
+#include <GLFW/glfw3.h>
+
+#include <iostream>
+#include <vector>
+
+// Backend of the headless mode, chosen at compile time:
+//   HEADLESS_EGL    : surfaceless EGL context (GPU without display, link with -lEGL)
+//   HEADLESS_OSMESA : OSMesa context rendered on the CPU by llvmpipe (link with -lOSMesa)
+//   (none)          : hidden GLFW window, not truly headless: it still needs a display (X11/Wayland/desktop),
+//                     only the window never shows up. Build with one of the above on a machine without display.
+#if defined(HEADLESS_EGL)
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#elif defined(HEADLESS_OSMESA)
+#include <GL/osmesa.h>
+#endif
+
+// An OpenGL 3.3 core context without a visible window
+class HeadlessContext
+{
+public:
+    HeadlessContext() : created(false)
+    {
+#if defined(HEADLESS_EGL)
+        display = EGL_NO_DISPLAY;
+        context = EGL_NO_CONTEXT;
+#elif defined(HEADLESS_OSMESA)
+        context = NULL;
+#else
+        window = NULL;
+#endif
+    }
+
+    ~HeadlessContext()
+    {
+        destroy();
+    }
+
+    // create the context and make it current
+    bool create(unsigned int width, unsigned int height)
+    {
+#if defined(HEADLESS_EGL)
+        // no surface, so no size: the renderer draws into FBOs of its own size
+        (void)width;
+        (void)height;
+
+        // ask for a display which doesn't need a window system (Mesa & NVIDIA support it)
+        PFNEGLGETPLATFORMDISPLAYEXTPROC eglGetPlatformDisplayEXT = (PFNEGLGETPLATFORMDISPLAYEXTPROC)eglGetProcAddress("eglGetPlatformDisplayEXT");
+        if (eglGetPlatformDisplayEXT)
+            display = eglGetPlatformDisplayEXT(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, NULL);
+        if (display == EGL_NO_DISPLAY)
+            display = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+        EGLint major, minor;
+        if (display == EGL_NO_DISPLAY || !eglInitialize(display, &major, &minor))
+        {
+            std::cout << "Failed to initialize EGL" << std::endl;
+            return false;
+        }
+
+        const EGLint configAttribs[] = {
+            EGL_SURFACE_TYPE, EGL_PBUFFER_BIT,
+            EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT,
+            EGL_RED_SIZE, 8, EGL_GREEN_SIZE, 8, EGL_BLUE_SIZE, 8, EGL_ALPHA_SIZE, 8,
+            EGL_DEPTH_SIZE, 24, EGL_STENCIL_SIZE, 8,
+            EGL_NONE
+        };
+        EGLConfig config;
+        EGLint numConfigs = 0;
+        if (!eglChooseConfig(display, configAttribs, &config, 1, &numConfigs) || numConfigs == 0)
+        {
+            std::cout << "Failed to choose an EGL config" << std::endl;
+            return false;
+        }
+
+        eglBindAPI(EGL_OPENGL_API);
+        const EGLint contextAttribs[] = {
+            EGL_CONTEXT_MAJOR_VERSION, 3,
+            EGL_CONTEXT_MINOR_VERSION, 3,
+            EGL_CONTEXT_OPENGL_PROFILE_MASK, EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT,
+            EGL_NONE
+        };
+        context = eglCreateContext(display, config, EGL_NO_CONTEXT, contextAttribs);
+        // no surface at all: everything is rendered into FBOs
+        if (context == EGL_NO_CONTEXT || !eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, context))
+        {
+            std::cout << "Failed to create the EGL context" << std::endl;
+            return false;
+        }
+#elif defined(HEADLESS_OSMESA)
+        const int attribs[] = {
+            OSMESA_FORMAT, OSMESA_RGBA,
+            OSMESA_DEPTH_BITS, 24,
+            OSMESA_STENCIL_BITS, 8,
+            OSMESA_PROFILE, OSMESA_CORE_PROFILE,
+            OSMESA_CONTEXT_MAJOR_VERSION, 3,
+            OSMESA_CONTEXT_MINOR_VERSION, 3,
+            0
+        };
+        context = OSMesaCreateContextAttribs(attribs, NULL);
+        // OSMesa always needs a color buffer, even if we only draw into FBOs
+        colorBuffer.resize(static_cast<size_t>(width) * height * 4);
+        if (!context || !OSMesaMakeCurrent(context, colorBuffer.data(), GL_UNSIGNED_BYTE, width, height))
+        {
+            std::cout << "Failed to create the OSMesa context" << std::endl;
+            return false;
+        }
+#else
+        glfwInit();
+        glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
+        glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+        glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+        glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+#ifdef __APPLE__
+        glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
+#endif
+        window = glfwCreateWindow(width, height, "Render 3D Mesh (headless)", NULL, NULL);
+        if (window == NULL)
+        {
+            std::cout << "Failed to create the hidden GLFW window" << std::endl;
+            glfwTerminate();
+            return false;
+        }
+        glfwMakeContextCurrent(window);
+#endif
+        created = true;
+        return true;
+    }
+
+    void destroy()
+    {
+        if (!created)
+            return;
+#if defined(HEADLESS_EGL)
+        eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+        eglDestroyContext(display, context);
+        eglTerminate(display);
+#elif defined(HEADLESS_OSMESA)
+        OSMesaDestroyContext(context);
+#else
+        glfwDestroyWindow(window);
+        glfwTerminate();
+#endif
+        created = false;
+    }
+
+    // for gladLoadGLLoader
+    static void* getProcAddress(const char* name)
+    {
+#if defined(HEADLESS_EGL)
+        return (void*)eglGetProcAddress(name);
+#elif defined(HEADLESS_OSMESA)
+        return (void*)OSMesaGetProcAddress(name);
+#else
+        return (void*)glfwGetProcAddress(name);
+#endif
+    }
+
+    const char* getBackendName() const
+    {
+#if defined(HEADLESS_EGL)
+        return "EGL (surfaceless)";
+#elif defined(HEADLESS_OSMESA)
+        return "OSMesa";
+#else
+        return "GLFW (hidden window)";
+#endif
+    }
+
+private:
+    bool created;
+#if defined(HEADLESS_EGL)
+    EGLDisplay display;
+    EGLContext context;
+#elif defined(HEADLESS_OSMESA)
+    OSMesaContext context;
+    std::vector<unsigned char> colorBuffer;
+#else
+    GLFWwindow* window;
+#endif
+};
+
+// RGBA8 framebuffer which receives the final image, so it can be read back
+class OffscreenTarget
+{
+public:
+    OffscreenTarget(unsigned int _width, unsigned int _height) : width(_width), height(_height)
+    {
+        glGenFramebuffers(1, &FBO);
+        glBindFramebuffer(GL_FRAMEBUFFER, FBO);
+
+        glGenTextures(1, &colorTexture);
+        glBindTexture(GL_TEXTURE_2D, colorTexture);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, colorTexture, 0);
+
+        // the renderer clears depth & stencil of its output like the default framebuffer
+        glGenRenderbuffers(1, &rboDepthStencil);
+        glBindRenderbuffer(GL_RENDERBUFFER, rboDepthStencil);
+        glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH24_STENCIL8, width, height);
+        glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_RENDERBUFFER, rboDepthStencil);
+
+        if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+            std::cout << "Offscreen framebuffer not complete!" << std::endl;
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    }
+
+    ~OffscreenTarget()
+    {
+        glDeleteRenderbuffers(1, &rboDepthStencil);
+        glDeleteTextures(1, &colorTexture);
+        glDeleteFramebuffers(1, &FBO);
+    }
+
+    // read the image back (RGBA, rows bottom-up)
+    void readPixels(std::vector<unsigned char>& pixels) const
+    {
+        pixels.resize(static_cast<size_t>(width) * height * 4);
+        glBindFramebuffer(GL_READ_FRAMEBUFFER, FBO);
+        glReadBuffer(GL_COLOR_ATTACHMENT0);
+        glPixelStorei(GL_PACK_ALIGNMENT, 1);
+        glReadPixels(0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, pixels.data());
+        glBindFramebuffer(GL_READ_FRAMEBUFFER, 0);
+    }
+
+    unsigned int getFBO() const
+    {
+        return FBO;
+    }
+
+    unsigned int getWidth() const
+    {
+        return width;
+    }
+
+    unsigned int getHeight() const
+    {
+        return height;
+    }
+
+private:
+    unsigned int width;
+    unsigned int height;
+
+    unsigned int FBO;
+    unsigned int colorTexture;
+    unsigned int rboDepthStencil;
+};
+
+#endif
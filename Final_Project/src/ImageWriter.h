@@ -0,0 +1,120 @@
+#ifndef IMAGE_WRITER_H
+#define IMAGE_WRITER_H
+
+#include <algorithm>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+// Minimal PNG writer (8 bit gray/RGB/RGBA), so that rendered frames can be saved without another library.
+// The image data is stored in uncompressed deflate blocks: the files are bigger, but any PNG reader
+// (including stb_image) can read them back.
+namespace ImageWriter
+{
+    inline unsigned int crc32(const unsigned char* data, size_t length, unsigned int crc = 0)
+    {
+        static unsigned int table[256];
+        static bool tableReady = false;
+        if (!tableReady)
+        {
+            for (unsigned int n = 0; n < 256; n++)
+            {
+                unsigned int c = n;
+                for (int k = 0; k < 8; k++)
+                    c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+                table[n] = c;
+            }
+            tableReady = true;
+        }
+        crc = ~crc;
+        for (size_t i = 0; i < length; i++)
+            crc = table[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+        return ~crc;
+    }
+
+    inline void appendBigEndian(std::vector<unsigned char>& out, unsigned int value)
+    {
+        out.push_back((value >> 24) & 0xFF);
+        out.push_back((value >> 16) & 0xFF);
+        out.push_back((value >> 8) & 0xFF);
+        out.push_back(value & 0xFF);
+    }
+
+    inline void appendChunk(std::vector<unsigned char>& out, const char* type, const std::vector<unsigned char>& data)
+    {
+        appendBigEndian(out, static_cast<unsigned int>(data.size()));
+        size_t typeStart = out.size();
+        out.insert(out.end(), type, type + 4);
+        out.insert(out.end(), data.begin(), data.end());
+        appendBigEndian(out, crc32(&out[typeStart], out.size() - typeStart));
+    }
+
+    // flipVertically: the rows are given bottom-up (e.g. from glReadPixels)
+    inline bool writePNG(const std::string& path, int width, int height, int channels, const unsigned char* pixels, bool flipVertically)
+    {
+        static const unsigned char colorTypes[5] = { 0, 0, 4, 2, 6 }; // gray, gray+alpha, RGB, RGBA
+        if (channels < 1 || channels > 4 || width <= 0 || height <= 0)
+            return false;
+
+        // raw scanlines: filter type 0 + row data
+        size_t rowSize = static_cast<size_t>(width) * channels;
+        std::vector<unsigned char> raw;
+        raw.reserve((rowSize + 1) * height);
+        for (int y = 0; y < height; y++)
+        {
+            int srcY = flipVertically ? height - 1 - y : y;
+            raw.push_back(0);
+            raw.insert(raw.end(), pixels + srcY * rowSize, pixels + (srcY + 1) * rowSize);
+        }
+
+        // zlib stream made of stored blocks
+        std::vector<unsigned char> zlib;
+        zlib.push_back(0x78);
+        zlib.push_back(0x01);
+        size_t offset = 0;
+        do
+        {
+            size_t blockSize = std::min<size_t>(65535, raw.size() - offset);
+            bool last = offset + blockSize == raw.size();
+            zlib.push_back(last ? 1 : 0);
+            zlib.push_back(blockSize & 0xFF);
+            zlib.push_back((blockSize >> 8) & 0xFF);
+            zlib.push_back(~blockSize & 0xFF);
+            zlib.push_back((~blockSize >> 8) & 0xFF);
+            zlib.insert(zlib.end(), raw.begin() + offset, raw.begin() + offset + blockSize);
+            offset += blockSize;
+        } while (offset < raw.size());
+
+        unsigned int a = 1, b = 0;
+        for (size_t i = 0; i < raw.size(); i++)
+        {
+            a = (a + raw[i]) % 65521;
+            b = (b + a) % 65521;
+        }
+        appendBigEndian(zlib, (b << 16) | a);
+
+        std::vector<unsigned char> header;
+        appendBigEndian(header, width);
+        appendBigEndian(header, height);
+        header.push_back(8); // bit depth
+        header.push_back(colorTypes[channels]);
+        header.push_back(0); // compression
+        header.push_back(0); // filter
+        header.push_back(0); // no interlace
+
+        static const unsigned char signature[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+        std::vector<unsigned char> png(signature, signature + 8);
+        appendChunk(png, "IHDR", header);
+        appendChunk(png, "IDAT", zlib);
+        appendChunk(png, "IEND", std::vector<unsigned char>());
+
+        FILE* file = std::fopen(path.c_str(), "wb");
+        if (!file)
+            return false;
+        bool ok = std::fwrite(png.data(), 1, png.size(), file) == png.size();
+        std::fclose(file);
+        return ok;
+    }
+}
+
+#endif
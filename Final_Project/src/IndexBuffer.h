@@ -0,0 +1,37 @@
+#ifndef INDEX_BUFFER_H
+#define INDEX_BUFFER_H
+
+#include <glad/glad.h>
+
+#include <cstddef>
+#include <vector>
+
+// Element buffers with the smallest index type: GL_UNSIGNED_SHORT when every index fits (up to 65536 vertices),
+// GL_UNSIGNED_INT otherwise. Half the memory & bandwidth of the indices for the usual submeshes.
+namespace IndexBuffer
+{
+    inline GLenum getType(size_t vertexCount)
+    {
+        return vertexCount <= 65536 ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT;
+    }
+
+    inline const char* getTypeName(GLenum type)
+    {
+        return type == GL_UNSIGNED_SHORT ? "16-bit" : "32-bit";
+    }
+
+    // into the bound GL_ELEMENT_ARRAY_BUFFER, returns its size in bytes
+    inline size_t upload(const std::vector<unsigned int>& indices, GLenum type)
+    {
+        if (type == GL_UNSIGNED_SHORT)
+        {
+            std::vector<unsigned short> shortIndices(indices.begin(), indices.end());
+            glBufferData(GL_ELEMENT_ARRAY_BUFFER, shortIndices.size() * sizeof(unsigned short), shortIndices.data(), GL_STATIC_DRAW);
+            return shortIndices.size() * sizeof(unsigned short);
+        }
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned int), indices.data(), GL_STATIC_DRAW);
+        return indices.size() * sizeof(unsigned int);
+    }
+}
+
+#endif
@@ -0,0 +1,282 @@
+#ifndef INPUT_LOG_H
+#define INPUT_LOG_H
+
+#include <GLFW/glfw3.h>
+
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+// Input recording & replay
+// Record: every frame writes its deltaTime and the state of the keys read by processInput, followed by
+// the GLFW callbacks (cursor, mouse button, scroll) received while polling the events of that frame.
+// Replay: the frames are fed back in the same order, the keys come from the log and the callbacks are
+// called with the recorded arguments, so the program goes through exactly the same states.
+//
+// Binary format (little endian):
+//   header "GLIR" + uint32 version
+//   frame  : uint8 FRAME  + float deltaTime + uint16 key bits
+//   cursor : uint8 CURSOR + double x + double y
+//   button : uint8 BUTTON + int32 button + int32 action + int32 mods
+//   scroll : uint8 SCROLL + double xoffset + double yoffset
+class InputLog
+{
+public:
+    enum Mode
+    {
+        MODE_NONE,
+        MODE_RECORD,
+        MODE_REPLAY
+    };
+
+    InputLog() : mode(MODE_NONE), keyBits(0), readPos(0), frameCount(0), cursorCallback(NULL), buttonCallback(NULL), scrollCallback(NULL) {}
+
+    ~InputLog()
+    {
+        close();
+    }
+
+    bool startRecording(const std::string& path)
+    {
+        out.open(path, std::ios::binary);
+        if (!out)
+        {
+            std::cout << "InputLog: can't write " << path << std::endl;
+            return false;
+        }
+        unsigned int version = VERSION;
+        out.write(MAGIC, 4);
+        writeValue(version);
+        mode = MODE_RECORD;
+        std::cout << "Recording input to " << path << std::endl;
+        return true;
+    }
+
+    bool startReplay(const std::string& path)
+    {
+        std::ifstream in(path, std::ios::binary);
+        if (!in)
+        {
+            std::cout << "InputLog: can't read " << path << std::endl;
+            return false;
+        }
+        data.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+
+        unsigned int version = 0;
+        if (data.size() >= 8)
+            std::memcpy(&version, &data[4], 4);
+        if (data.size() < 8 || std::memcmp(data.data(), MAGIC, 4) != 0 || version != VERSION)
+        {
+            std::cout << "InputLog: " << path << " is not an input log (version " << VERSION << ")" << std::endl;
+            data.clear();
+            return false;
+        }
+        readPos = 8;
+        mode = MODE_REPLAY;
+        std::cout << "Replaying input from " << path << std::endl;
+        return true;
+    }
+
+    void close()
+    {
+        if (mode == MODE_RECORD)
+        {
+            out.close();
+            std::cout << "Input log: " << frameCount << " frames recorded" << std::endl;
+        }
+        mode = MODE_NONE;
+    }
+
+    Mode getMode() const
+    {
+        return mode;
+    }
+
+    // the handlers called during replay (the same ones GLFW calls)
+    void setCallbacks(GLFWcursorposfun _cursorCallback, GLFWmousebuttonfun _buttonCallback, GLFWscrollfun _scrollCallback)
+    {
+        cursorCallback = _cursorCallback;
+        buttonCallback = _buttonCallback;
+        scrollCallback = _scrollCallback;
+    }
+
+    // Start of a frame. Record: save deltaTime & keys. Replay: replace deltaTime by the recorded one.
+    // Returns false when the replay is over.
+    bool beginFrame(GLFWwindow* window, float& deltaTime)
+    {
+        if (mode == MODE_RECORD)
+        {
+            keyBits = 0;
+            for (int i = 0; i < NUM_KEYS; i++)
+            {
+                if (glfwGetKey(window, KEYS[i]) == GLFW_PRESS)
+                    keyBits |= 1 << i;
+            }
+            writeType(EVENT_FRAME);
+            writeValue(deltaTime);
+            writeValue(keyBits);
+            frameCount++;
+        }
+        else if (mode == MODE_REPLAY)
+        {
+            if (readPos >= data.size() || data[readPos] != EVENT_FRAME)
+            {
+                std::cout << "Input replay finished (" << frameCount << " frames)" << std::endl;
+                mode = MODE_NONE;
+                return false;
+            }
+            readPos++;
+            readValue(deltaTime);
+            readValue(keyBits);
+            frameCount++;
+        }
+        return true;
+    }
+
+    // Replay: call the recorded callbacks of this frame (instead of polling GLFW)
+    void dispatchEvents(GLFWwindow* window)
+    {
+        if (mode != MODE_REPLAY)
+            return;
+        while (readPos < data.size() && data[readPos] != EVENT_FRAME)
+        {
+            unsigned char type = data[readPos++];
+            if (type == EVENT_CURSOR)
+            {
+                double x, y;
+                readValue(x);
+                readValue(y);
+                if (cursorCallback)
+                    cursorCallback(window, x, y);
+            }
+            else if (type == EVENT_BUTTON)
+            {
+                int button, action, mods;
+                readValue(button);
+                readValue(action);
+                readValue(mods);
+                if (buttonCallback)
+                    buttonCallback(window, button, action, mods);
+            }
+            else if (type == EVENT_SCROLL)
+            {
+                double xoffset, yoffset;
+                readValue(xoffset);
+                readValue(yoffset);
+                if (scrollCallback)
+                    scrollCallback(window, xoffset, yoffset);
+            }
+            else
+            {
+                std::cout << "InputLog: corrupted log" << std::endl;
+                readPos = data.size();
+            }
+        }
+    }
+
+    // replacement of glfwGetKey for processInput
+    int getKey(GLFWwindow* window, int key) const
+    {
+        if (mode != MODE_REPLAY)
+            return glfwGetKey(window, key);
+        for (int i = 0; i < NUM_KEYS; i++)
+        {
+            if (KEYS[i] == key)
+                return (keyBits & (1 << i)) ? GLFW_PRESS : GLFW_RELEASE;
+        }
+        return GLFW_RELEASE;
+    }
+
+    void recordCursor(double x, double y)
+    {
+        if (mode != MODE_RECORD)
+            return;
+        writeType(EVENT_CURSOR);
+        writeValue(x);
+        writeValue(y);
+    }
+
+    void recordButton(int button, int action, int mods)
+    {
+        if (mode != MODE_RECORD)
+            return;
+        writeType(EVENT_BUTTON);
+        writeValue(button);
+        writeValue(action);
+        writeValue(mods);
+    }
+
+    void recordScroll(double xoffset, double yoffset)
+    {
+        if (mode != MODE_RECORD)
+            return;
+        writeType(EVENT_SCROLL);
+        writeValue(xoffset);
+        writeValue(yoffset);
+    }
+
+private:
+    enum EventType
+    {
+        EVENT_FRAME = 1,
+        EVENT_CURSOR = 2,
+        EVENT_BUTTON = 3,
+        EVENT_SCROLL = 4
+    };
+
+    static const unsigned int VERSION = 1;
+    static const char MAGIC[4];
+    static const int NUM_KEYS = 15;
+    static const int KEYS[NUM_KEYS];
+
+    void writeType(EventType type)
+    {
+        unsigned char byte = static_cast<unsigned char>(type);
+        out.write(reinterpret_cast<const char*>(&byte), 1);
+    }
+
+    template <typename T>
+    void writeValue(const T& value)
+    {
+        out.write(reinterpret_cast<const char*>(&value), sizeof(T));
+    }
+
+    template <typename T>
+    void readValue(T& value)
+    {
+        if (readPos + sizeof(T) > data.size())
+        {
+            std::memset(&value, 0, sizeof(T));
+            readPos = data.size();
+            return;
+        }
+        std::memcpy(&value, &data[readPos], sizeof(T));
+        readPos += sizeof(T);
+    }
+
+    Mode mode;
+    unsigned short keyBits;
+
+    std::ofstream out;
+    std::vector<unsigned char> data;
+    size_t readPos;
+    unsigned int frameCount;
+
+    GLFWcursorposfun cursorCallback;
+    GLFWmousebuttonfun buttonCallback;
+    GLFWscrollfun scrollCallback;
+};
+
+const char InputLog::MAGIC[4] = { 'G', 'L', 'I', 'R' };
+
+// every key read by processInput
+const int InputLog::KEYS[InputLog::NUM_KEYS] = {
+    GLFW_KEY_ESCAPE, GLFW_KEY_UP, GLFW_KEY_DOWN, GLFW_KEY_RIGHT, GLFW_KEY_LEFT,
+    GLFW_KEY_W, GLFW_KEY_S, GLFW_KEY_A, GLFW_KEY_D,
+    GLFW_KEY_R, GLFW_KEY_E, GLFW_KEY_Q, GLFW_KEY_T, GLFW_KEY_F, GLFW_KEY_P
+};
+
+#endif
@@ -0,0 +1,153 @@
+#ifndef MATERIAL_ARRAYS_H
+#define MATERIAL_ARRAYS_H
+
+#include <glad/glad.h>
+
+#include <iostream>
+#include <map>
+#include <tuple>
+#include <vector>
+
+#include "Shader.h"
+#include "TextureCache.h"
+
+// The materials of a Model packed into GL_TEXTURE_2D_ARRAYs, so the whole model is drawn with one set of bindings
+// The textures are grouped by size & format (one array per group, a texture is a layer of it). A material is the
+// array & layer of its diffuse and specular textures: the table (materials[]) is set once per draw of the model,
+// each mesh only sets its materialID.
+// The arrays are textures of the TextureCache (acquireArray()): counted in its budget, and shrunk like the other
+// textures when the model isn't drawn for a while.
+// GLSL 3.30 can't index an array of samplers with a variable, pointShadowShader picks the array with branches
+// (the same for the whole draw).
+class MaterialArrays
+{
+public:
+    static const int MAX_ARRAYS = 8;      // samplers materialArray0 ... 7
+    static const int MAX_MATERIALS = 64;  // same as pointShadowShader.frag
+    static const int FIRST_UNIT = 3;      // after meshTexture, shadowMap & scene
+
+    MaterialArrays() : built(false) {}
+
+    ~MaterialArrays()
+    {
+        for (unsigned int i = 0; i < arrays.size(); i++)
+            TextureCache::instance().release(arrays[i]);
+    }
+
+    MaterialArrays(const MaterialArrays&) = delete;
+    MaterialArrays& operator=(const MaterialArrays&) = delete;
+
+    // the index of the material made of these textures (0: no texture), added if it's new
+    int addMaterial(unsigned int diffuse, unsigned int specular)
+    {
+        std::pair<unsigned int, unsigned int> key(diffuse, specular);
+        std::map<std::pair<unsigned int, unsigned int>, int>::iterator it = materialIDs.find(key);
+        if (it != materialIDs.end())
+            return it->second;
+        int id = static_cast<int>(materials.size());
+        materials.push_back(key);
+        materialIDs[key] = id;
+        return id;
+    }
+
+    // copy the textures of the materials into the arrays
+    // false if they don't fit (too many materials or groups): the meshes keep binding their own textures
+    bool build()
+    {
+        if (materials.empty() || materials.size() > MAX_MATERIALS)
+            return false;
+
+        // the layers of each group
+        std::map<std::tuple<int, int, GLint, int>, unsigned int> groups;
+        std::map<unsigned int, Slot> slots;
+        std::vector<std::vector<unsigned int>> layers;
+        for (unsigned int m = 0; m < materials.size(); m++)
+        {
+            unsigned int textures[2] = { materials[m].first, materials[m].second };
+            for (unsigned int t = 0; t < 2; t++)
+            {
+                const TextureCache::Info* info = TextureCache::instance().getInfo(textures[t]);
+                if (textures[t] == 0 || info == nullptr || slots.count(textures[t]) > 0)
+                    continue;
+                GLint internalFormat = 0;
+                glBindTexture(GL_TEXTURE_2D, textures[t]);
+                glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_INTERNAL_FORMAT, &internalFormat);
+                glBindTexture(GL_TEXTURE_2D, 0);
+
+                std::tuple<int, int, GLint, int> group(info->width, info->height, internalFormat, info->levels);
+                if (groups.count(group) == 0)
+                {
+                    if (groups.size() == MAX_ARRAYS)
+                        return false;
+                    unsigned int index = static_cast<unsigned int>(groups.size());
+                    groups[group] = index;
+                    layers.push_back(std::vector<unsigned int>());
+                }
+                Slot slot = { static_cast<int>(groups[group]), static_cast<int>(layers[groups[group]].size()) };
+                slots[textures[t]] = slot;
+                layers[groups[group]].push_back(textures[t]);
+            }
+        }
+
+        size_t bytes = 0;
+        for (unsigned int a = 0; a < layers.size(); a++)
+        {
+            arrays.push_back(TextureCache::instance().acquireArray(layers[a]));
+            bytes += TextureCache::instance().getInfo(arrays.back())->bytes;
+        }
+
+        // diffuse array & layer, specular array & layer (-1: none)
+        table.assign(materials.size() * 4, -1);
+        for (unsigned int m = 0; m < materials.size(); m++)
+        {
+            if (slots.count(materials[m].first) > 0)
+            {
+                table[m * 4] = slots[materials[m].first].array;
+                table[m * 4 + 1] = slots[materials[m].first].layer;
+            }
+            if (slots.count(materials[m].second) > 0)
+            {
+                table[m * 4 + 2] = slots[materials[m].second].array;
+                table[m * 4 + 3] = slots[materials[m].second].layer;
+            }
+        }
+        built = true;
+        std::cout << "Material arrays: " << materials.size() << " materials, " << slots.size() << " textures in " << arrays.size()
+            << " arrays (" << bytes / 1024 << " KB)" << std::endl;
+        return true;
+    }
+
+    bool isBuilt() const
+    {
+        return built;
+    }
+
+    // the arrays & the material table, once for the whole model
+    void bind(const Shader& shader) const
+    {
+        for (unsigned int i = 0; i < arrays.size(); i++)
+        {
+            glActiveTexture(GL_TEXTURE0 + FIRST_UNIT + i);
+            // a shrunk array is restored first
+            TextureCache::instance().touch(arrays[i]);
+            glBindTexture(GL_TEXTURE_2D_ARRAY, arrays[i]);
+        }
+        glActiveTexture(GL_TEXTURE0);
+        glUniform4iv(glGetUniformLocation(shader.ID, "materials"), static_cast<GLsizei>(materials.size()), table.data());
+    }
+
+private:
+    struct Slot
+    {
+        int array;
+        int layer;
+    };
+
+    bool built;
+    std::vector<std::pair<unsigned int, unsigned int>> materials;  // diffuse & specular textures
+    std::map<std::pair<unsigned int, unsigned int>, int> materialIDs;
+    std::vector<unsigned int> arrays;  // textures of the cache
+    std::vector<int> table;  // materials[] of the shader
+};
+
+#endif
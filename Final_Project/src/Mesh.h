@@ -1,19 +1,23 @@
 #ifndef MESH_H
 #define MESH_H
 #include "shader.h"
+#include "MeshOptimizer.h"
+#include "IndexBuffer.h"
+#include "Bvh.h"
 #include <glad/glad.h>
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 #include <assert.h>
 #include <vector>
 #include <utility>
+#include <iostream>
 
 // My mesh (different from assimp mesh)
 class Mesh 
 {
 public:
 	Mesh(glm::vec3 initialPosition) 
-		: xAngle(0.0f), yAngle(0.0f), zAngle(0.0f), numIndices(0), numVertices(0), xmax(0.0f), xmin(0.0f), ymax(0.0f), ymin(0.0f), zmax(0.0f), zmin(0.0f), rotation(glm::mat4(1.0f)), translateDiff(initialPosition), bloomR(0.01) {}
+		: indexType(GL_UNSIGNED_INT), numIndices(0), numVertices(0), xAngle(0.0f), yAngle(0.0f), zAngle(0.0f), rotation(glm::mat4(1.0f)), translateDiff(initialPosition), bloomR(0.01), xmax(0.0f), xmin(0.0f), ymax(0.0f), ymin(0.0f), zmax(0.0f), zmin(0.0f) {}
 
 	void draw_blinn_phong(Shader& shader, const glm::mat4& projection, const glm::mat4& view, const glm::vec3 viewPos, const glm::vec3* lightPos)
 	{
@@ -49,7 +53,7 @@ public:
 		// render 
 		glBindVertexArray(this->VAO);
 
-		glDrawElements(GL_TRIANGLES, numIndices, GL_UNSIGNED_INT, (void*)0);
+		glDrawElements(GL_TRIANGLES, numIndices, indexType, (void*)0);
 
 		glBindVertexArray(0);
 	}
@@ -65,12 +69,12 @@ public:
 		// render 
 		glBindVertexArray(this->VAO);
 
-		glDrawArrays(GL_TRIANGLES, 0, numVertices);
+		glDrawElements(GL_TRIANGLES, numIndices, indexType, (void*)0);
 
 		glBindVertexArray(0);
 	}
-	// Can accept toon or blinn-phong(non-toon)
-	void draw_point_shadow(Shader& pointShadowShader, Shader& singleColorShader, const glm::mat4& projection, const glm::mat4& view, const glm::vec3 viewPos, const glm::vec3 lightPos, myTexture2D& texture, unsigned int& depthCubeMap, unsigned int& sceneTexture, const float& invisible, const float& far_plane, const bool& normalize, const bool& stencil, const bool& drawShadow)
+	// Can accept any variant of pointShadowShader (toon or blinn-phong, with or without shadow)
+	void draw_point_shadow(Shader& pointShadowShader, Shader& singleColorShader, const glm::mat4& projection, const glm::mat4& view, const glm::vec3 viewPos, const glm::vec3 lightPos, myTexture2D& texture, unsigned int& depthCubeMap, unsigned int& sceneTexture, const float& invisible, const float& far_plane, const bool& normalize, const bool& stencil)
 	{
 		// use the shader
 		pointShadowShader.use();
@@ -85,9 +89,6 @@ public:
 		pointShadowShader.setFloat("far_plane", far_plane);
 		pointShadowShader.setFloat("invisible", invisible);
 
-		pointShadowShader.setBool("meshOrModel", true);
-		pointShadowShader.setBool("drawShadow", drawShadow);
-
 		// model matrix
 		auto model = getModelMatrix(normalize);
 		pointShadowShader.setMat4("model", model);
@@ -111,7 +112,7 @@ public:
 		// render the frame of the object
 		glBindVertexArray(this->VAO);
 
-		glDrawArrays(GL_TRIANGLES, 0, numVertices);
+		glDrawElements(GL_TRIANGLES, numIndices, indexType, (void*)0);
 		
 		if (stencil)
 		{
@@ -127,7 +128,7 @@ public:
 			singleColorShader.setMat4("view", view);
 			singleColorShader.setFloat("bloomR", bloomR);
 
-			glDrawArrays(GL_TRIANGLES, 0, numVertices);
+			glDrawElements(GL_TRIANGLES, numIndices, indexType, (void*)0);
 		}
 
 		glBindVertexArray(0);
@@ -141,6 +142,33 @@ public:
 	}
 
 
+	Bvh::Aabb getWorldBounds(const bool& normalize)
+	{
+		Bvh::Aabb box = { glm::vec3(xmin, ymin, zmin), glm::vec3(xmax, ymax, zmax) };
+		return Bvh::transform(box, getModelMatrix(normalize));
+	}
+
+	// nearest triangle hit by a world space ray, t in units of direction
+	bool intersectRay(const glm::vec3& origin, const glm::vec3& direction, const bool& normalize, float& t)
+	{
+		// in object space (t doesn't change)
+		glm::mat4 inverse = glm::inverse(getModelMatrix(normalize));
+		glm::vec3 o = glm::vec3(inverse * glm::vec4(origin, 1.0f));
+		glm::vec3 d = glm::vec3(inverse * glm::vec4(direction, 0.0f));
+		bool hit = false;
+		for (unsigned int i = 0; i + 2 < pickIndices.size(); i += 3)
+		{
+			float distance;
+			if (Bvh::intersectTriangle(o, d, pickPositions[pickIndices[i]], pickPositions[pickIndices[i + 1]], pickPositions[pickIndices[i + 2]], distance) &&
+				(!hit || distance < t))
+			{
+				t = distance;
+				hit = true;
+			}
+		}
+		return hit;
+	}
+
 	glm::mat4 getModelMatrix(const bool& normalize)
 	{
 		glm::mat4 identity(1.0f);
@@ -344,36 +372,11 @@ public:
 
 		assert(vertices.size() % 8 == 0);
 
-		numVertices = vertices.size() / 8;
-
-		unsigned int VBO;
-
-		// VAO
-		glGenVertexArrays(1, &this->VAO);
-
-		// Attribute Array and Buffer
-		glBindVertexArray(this->VAO);
-
-		// VBO
-		glGenBuffers(1, &VBO);
-		glBindBuffer(GL_ARRAY_BUFFER, VBO);
-		glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(float), &vertices.front(), GL_STATIC_DRAW);
-
-
-		// position
-		glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)0);
-		glEnableVertexAttribArray(0);
-
-		// normal
-		glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)(3 * sizeof(float)));
-		glEnableVertexAttribArray(1);
-
-		// UV
-		glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)(6 * sizeof(float)));
-		glEnableVertexAttribArray(2);
-
-		glBindBuffer(GL_ARRAY_BUFFER, 0);
-		glBindVertexArray(0);
+		// one vertex per corner: merged & reordered into an indexed mesh
+		std::vector<unsigned int> indices;
+		MeshOptimizer::Report report = MeshOptimizer::optimize(vertices, 8, indices);
+		upload(vertices, indices, 8);
+		std::cout << filepath << ": " << report.inputVertices << " -> " << report.vertices << " vertices, ACMR " << report.before.acmr << " -> " << report.after.acmr << ", " << IndexBuffer::getTypeName(indexType) << " indices" << std::endl;
 	}
 
 	void load_block()
@@ -431,36 +434,9 @@ public:
 		zmax = 0.5f;
 		zmin = -0.5f;
 
-		numVertices = vertices.size() / 8;
-
-		unsigned int VBO;
-
-		// VAO
-		glGenVertexArrays(1, &this->VAO);
-
-		// Attribute Array and Buffer
-		glBindVertexArray(this->VAO);
-
-		// VBO
-		glGenBuffers(1, &VBO);
-		glBindBuffer(GL_ARRAY_BUFFER, VBO);
-		glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(float), &vertices.front(), GL_STATIC_DRAW);
-
-
-		// position
-		glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)0);
-		glEnableVertexAttribArray(0);
-
-		// normal
-		glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)(3 * sizeof(float)));
-		glEnableVertexAttribArray(1);
-
-		// UV
-		glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)(6 * sizeof(float)));
-		glEnableVertexAttribArray(2);
-
-		glBindBuffer(GL_ARRAY_BUFFER, 0);
-		glBindVertexArray(0);
+		std::vector<unsigned int> indices;
+		MeshOptimizer::optimize(vertices, 8, indices);
+		upload(vertices, indices, 8);
 	}
 
 	// for obj file that only contain vertices and faces
@@ -535,8 +511,23 @@ public:
 			updateNormal(vertices, tmpind);
 		}
 
+		MeshOptimizer::optimize(vertices, 6, indices);
+		upload(vertices, indices, 6);
+	}
+private:
+
+	// VAO of an indexed mesh: position, normal (and UV with 8 floats per vertex)
+	void upload(const std::vector<float>& vertices, const std::vector<unsigned int>& indices, unsigned int floatsPerVertex)
+	{
+		numVertices = vertices.size() / floatsPerVertex;
 		numIndices = indices.size();
 
+		// the triangles are kept for picking
+		pickPositions.resize(numVertices);
+		for (unsigned int i = 0; i < numVertices; i++)
+			pickPositions[i] = glm::vec3(vertices[i * floatsPerVertex], vertices[i * floatsPerVertex + 1], vertices[i * floatsPerVertex + 2]);
+		pickIndices = indices;
+
 		unsigned int VBO;
 		unsigned int EBO;
 
@@ -551,24 +542,30 @@ public:
 		glBindBuffer(GL_ARRAY_BUFFER, VBO);
 		glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(float), &vertices.front(), GL_STATIC_DRAW);
 
-
 		// EBO
 		glGenBuffers(1, &EBO);
 		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
-		glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned int), &indices.front(), GL_STATIC_DRAW);
+		indexType = IndexBuffer::getType(numVertices);
+		IndexBuffer::upload(indices, indexType);
 
 		// position
-		glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(float), (void*)0);
+		glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, floatsPerVertex * sizeof(float), (void*)0);
 		glEnableVertexAttribArray(0);
 
 		// normal
-		glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(float), (void*)(3 * sizeof(float)));
+		glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, floatsPerVertex * sizeof(float), (void*)(3 * sizeof(float)));
 		glEnableVertexAttribArray(1);
 
+		// UV
+		if (floatsPerVertex == 8)
+		{
+			glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, floatsPerVertex * sizeof(float), (void*)(6 * sizeof(float)));
+			glEnableVertexAttribArray(2);
+		}
+
 		glBindBuffer(GL_ARRAY_BUFFER, 0);
 		glBindVertexArray(0);
 	}
-private:
 
 	glm::vec3 getNormal(const glm::vec3* vertices)
 	{
@@ -601,6 +598,7 @@ private:
 	}
 
 	unsigned int VAO;
+	GLenum indexType;
 	unsigned int numIndices;
 	unsigned int numVertices; // for spot.obj
 
@@ -619,6 +617,9 @@ private:
 	float ymin;
 	float zmax;
 	float zmin;
+
+	std::vector<glm::vec3> pickPositions;
+	std::vector<unsigned int> pickIndices;
 };
 
 
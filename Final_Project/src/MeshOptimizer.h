@@ -0,0 +1,383 @@
+#ifndef MESH_OPTIMIZER_H
+#define MESH_OPTIMIZER_H
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <vector>
+
+// Import-time optimization of the indexed triangle lists (AssimpMesh & Mesh)
+// 1. identical vertices (same bytes) are merged with a hash table
+// 2. the triangles are reordered for the post-transform vertex cache (Tipsify, Sander et al. 2007)
+// 3. the clusters of (2) are sorted so that the outer, front-facing ones come first: less overdraw
+//    from any direction, for a small loss of cache efficiency (threshold)
+// 4. the vertices are reordered by first use for the vertex fetch
+// The cache is simulated as a FIFO of CACHE_SIZE vertices:
+// ACMR = transformed vertices / triangle (0.5 at best, 3 without reuse), ATVR = transformed vertices / vertex (1 at best)
+namespace MeshOptimizer
+{
+    const unsigned int CACHE_SIZE = 16;
+
+    struct Stats
+    {
+        float acmr;
+        float atvr;
+    };
+
+    struct Report
+    {
+        unsigned int inputVertices;
+        unsigned int vertices; // after the merge
+        unsigned int triangles;
+        Stats before;          // merged, triangles in file order
+        Stats after;
+    };
+
+    inline Stats analyzeVertexCache(const std::vector<unsigned int>& indices, unsigned int vertexCount)
+    {
+        std::vector<unsigned int> timestamps(vertexCount, 0);
+        unsigned int time = CACHE_SIZE + 1, misses = 0, used = 0;
+        for (unsigned int i = 0; i < indices.size(); i++)
+        {
+            unsigned int v = indices[i];
+            if (timestamps[v] == 0)
+                used++;
+            if (time - timestamps[v] > CACHE_SIZE)
+            {
+                timestamps[v] = time++;
+                misses++;
+            }
+        }
+        Stats stats;
+        stats.acmr = indices.empty() ? 0.0f : static_cast<float>(misses) / (indices.size() / 3);
+        stats.atvr = used == 0 ? 0.0f : static_cast<float>(misses) / used;
+        return stats;
+    }
+
+    // remap[i]: the first vertex with the same bytes as vertex i, renumbered from 0; returns the number of unique vertices
+    inline unsigned int generateRemap(const unsigned char* vertices, unsigned int vertexCount, size_t stride, std::vector<unsigned int>& remap)
+    {
+        remap.assign(vertexCount, ~0u);
+        size_t buckets = 1;
+        while (buckets < vertexCount + vertexCount / 4)
+            buckets *= 2;
+        std::vector<unsigned int> table(buckets, ~0u); // original vertex of each bucket (open addressing)
+        unsigned int unique = 0;
+        for (unsigned int i = 0; i < vertexCount; i++)
+        {
+            const unsigned char* vertex = vertices + i * stride;
+            // FNV-1a
+            unsigned int hash = 2166136261u;
+            for (size_t b = 0; b < stride; b++)
+                hash = (hash ^ vertex[b]) * 16777619u;
+
+            size_t bucket = hash & (buckets - 1);
+            for (size_t probe = 1; table[bucket] != ~0u; probe++)
+            {
+                if (memcmp(vertices + table[bucket] * stride, vertex, stride) == 0)
+                    break;
+                bucket = (bucket + probe) & (buckets - 1);
+            }
+            if (table[bucket] == ~0u)
+            {
+                table[bucket] = i;
+                remap[i] = unique++;
+            }
+            else
+                remap[i] = remap[table[bucket]];
+        }
+        return unique;
+    }
+
+    // triangles sharing each vertex
+    struct Adjacency
+    {
+        std::vector<unsigned int> counts;
+        std::vector<unsigned int> offsets;
+        std::vector<unsigned int> triangles;
+
+        Adjacency(const std::vector<unsigned int>& indices, unsigned int vertexCount)
+            : counts(vertexCount, 0), offsets(vertexCount, 0), triangles(indices.size())
+        {
+            for (unsigned int i = 0; i < indices.size(); i++)
+                counts[indices[i]]++;
+            unsigned int offset = 0;
+            for (unsigned int v = 0; v < vertexCount; v++)
+            {
+                offsets[v] = offset;
+                offset += counts[v];
+            }
+            std::vector<unsigned int> filled(offsets);
+            for (unsigned int i = 0; i < indices.size(); i++)
+                triangles[filled[indices[i]]++] = i / 3;
+        }
+    };
+
+    // Tipsify: fan around a vertex until its triangles are emitted, then continue with the vertex of the last
+    // triangles which stays in the cache; clusters gets the first triangle of every restart (cache flushed)
+    inline void optimizeVertexCache(std::vector<unsigned int>& indices, unsigned int vertexCount, std::vector<unsigned int>& clusters)
+    {
+        const int cacheSize = static_cast<int>(CACHE_SIZE);
+        unsigned int triangleCount = static_cast<unsigned int>(indices.size() / 3);
+        Adjacency adjacency(indices, vertexCount);
+        std::vector<int> live(adjacency.counts.begin(), adjacency.counts.end());
+        std::vector<int> cacheTime(vertexCount, 0);
+        std::vector<bool> emitted(triangleCount, false);
+        std::vector<unsigned int> deadEnd;
+        std::vector<unsigned int> output;
+        output.reserve(indices.size());
+        clusters.clear();
+
+        int time = cacheSize + 1;
+        unsigned int cursor = 0;
+        int fanning = -1;
+        while (true)
+        {
+            if (fanning < 0)
+            {
+                // dead end: a recent vertex with triangles left, else the next one in input order
+                while (!deadEnd.empty() && fanning < 0)
+                {
+                    unsigned int v = deadEnd.back();
+                    deadEnd.pop_back();
+                    if (live[v] > 0)
+                        fanning = static_cast<int>(v);
+                }
+                while (cursor < vertexCount && fanning < 0)
+                {
+                    if (live[cursor] > 0)
+                        fanning = static_cast<int>(cursor);
+                    cursor++;
+                }
+                if (fanning < 0)
+                    break;
+                clusters.push_back(static_cast<unsigned int>(output.size() / 3));
+            }
+
+            std::vector<unsigned int> candidates;
+            for (unsigned int a = 0; a < adjacency.counts[fanning]; a++)
+            {
+                unsigned int t = adjacency.triangles[adjacency.offsets[fanning] + a];
+                if (emitted[t])
+                    continue;
+                emitted[t] = true;
+                for (unsigned int c = 0; c < 3; c++)
+                {
+                    unsigned int v = indices[t * 3 + c];
+                    output.push_back(v);
+                    deadEnd.push_back(v);
+                    candidates.push_back(v);
+                    live[v]--;
+                    if (time - cacheTime[v] > cacheSize)
+                        cacheTime[v] = time++;
+                }
+            }
+
+            // the candidate which will still be in the cache after its fan, the oldest one first
+            // (none: the dead-end stack is used)
+            int best = -1, bestPriority = 0;
+            for (unsigned int c = 0; c < candidates.size(); c++)
+            {
+                unsigned int v = candidates[c];
+                if (live[v] <= 0)
+                    continue;
+                int priority = 0;
+                if (time - cacheTime[v] + 2 * live[v] <= cacheSize)
+                    priority = time - cacheTime[v];
+                if (priority > bestPriority)
+                {
+                    bestPriority = priority;
+                    best = static_cast<int>(v);
+                }
+            }
+            fanning = best;
+        }
+        indices.swap(output);
+    }
+
+    // sort the clusters by occlusion potential (how far they face outwards); the clusters of Tipsify are split
+    // further where their ACMR so far is within threshold of the whole cluster's
+    inline void optimizeOverdraw(std::vector<unsigned int>& indices, const std::vector<unsigned int>& hardClusters,
+        const float* positions, size_t strideFloats, unsigned int vertexCount, float threshold)
+    {
+        unsigned int triangleCount = static_cast<unsigned int>(indices.size() / 3);
+        if (triangleCount == 0)
+            return;
+
+        // soft boundaries
+        std::vector<unsigned int> clusters;
+        std::vector<unsigned int> timestamps(vertexCount, 0);
+        unsigned int time = CACHE_SIZE + 1;
+        for (unsigned int h = 0; h < hardClusters.size(); h++)
+        {
+            unsigned int start = hardClusters[h];
+            unsigned int end = h + 1 < hardClusters.size() ? hardClusters[h + 1] : triangleCount;
+            unsigned int misses = 0;
+            time += CACHE_SIZE + 1;
+            for (unsigned int i = start * 3; i < end * 3; i++)
+            {
+                if (time - timestamps[indices[i]] > CACHE_SIZE)
+                {
+                    timestamps[indices[i]] = time++;
+                    misses++;
+                }
+            }
+            float clusterAcmr = static_cast<float>(misses) / (end - start);
+
+            clusters.push_back(start);
+            misses = 0;
+            unsigned int clusterStart = start;
+            time += CACHE_SIZE + 1;
+            for (unsigned int t = start; t < end; t++)
+            {
+                for (unsigned int c = 0; c < 3; c++)
+                {
+                    unsigned int v = indices[t * 3 + c];
+                    if (time - timestamps[v] > CACHE_SIZE)
+                    {
+                        timestamps[v] = time++;
+                        misses++;
+                    }
+                }
+                if (t + 1 < end && static_cast<float>(misses) / (t + 1 - clusterStart) <= threshold * clusterAcmr)
+                {
+                    clusters.push_back(t + 1);
+                    clusterStart = t + 1;
+                    misses = 0;
+                    time += CACHE_SIZE + 1;
+                }
+            }
+        }
+
+        // centroid of the mesh (area weighted)
+        float meshCentroid[3] = { 0.0f, 0.0f, 0.0f };
+        float meshArea = 0.0f;
+        std::vector<float> normals(triangleCount * 3), centroids(triangleCount * 3), areas(triangleCount);
+        for (unsigned int t = 0; t < triangleCount; t++)
+        {
+            const float* p0 = positions + indices[t * 3] * strideFloats;
+            const float* p1 = positions + indices[t * 3 + 1] * strideFloats;
+            const float* p2 = positions + indices[t * 3 + 2] * strideFloats;
+            float e1[3] = { p1[0] - p0[0], p1[1] - p0[1], p1[2] - p0[2] };
+            float e2[3] = { p2[0] - p0[0], p2[1] - p0[1], p2[2] - p0[2] };
+            float* n = &normals[t * 3];
+            n[0] = e1[1] * e2[2] - e1[2] * e2[1];
+            n[1] = e1[2] * e2[0] - e1[0] * e2[2];
+            n[2] = e1[0] * e2[1] - e1[1] * e2[0];
+            areas[t] = std::sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+            for (unsigned int k = 0; k < 3; k++)
+            {
+                centroids[t * 3 + k] = (p0[k] + p1[k] + p2[k]) / 3.0f;
+                meshCentroid[k] += centroids[t * 3 + k] * areas[t];
+            }
+            meshArea += areas[t];
+        }
+        for (unsigned int k = 0; k < 3; k++)
+            meshCentroid[k] = meshArea > 0.0f ? meshCentroid[k] / meshArea : 0.0f;
+
+        // dot(cluster centroid - mesh centroid, cluster normal)
+        std::vector<float> sortKeys(clusters.size());
+        for (unsigned int c = 0; c < clusters.size(); c++)
+        {
+            unsigned int end = c + 1 < clusters.size() ? clusters[c + 1] : triangleCount;
+            float centroid[3] = { 0.0f, 0.0f, 0.0f }, normal[3] = { 0.0f, 0.0f, 0.0f }, area = 0.0f;
+            for (unsigned int t = clusters[c]; t < end; t++)
+            {
+                for (unsigned int k = 0; k < 3; k++)
+                {
+                    centroid[k] += centroids[t * 3 + k] * areas[t];
+                    normal[k] += normals[t * 3 + k];
+                }
+                area += areas[t];
+            }
+            float length = std::sqrt(normal[0] * normal[0] + normal[1] * normal[1] + normal[2] * normal[2]);
+            float key = 0.0f;
+            for (unsigned int k = 0; k < 3 && area > 0.0f && length > 0.0f; k++)
+                key += (centroid[k] / area - meshCentroid[k]) * normal[k] / length;
+            sortKeys[c] = key;
+        }
+
+        std::vector<unsigned int> order(clusters.size());
+        for (unsigned int c = 0; c < order.size(); c++)
+            order[c] = c;
+        std::stable_sort(order.begin(), order.end(), [&](unsigned int a, unsigned int b) { return sortKeys[a] > sortKeys[b]; });
+
+        std::vector<unsigned int> output;
+        output.reserve(indices.size());
+        for (unsigned int c = 0; c < order.size(); c++)
+        {
+            unsigned int start = clusters[order[c]];
+            unsigned int end = order[c] + 1 < clusters.size() ? clusters[order[c] + 1] : triangleCount;
+            output.insert(output.end(), indices.begin() + start * 3, indices.begin() + end * 3);
+        }
+        indices.swap(output);
+    }
+
+    // remap[i]: the new index of vertex i in order of first use (~0u: unused); returns the number of used vertices
+    inline unsigned int generateFetchRemap(const std::vector<unsigned int>& indices, unsigned int vertexCount, std::vector<unsigned int>& remap)
+    {
+        remap.assign(vertexCount, ~0u);
+        unsigned int next = 0;
+        for (unsigned int i = 0; i < indices.size(); i++)
+        {
+            if (remap[indices[i]] == ~0u)
+                remap[indices[i]] = next++;
+        }
+        return next;
+    }
+
+    // move vertex i to remap[i] (several vertices may share a destination), count vertices are kept
+    template <typename T>
+    void remapVertices(std::vector<T>& vertices, size_t stride, const std::vector<unsigned int>& remap, unsigned int count)
+    {
+        std::vector<T> output(count * stride);
+        for (unsigned int i = 0; i < remap.size(); i++)
+        {
+            if (remap[i] != ~0u)
+                std::copy(vertices.begin() + i * stride, vertices.begin() + (i + 1) * stride, output.begin() + remap[i] * stride);
+        }
+        vertices.swap(output);
+    }
+
+    inline void remapIndices(std::vector<unsigned int>& indices, const std::vector<unsigned int>& remap)
+    {
+        for (unsigned int i = 0; i < indices.size(); i++)
+            indices[i] = remap[indices[i]];
+    }
+
+    // the whole pass: stride elements of T per vertex, starting with its position (3 floats)
+    // indices may be empty: the vertices are a triangle list then (3 per triangle)
+    template <typename T>
+    Report optimize(std::vector<T>& vertices, size_t stride, std::vector<unsigned int>& indices)
+    {
+        Report report;
+        report.inputVertices = static_cast<unsigned int>(vertices.size() / stride);
+        if (indices.empty())
+        {
+            indices.resize(report.inputVertices);
+            for (unsigned int i = 0; i < indices.size(); i++)
+                indices[i] = i;
+        }
+        report.triangles = static_cast<unsigned int>(indices.size() / 3);
+
+        std::vector<unsigned int> remap;
+        unsigned int vertexCount = generateRemap(reinterpret_cast<const unsigned char*>(vertices.data()), report.inputVertices, stride * sizeof(T), remap);
+        remapIndices(indices, remap);
+        remapVertices(vertices, stride, remap, vertexCount);
+        report.vertices = vertexCount;
+        report.before = analyzeVertexCache(indices, vertexCount);
+
+        std::vector<unsigned int> clusters;
+        optimizeVertexCache(indices, vertexCount, clusters);
+        optimizeOverdraw(indices, clusters, reinterpret_cast<const float*>(vertices.data()), stride * sizeof(T) / sizeof(float), vertexCount, 1.05f);
+
+        vertexCount = generateFetchRemap(indices, vertexCount, remap);
+        remapIndices(indices, remap);
+        remapVertices(vertices, stride, remap, vertexCount);
+        report.vertices = vertexCount;
+        report.after = analyzeVertexCache(indices, vertexCount);
+        return report;
+    }
+}
+
+#endif
@@ -0,0 +1,399 @@
+#ifndef MESH_SIMPLIFIER_H
+#define MESH_SIMPLIFIER_H
+
+#include <algorithm>
+#include <cmath>
+#include <unordered_map>
+#include <vector>
+
+#include "MeshOptimizer.h"
+
+// Levels of detail of an indexed mesh: simplified index sets over the same vertices (see AssimpMesh::selectLod)
+// Edges are collapsed onto one of their vertices (no new vertex), cheapest first by quadric error (Garland & Heckbert),
+// area-weighted planes of the triangles plus planes along the open borders.
+// A position shared by several vertices (UV seam or hard normal) only moves along the seam, all its vertices together;
+// the vertices on an open border only move along it; positions which are both, or shared by more than 2 vertices,
+// never move. A collapse which would flip a triangle is rejected.
+namespace MeshSimplifier
+{
+    struct Lod
+    {
+        unsigned int offset; // first index in the element buffer
+        unsigned int count;
+        float error;         // relative to the radius of the bounding sphere
+    };
+
+    struct Sphere
+    {
+        float center[3];
+        float radius;
+    };
+
+    // symmetric 4x4 matrix (upper triangle) & the weight of its planes
+    struct Quadric
+    {
+        double a[10];
+        double weight;
+    };
+
+    inline void addPlane(Quadric& q, double nx, double ny, double nz, double d, double weight)
+    {
+        double p[4] = { nx, ny, nz, d };
+        int k = 0;
+        for (int i = 0; i < 4; i++)
+            for (int j = i; j < 4; j++)
+                q.a[k++] += weight * p[i] * p[j];
+        q.weight += weight;
+    }
+
+    inline void addQuadric(Quadric& q, const Quadric& other)
+    {
+        for (int k = 0; k < 10; k++)
+            q.a[k] += other.a[k];
+        q.weight += other.weight;
+    }
+
+    // mean squared distance of p to the planes
+    inline double evaluate(const Quadric& q, const float* p)
+    {
+        double v[4] = { p[0], p[1], p[2], 1.0 };
+        double sum = 0.0;
+        int k = 0;
+        for (int i = 0; i < 4; i++)
+            for (int j = i; j < 4; j++)
+                sum += (i == j ? 1.0 : 2.0) * q.a[k++] * v[i] * v[j];
+        return q.weight > 0.0 ? std::max(sum, 0.0) / q.weight : 0.0;
+    }
+
+    inline void cross(const float* a, const float* b, const float* c, double* n)
+    {
+        double e1[3] = { b[0] - a[0], b[1] - a[1], b[2] - a[2] };
+        double e2[3] = { c[0] - a[0], c[1] - a[1], c[2] - a[2] };
+        n[0] = e1[1] * e2[2] - e1[2] * e2[1];
+        n[1] = e1[2] * e2[0] - e1[0] * e2[2];
+        n[2] = e1[0] * e2[1] - e1[1] * e2[0];
+    }
+
+    inline Sphere computeBoundingSphere(const float* positions, size_t stride, unsigned int vertexCount)
+    {
+        Sphere sphere = { { 0.0f, 0.0f, 0.0f }, 0.0f };
+        if (vertexCount == 0)
+            return sphere;
+        float minimum[3] = { positions[0], positions[1], positions[2] }, maximum[3] = { positions[0], positions[1], positions[2] };
+        for (unsigned int v = 0; v < vertexCount; v++)
+        {
+            for (int k = 0; k < 3; k++)
+            {
+                minimum[k] = std::min(minimum[k], positions[v * stride + k]);
+                maximum[k] = std::max(maximum[k], positions[v * stride + k]);
+            }
+        }
+        for (int k = 0; k < 3; k++)
+            sphere.center[k] = (minimum[k] + maximum[k]) * 0.5f;
+        for (unsigned int v = 0; v < vertexCount; v++)
+        {
+            const float* p = positions + v * stride;
+            float dx = p[0] - sphere.center[0], dy = p[1] - sphere.center[1], dz = p[2] - sphere.center[2];
+            sphere.radius = std::max(sphere.radius, std::sqrt(dx * dx + dy * dy + dz * dz));
+        }
+        return sphere;
+    }
+
+    // the vertices of a position which are used by the triangles
+    struct Topology
+    {
+        enum Kind { MANIFOLD, BORDER, SEAM, LOCKED };
+
+        std::vector<unsigned int> siblingOffsets;
+        std::vector<unsigned int> siblings;
+        std::vector<unsigned char> kinds;
+        std::unordered_map<unsigned long long, unsigned int> edges; // position edge -> triangles (1: open border)
+
+        static unsigned long long getKey(unsigned int a, unsigned int b)
+        {
+            return a < b ? (static_cast<unsigned long long>(a) << 32) | b : (static_cast<unsigned long long>(b) << 32) | a;
+        }
+
+        Topology(const std::vector<unsigned int>& indices, const std::vector<unsigned int>& positionIDs, unsigned int positionCount)
+            : siblingOffsets(positionCount + 1, 0), kinds(positionCount, MANIFOLD)
+        {
+            std::vector<bool> used(positionIDs.size(), false);
+            for (unsigned int i = 0; i < indices.size(); i++)
+            {
+                if (!used[indices[i]])
+                    siblingOffsets[positionIDs[indices[i]] + 1]++;
+                used[indices[i]] = true;
+            }
+            for (unsigned int p = 0; p < positionCount; p++)
+                siblingOffsets[p + 1] += siblingOffsets[p];
+            siblings.resize(siblingOffsets[positionCount]);
+            std::vector<unsigned int> filled(siblingOffsets.begin(), siblingOffsets.end() - 1);
+            for (unsigned int v = 0; v < used.size(); v++)
+            {
+                if (used[v])
+                    siblings[filled[positionIDs[v]]++] = v;
+            }
+
+            for (unsigned int t = 0; t < indices.size(); t += 3)
+            {
+                for (unsigned int c = 0; c < 3; c++)
+                    edges[getKey(positionIDs[indices[t + c]], positionIDs[indices[t + (c + 1) % 3]])]++;
+            }
+            std::vector<bool> border(positionCount, false);
+            for (std::unordered_map<unsigned long long, unsigned int>::const_iterator it = edges.begin(); it != edges.end(); ++it)
+            {
+                if (it->second == 1)
+                {
+                    border[it->first >> 32] = true;
+                    border[it->first & 0xFFFFFFFFu] = true;
+                }
+            }
+            for (unsigned int p = 0; p < positionCount; p++)
+            {
+                unsigned int count = siblingOffsets[p + 1] - siblingOffsets[p];
+                if (count == 1)
+                    kinds[p] = border[p] ? BORDER : MANIFOLD;
+                else
+                    kinds[p] = count == 2 && !border[p] ? SEAM : LOCKED;
+            }
+        }
+
+        bool isBorderEdge(unsigned int a, unsigned int b) const
+        {
+            std::unordered_map<unsigned long long, unsigned int>::const_iterator it = edges.find(getKey(a, b));
+            return it != edges.end() && it->second == 1;
+        }
+    };
+
+    // the index set of at most targetIndexCount indices (if possible within maxError, a distance)
+    // error gets the largest error of the collapses
+    inline std::vector<unsigned int> simplify(const float* positions, size_t stride, unsigned int vertexCount,
+        const std::vector<unsigned int>& indices, size_t targetIndexCount, float maxError, float& error)
+    {
+        error = 0.0f;
+        std::vector<float> packed(vertexCount * 3);
+        for (unsigned int v = 0; v < vertexCount; v++)
+            std::copy(positions + v * stride, positions + v * stride + 3, packed.begin() + v * 3);
+        std::vector<unsigned int> positionIDs;
+        unsigned int positionCount = MeshOptimizer::generateRemap(reinterpret_cast<const unsigned char*>(packed.data()), vertexCount, 3 * sizeof(float), positionIDs);
+        std::vector<unsigned int> representatives(positionCount);
+        for (unsigned int v = vertexCount; v-- > 0;)
+            representatives[positionIDs[v]] = v;
+        auto getPosition = [&](unsigned int p) { return &packed[representatives[p] * 3]; };
+
+        // planes of the triangles, and of the open borders (perpendicular to their triangle)
+        std::vector<Quadric> quadrics(positionCount);
+        for (unsigned int p = 0; p < positionCount; p++)
+        {
+            std::fill(quadrics[p].a, quadrics[p].a + 10, 0.0);
+            quadrics[p].weight = 0.0;
+        }
+        Topology initial(indices, positionIDs, positionCount);
+        for (unsigned int t = 0; t < indices.size(); t += 3)
+        {
+            unsigned int p[3] = { positionIDs[indices[t]], positionIDs[indices[t + 1]], positionIDs[indices[t + 2]] };
+            double n[3];
+            cross(getPosition(p[0]), getPosition(p[1]), getPosition(p[2]), n);
+            double area = std::sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+            if (area <= 0.0)
+                continue;
+            for (int k = 0; k < 3; k++)
+                n[k] /= area;
+            const float* a = getPosition(p[0]);
+            double d = -(n[0] * a[0] + n[1] * a[1] + n[2] * a[2]);
+            for (int c = 0; c < 3; c++)
+                addPlane(quadrics[p[c]], n[0], n[1], n[2], d, area);
+
+            for (int c = 0; c < 3; c++)
+            {
+                unsigned int p0 = p[c], p1 = p[(c + 1) % 3];
+                if (!initial.isBorderEdge(p0, p1))
+                    continue;
+                const float* e0 = getPosition(p0);
+                const float* e1 = getPosition(p1);
+                double edge[3] = { e1[0] - e0[0], e1[1] - e0[1], e1[2] - e0[2] };
+                double bn[3] = { edge[1] * n[2] - edge[2] * n[1], edge[2] * n[0] - edge[0] * n[2], edge[0] * n[1] - edge[1] * n[0] };
+                double length = std::sqrt(bn[0] * bn[0] + bn[1] * bn[1] + bn[2] * bn[2]);
+                if (length <= 0.0)
+                    continue;
+                for (int k = 0; k < 3; k++)
+                    bn[k] /= length;
+                double bd = -(bn[0] * e0[0] + bn[1] * e0[1] + bn[2] * e0[2]);
+                addPlane(quadrics[p0], bn[0], bn[1], bn[2], bd, 10.0 * length);
+                addPlane(quadrics[p1], bn[0], bn[1], bn[2], bd, 10.0 * length);
+            }
+        }
+
+        struct Collapse
+        {
+            unsigned int from;
+            unsigned int to;
+            float error;
+        };
+
+        std::vector<unsigned int> current(indices);
+        std::vector<unsigned int> remap(vertexCount);
+        while (current.size() > targetIndexCount)
+        {
+            Topology topology(current, positionIDs, positionCount);
+            MeshOptimizer::Adjacency adjacency(current, vertexCount);
+
+            std::vector<Collapse> collapses;
+            for (unsigned int t = 0; t < current.size(); t += 3)
+            {
+                for (unsigned int c = 0; c < 6; c++)
+                {
+                    unsigned int from = positionIDs[current[t + c % 3]], to = positionIDs[current[t + (c + 1 + c / 3) % 3]];
+                    unsigned char kind = topology.kinds[from];
+                    if (from == to || kind == Topology::LOCKED)
+                        continue;
+                    if (kind == Topology::BORDER && (topology.kinds[to] != Topology::BORDER || !topology.isBorderEdge(from, to)))
+                        continue;
+                    Quadric q = quadrics[from];
+                    addQuadric(q, quadrics[to]);
+                    Collapse collapse = { from, to, static_cast<float>(std::sqrt(evaluate(q, getPosition(to)))) };
+                    collapses.push_back(collapse);
+                }
+            }
+            std::sort(collapses.begin(), collapses.end(), [](const Collapse& a, const Collapse& b) { return a.error < b.error; });
+
+            for (unsigned int v = 0; v < vertexCount; v++)
+                remap[v] = v;
+            std::vector<bool> touched(positionCount, false);
+            size_t toRemove = (current.size() - targetIndexCount) / 3, removed = 0;
+            unsigned int applied = 0;
+            // only the cheapest ones in a pass (each edge is there 4 times): the next pass sees the updated quadrics
+            float passError = collapses.empty() ? 0.0f : collapses[collapses.size() / 8].error;
+            for (unsigned int i = 0; i < collapses.size() && removed < toRemove; i++)
+            {
+                const Collapse& collapse = collapses[i];
+                if (collapse.error > maxError || (collapse.error > passError && applied > 0))
+                    break;
+                if (touched[collapse.from] || touched[collapse.to])
+                    continue;
+
+                // every vertex of the position moves to the vertex of the target on its side of the seam
+                std::vector<std::pair<unsigned int, unsigned int>> moves;
+                bool valid = true;
+                size_t collapsed = 0;
+                for (unsigned int s = topology.siblingOffsets[collapse.from]; s < topology.siblingOffsets[collapse.from + 1] && valid; s++)
+                {
+                    unsigned int vertex = topology.siblings[s], target = ~0u;
+                    for (unsigned int a = 0; a < adjacency.counts[vertex] && valid; a++)
+                    {
+                        unsigned int t = adjacency.triangles[adjacency.offsets[vertex] + a] * 3;
+                        bool degenerate = false;
+                        for (unsigned int c = 0; c < 3; c++)
+                        {
+                            unsigned int other = current[t + c];
+                            if (positionIDs[other] != collapse.to)
+                                continue;
+                            degenerate = true;
+                            valid = target == ~0u || target == other;
+                            target = other;
+                        }
+                        if (degenerate)
+                        {
+                            collapsed++;
+                            continue;
+                        }
+                        // the triangle keeps its orientation
+                        const float* p[3];
+                        const float* moved[3];
+                        for (unsigned int c = 0; c < 3; c++)
+                        {
+                            p[c] = getPosition(positionIDs[current[t + c]]);
+                            moved[c] = current[t + c] == vertex ? getPosition(collapse.to) : p[c];
+                        }
+                        double before[3], after[3];
+                        cross(p[0], p[1], p[2], before);
+                        cross(moved[0], moved[1], moved[2], after);
+                        valid = before[0] * after[0] + before[1] * after[1] + before[2] * after[2] > 0.0;
+                    }
+                    valid = valid && target != ~0u;
+                    moves.push_back(std::make_pair(vertex, target));
+                }
+                if (!valid)
+                    continue;
+
+                for (unsigned int m = 0; m < moves.size(); m++)
+                {
+                    remap[moves[m].first] = moves[m].second;
+                    unsigned int vertex = moves[m].first;
+                    for (unsigned int a = 0; a < adjacency.counts[vertex]; a++)
+                    {
+                        unsigned int t = adjacency.triangles[adjacency.offsets[vertex] + a] * 3;
+                        for (unsigned int c = 0; c < 3; c++)
+                            touched[positionIDs[current[t + c]]] = true;
+                    }
+                }
+                addQuadric(quadrics[collapse.to], quadrics[collapse.from]);
+                error = std::max(error, collapse.error);
+                removed += collapsed / std::max<size_t>(moves.size(), 1) * moves.size() / 2 + (moves.size() == 1 ? collapsed % 2 : 0);
+                applied++;
+            }
+            if (applied == 0)
+                break;
+
+            std::vector<unsigned int> next;
+            next.reserve(current.size());
+            for (unsigned int t = 0; t < current.size(); t += 3)
+            {
+                unsigned int a = remap[current[t]], b = remap[current[t + 1]], c = remap[current[t + 2]];
+                if (a == b || b == c || a == c)
+                    continue;
+                next.push_back(a);
+                next.push_back(b);
+                next.push_back(c);
+            }
+            current.swap(next);
+        }
+        return current;
+    }
+
+    // LOD 0 (the input) and up to 3 levels with 1/2, 1/4 & 1/8 of its triangles, each one simplified from the previous
+    // one; a level which doesn't remove at least 10% of the triangles ends the chain
+    // allIndices: every level after the other (vertex cache order), lods: their place in it
+    inline void buildLods(const float* positions, size_t stride, unsigned int vertexCount, const std::vector<unsigned int>& indices,
+        std::vector<unsigned int>& allIndices, std::vector<Lod>& lods, Sphere& sphere)
+    {
+        sphere = computeBoundingSphere(positions, stride, vertexCount);
+        allIndices = indices;
+        lods.clear();
+        Lod full = { 0, static_cast<unsigned int>(indices.size()), 0.0f };
+        lods.push_back(full);
+
+        const float maxError = 0.1f; // of the radius
+        std::vector<unsigned int> level(indices);
+        float levelError = 0.0f;
+        for (unsigned int l = 1; l <= 3 && sphere.radius > 0.0f; l++)
+        {
+            size_t target = (indices.size() / 3 >> l) * 3;
+            float error = 0.0f;
+            std::vector<unsigned int> simplified = simplify(positions, stride, vertexCount, level, target, maxError * sphere.radius, error);
+            if (simplified.empty() || simplified.size() > level.size() * 9 / 10)
+                break;
+            std::vector<unsigned int> clusters;
+            MeshOptimizer::optimizeVertexCache(simplified, vertexCount, clusters);
+            levelError = std::max(levelError, error / sphere.radius);
+            Lod lod = { static_cast<unsigned int>(allIndices.size()), static_cast<unsigned int>(simplified.size()), levelError };
+            lods.push_back(lod);
+            allIndices.insert(allIndices.end(), simplified.begin(), simplified.end());
+            level.swap(simplified);
+        }
+    }
+
+    // the level for a bounding sphere of radiusPixels on screen: the coarsest one whose error stays below pixelError
+    // it only changes once the size leaves the band around the switch point (no popping back & forth)
+    inline unsigned int selectLod(const std::vector<Lod>& lods, unsigned int current, float radiusPixels, float pixelError, float hysteresis)
+    {
+        current = std::min(current, static_cast<unsigned int>(lods.size()) - 1);
+        while (current > 0 && lods[current].error * radiusPixels > pixelError * (1.0f + hysteresis))
+            current--;
+        while (current + 1 < lods.size() && lods[current + 1].error * radiusPixels < pixelError * (1.0f - hysteresis))
+            current++;
+        return current;
+    }
+}
+
+#endif
@@ -0,0 +1,163 @@
+#ifndef MESHLETS_H
+#define MESHLETS_H
+
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+// Clusters of the full level of detail of a mesh, culled on the CPU every frame (see AssimpMesh::cullMeshlets)
+// A meshlet is a run of consecutive triangles of the optimized index buffer (at most MAX_VERTICES different vertices
+// and MAX_TRIANGLES triangles): the order of the vertex cache optimization is kept, and the visible meshlets are
+// drawn as ranges of the same element buffer (glMultiDrawElements, neighbours merged into one range).
+// A meshlet is culled when its bounding sphere is outside the frustum, or when its normal cone faces away from the
+// camera (every triangle is back-facing).
+namespace Meshlets
+{
+    const unsigned int MAX_VERTICES = 64;
+    const unsigned int MAX_TRIANGLES = 124;
+    const unsigned int MIN_TRIANGLES = 1024; // smaller meshes are drawn whole
+
+    struct Meshlet
+    {
+        unsigned int firstIndex;
+        unsigned int indexCount;
+        float center[3];
+        float radius;
+        float coneAxis[3];
+        float coneCutoff; // sin of the cone angle (1: never back-facing)
+    };
+
+    struct Stats
+    {
+        unsigned long long triangles;
+        unsigned long long culledTriangles;
+        unsigned int frames;
+    };
+
+    inline void computeBounds(const float* positions, size_t stride, const unsigned int* indices, unsigned int indexCount, Meshlet& meshlet)
+    {
+        float minimum[3] = { 1e30f, 1e30f, 1e30f }, maximum[3] = { -1e30f, -1e30f, -1e30f };
+        for (unsigned int i = 0; i < indexCount; i++)
+        {
+            const float* p = positions + indices[i] * stride;
+            for (int k = 0; k < 3; k++)
+            {
+                minimum[k] = std::min(minimum[k], p[k]);
+                maximum[k] = std::max(maximum[k], p[k]);
+            }
+        }
+        for (int k = 0; k < 3; k++)
+            meshlet.center[k] = (minimum[k] + maximum[k]) * 0.5f;
+        meshlet.radius = 0.0f;
+        for (unsigned int i = 0; i < indexCount; i++)
+        {
+            const float* p = positions + indices[i] * stride;
+            float dx = p[0] - meshlet.center[0], dy = p[1] - meshlet.center[1], dz = p[2] - meshlet.center[2];
+            meshlet.radius = std::max(meshlet.radius, std::sqrt(dx * dx + dy * dy + dz * dz));
+        }
+
+        // the cone around the mean normal which contains every triangle normal
+        std::vector<glm::vec3> normals;
+        glm::vec3 axis(0.0f);
+        for (unsigned int t = 0; t < indexCount; t += 3)
+        {
+            const float* a = positions + indices[t] * stride;
+            const float* b = positions + indices[t + 1] * stride;
+            const float* c = positions + indices[t + 2] * stride;
+            glm::vec3 normal = glm::cross(glm::vec3(b[0] - a[0], b[1] - a[1], b[2] - a[2]), glm::vec3(c[0] - a[0], c[1] - a[1], c[2] - a[2]));
+            float length = glm::length(normal);
+            if (length <= 0.0f)
+                continue;
+            normals.push_back(normal / length);
+            axis += normal / length;
+        }
+        float axisLength = glm::length(axis);
+        float minDot = 1.0f;
+        if (axisLength > 0.0f)
+        {
+            axis /= axisLength;
+            for (unsigned int n = 0; n < normals.size(); n++)
+                minDot = std::min(minDot, glm::dot(axis, normals[n]));
+        }
+        else
+            minDot = -1.0f;
+        for (int k = 0; k < 3; k++)
+            meshlet.coneAxis[k] = axis[k];
+        meshlet.coneCutoff = minDot <= 0.0f ? 1.0f : std::sqrt(1.0f - minDot * minDot);
+    }
+
+    // the meshlets of indices[0, indexCount)
+    inline void build(const float* positions, size_t stride, unsigned int vertexCount, const unsigned int* indices, unsigned int indexCount, std::vector<Meshlet>& meshlets)
+    {
+        meshlets.clear();
+        std::vector<unsigned int> stamps(vertexCount, 0); // meshlet number + 1 of the vertices in the current one
+        Meshlet current = Meshlet();
+        unsigned int vertices = 0;
+        // the vertices of triangle t which aren't in the meshlet yet
+        auto countNew = [&](unsigned int t, unsigned int stamp) {
+            unsigned int a = indices[t], b = indices[t + 1], c = indices[t + 2];
+            return (stamps[a] != stamp ? 1u : 0u) + (stamps[b] != stamp && b != a ? 1u : 0u) + (stamps[c] != stamp && c != a && c != b ? 1u : 0u);
+        };
+        for (unsigned int t = 0; t < indexCount; t += 3)
+        {
+            unsigned int stamp = static_cast<unsigned int>(meshlets.size()) + 1;
+            unsigned int added = countNew(t, stamp);
+            if (vertices + added > MAX_VERTICES || current.indexCount / 3 + 1 > MAX_TRIANGLES)
+            {
+                computeBounds(positions, stride, indices + current.firstIndex, current.indexCount, current);
+                meshlets.push_back(current);
+                current.firstIndex = t;
+                current.indexCount = 0;
+                vertices = 0;
+                stamp++;
+                added = countNew(t, stamp);
+            }
+            for (unsigned int c = 0; c < 3; c++)
+                stamps[indices[t + c]] = stamp;
+            vertices += added;
+            current.indexCount += 3;
+        }
+        if (current.indexCount > 0)
+        {
+            computeBounds(positions, stride, indices + current.firstIndex, current.indexCount, current);
+            meshlets.push_back(current);
+        }
+    }
+
+    // planes (normalized, inside: dot >= 0) of the frustum of a clip transform
+    inline void extractPlanes(const glm::mat4& clip, glm::vec4 planes[6])
+    {
+        glm::mat4 rows = glm::transpose(clip);
+        planes[0] = rows[3] + rows[0];
+        planes[1] = rows[3] - rows[0];
+        planes[2] = rows[3] + rows[1];
+        planes[3] = rows[3] - rows[1];
+        planes[4] = rows[3] + rows[2];
+        planes[5] = rows[3] - rows[2];
+        for (int i = 0; i < 6; i++)
+            planes[i] /= glm::length(glm::vec3(planes[i]));
+    }
+
+    // planes & eye in the space of the meshlet
+    inline bool isVisible(const Meshlet& meshlet, const glm::vec4 planes[6], const glm::vec3& eye, bool backfaceCulling)
+    {
+        glm::vec3 center(meshlet.center[0], meshlet.center[1], meshlet.center[2]);
+        for (int i = 0; i < 6; i++)
+        {
+            if (glm::dot(glm::vec3(planes[i]), center) + planes[i].w < -meshlet.radius)
+                return false;
+        }
+        if (backfaceCulling)
+        {
+            glm::vec3 direction = center - eye;
+            glm::vec3 axis(meshlet.coneAxis[0], meshlet.coneAxis[1], meshlet.coneAxis[2]);
+            if (glm::dot(direction, axis) >= meshlet.coneCutoff * glm::length(direction) + meshlet.radius)
+                return false;
+        }
+        return true;
+    }
+}
+
+#endif
@@ -0,0 +1,476 @@
+#ifndef MIP_GENERATOR_H
+#define MIP_GENERATOR_H
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define MIP_GENERATOR_AVX2 1
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define MIP_GENERATOR_SSE2 1
+#endif
+
+// CPU mip chains, shared by the texture loading (TextureCache, TextureStreamer) and the cooker
+// Every level is computed from the previous one, in linear float RGBA (1 pixel = 4 floats = 1 SSE register):
+//   sRGB:  color channels are decoded to linear light before filtering and encoded after it, so the mips
+//          don't get darker (alpha and non-color data such as normal maps are filtered as they are)
+//   box:   2x2 average
+//   Kaiser: separable 8-tap windowed sinc (sharper, less aliasing)
+//   alpha coverage: the alpha of each level is scaled so the same fraction of texels passes the alpha test
+//          as in level 0 (otherwise alpha tested foliage/fences thin out with distance)
+// The kernels use AVX2 (2 pixels per register) when compiled with /arch:AVX2 (-mavx2), SSE2 otherwise
+// (always there on x64), and plain C++ on other architectures.
+namespace MipGenerator
+{
+    enum Filter
+    {
+        FILTER_BOX,
+        FILTER_KAISER
+    };
+
+    struct Options
+    {
+        Filter filter;
+        bool srgb;
+        bool preserveAlphaCoverage;
+        float alphaCutoff;
+
+        Options() : filter(FILTER_KAISER), srgb(true), preserveAlphaCoverage(false), alphaCutoff(0.5f) {}
+    };
+
+    struct Level
+    {
+        int width;
+        int height;
+        size_t offset; // in the output
+        size_t size;
+    };
+
+    inline const char* getInstructionSet()
+    {
+#if defined(MIP_GENERATOR_AVX2)
+        return "AVX2";
+#elif defined(MIP_GENERATOR_SSE2)
+        return "SSE2";
+#else
+        return "scalar";
+#endif
+    }
+
+    // some alpha of the RGBA pixels isn't opaque
+    inline bool hasTranslucentAlpha(const unsigned char* pixels, int count)
+    {
+        for (int i = 0; i < count; i++)
+        {
+            if (pixels[static_cast<size_t>(i) * 4 + 3] != 255)
+                return true;
+        }
+        return false;
+    }
+
+    // color data is sRGB, except for normal maps (*_ddn, *_normal) and 1-2 channel images.
+    // With the pixels (count of them), the alpha coverage of the RGBA images which aren't opaque is preserved
+    inline Options getOptions(const std::string& path, int channels, const unsigned char* pixels = nullptr, int count = 0)
+    {
+        Options options;
+        std::string name = path.substr(path.find_last_of("/\\") + 1);
+        if (channels < 3 || name.find("_ddn") != std::string::npos || name.find("_normal") != std::string::npos)
+            options.srgb = false;
+        else if (channels == 4 && pixels != nullptr && hasTranslucentAlpha(pixels, count))
+            options.preserveAlphaCoverage = true;
+        return options;
+    }
+
+    // the tables are function statics built in a constructor: thread safe, the workers of the ThreadPool use them
+    inline const float* getSrgbToLinear()
+    {
+        static struct Table
+        {
+            float values[256];
+            Table()
+            {
+                for (int i = 0; i < 256; i++)
+                {
+                    float c = i / 255.0f;
+                    values[i] = c <= 0.04045f ? c / 12.92f : std::pow((c + 0.055f) / 1.055f, 2.4f);
+                }
+            }
+        } table;
+        return table.values;
+    }
+
+    // linear [0, 1] -> sRGB 8 bits, 4096 entries
+    inline const unsigned char* getLinearToSrgb()
+    {
+        static struct Table
+        {
+            unsigned char values[4096];
+            Table()
+            {
+                for (int i = 0; i < 4096; i++)
+                {
+                    float l = i / 4095.0f;
+                    float c = l <= 0.0031308f ? l * 12.92f : 1.055f * std::pow(l, 1.0f / 2.4f) - 0.055f;
+                    values[i] = static_cast<unsigned char>(std::min(std::max(c * 255.0f + 0.5f, 0.0f), 255.0f));
+                }
+            }
+        } table;
+        return table.values;
+    }
+
+    inline const float* getUnormToFloat()
+    {
+        static struct Table
+        {
+            float values[256];
+            Table()
+            {
+                for (int i = 0; i < 256; i++)
+                    values[i] = i / 255.0f;
+            }
+        } table;
+        return table.values;
+    }
+
+    inline void unpack(const unsigned char* pixels, int count, int channels, bool srgb, float* out)
+    {
+        const float* tables[4];
+        for (int c = 0; c < 4; c++)
+            tables[c] = (srgb && c < 3) ? getSrgbToLinear() : getUnormToFloat();
+        for (int i = 0; i < count; i++)
+        {
+            const unsigned char* p = pixels + static_cast<size_t>(i) * channels;
+            float* o = out + static_cast<size_t>(i) * 4;
+            o[0] = o[1] = o[2] = 0.0f;
+            o[3] = 1.0f;
+            for (int c = 0; c < channels; c++)
+                o[c] = tables[c][p[c]];
+        }
+    }
+
+    inline void pack(const float* image, int count, int channels, bool srgb, float alphaScale, unsigned char* out)
+    {
+        const unsigned char* toSrgb = getLinearToSrgb();
+        // the sRGB channels are quantized to the entries of the table, the others to 8 bits
+        float ranges[4], scales[4] = { 1.0f, 1.0f, 1.0f, alphaScale };
+        for (int c = 0; c < 4; c++)
+            ranges[c] = (srgb && c < 3) ? 4095.0f : 255.0f;
+#if defined(MIP_GENERATOR_AVX2) || defined(MIP_GENERATOR_SSE2)
+        const __m128 zero = _mm_setzero_ps(), one = _mm_set1_ps(1.0f), half = _mm_set1_ps(0.5f);
+        const __m128 range = _mm_loadu_ps(ranges), scale = _mm_loadu_ps(scales);
+#endif
+        for (int i = 0; i < count; i++)
+        {
+            const float* p = image + static_cast<size_t>(i) * 4;
+            unsigned char* o = out + static_cast<size_t>(i) * channels;
+            int q[4];
+#if defined(MIP_GENERATOR_AVX2) || defined(MIP_GENERATOR_SSE2)
+            __m128 v = _mm_min_ps(_mm_max_ps(_mm_mul_ps(_mm_loadu_ps(p), scale), zero), one);
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(q), _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(v, range), half)));
+#else
+            for (int c = 0; c < 4; c++)
+                q[c] = static_cast<int>(std::min(std::max(p[c] * scales[c], 0.0f), 1.0f) * ranges[c] + 0.5f);
+#endif
+            for (int c = 0; c < channels; c++)
+                o[c] = (srgb && c < 3) ? toSrgb[q[c]] : static_cast<unsigned char>(q[c]);
+        }
+    }
+
+    // 2x2 average (the last row / column is repeated for odd sizes)
+    inline void downsampleBox(const float* source, int width, int height, float* destination, int destinationWidth, int destinationHeight)
+    {
+        for (int y = 0; y < destinationHeight; y++)
+        {
+            const float* row0 = source + static_cast<size_t>(std::min(y * 2, height - 1)) * width * 4;
+            const float* row1 = source + static_cast<size_t>(std::min(y * 2 + 1, height - 1)) * width * 4;
+            float* out = destination + static_cast<size_t>(y) * destinationWidth * 4;
+            int x = 0;
+            // full 2x2 footprints only (x1 < width), the odd last column below
+            int pairs = std::min(destinationWidth, width / 2);
+#if defined(MIP_GENERATOR_AVX2)
+            const __m256 quarter = _mm256_set1_ps(0.25f);
+            for (; x + 1 < pairs; x += 2)
+            {
+                // 2 output pixels: 4 source pixels of each row
+                __m256 a = _mm256_add_ps(_mm256_loadu_ps(row0 + x * 8), _mm256_loadu_ps(row1 + x * 8));
+                __m256 b = _mm256_add_ps(_mm256_loadu_ps(row0 + x * 8 + 8), _mm256_loadu_ps(row1 + x * 8 + 8));
+                __m256 left = _mm256_permute2f128_ps(a, b, 0x20);
+                __m256 right = _mm256_permute2f128_ps(a, b, 0x31);
+                _mm256_storeu_ps(out + x * 4, _mm256_mul_ps(_mm256_add_ps(left, right), quarter));
+            }
+#endif
+#if defined(MIP_GENERATOR_AVX2) || defined(MIP_GENERATOR_SSE2)
+            const __m128 quarter4 = _mm_set1_ps(0.25f);
+            for (; x < pairs; x++)
+            {
+                __m128 sum = _mm_add_ps(_mm_add_ps(_mm_loadu_ps(row0 + x * 8), _mm_loadu_ps(row1 + x * 8)),
+                    _mm_add_ps(_mm_loadu_ps(row0 + x * 8 + 4), _mm_loadu_ps(row1 + x * 8 + 4)));
+                _mm_storeu_ps(out + x * 4, _mm_mul_ps(sum, quarter4));
+            }
+#endif
+            for (; x < destinationWidth; x++)
+            {
+                int x0 = std::min(x * 2, width - 1), x1 = std::min(x * 2 + 1, width - 1);
+                for (int c = 0; c < 4; c++)
+                    out[x * 4 + c] = 0.25f * ((row0[x0 * 4 + c] + row1[x0 * 4 + c]) + (row0[x1 * 4 + c] + row1[x1 * 4 + c]));
+            }
+        }
+    }
+
+    const int KAISER_TAPS = 8;
+
+    // weights of the source pixels 2x-3 ... 2x+4 for the output pixel x (its center is between 2x and 2x+1)
+    // modified Bessel function of the first kind, order 0
+    inline float besselI0(float x)
+    {
+        float sum = 1.0f, term = 1.0f;
+        for (int k = 1; k < 20; k++)
+        {
+            term *= (x / (2.0f * k)) * (x / (2.0f * k));
+            sum += term;
+        }
+        return sum;
+    }
+
+    inline const float* getKaiserWeights()
+    {
+        static struct Table
+        {
+            float values[KAISER_TAPS];
+            Table()
+            {
+                const float alpha = 4.0f;
+                const float pi = 3.14159265f;
+                float total = 0.0f;
+                for (int i = 0; i < KAISER_TAPS; i++)
+                {
+                    float t = (i - 3) - 0.5f; // distance to the center, in source pixels
+                    float x = t / 2.0f;       // in output pixels
+                    float sinc = std::fabs(x) < 1e-6f ? 1.0f : std::sin(pi * x) / (pi * x);
+                    float r = t / (KAISER_TAPS / 2.0f);
+                    values[i] = sinc * besselI0(alpha * std::sqrt(std::max(0.0f, 1.0f - r * r))) / besselI0(alpha);
+                    total += values[i];
+                }
+                for (int i = 0; i < KAISER_TAPS; i++)
+                    values[i] /= total;
+            }
+        } table;
+        return table.values;
+    }
+
+    // one output pixel from 8 pixels of a line (stride: floats between 2 consecutive pixels), clamped at the borders
+    inline void filterKaiser(const float* line, int length, int stride, int x, const float* weights, float* out)
+    {
+        int first = 2 * x - 3;
+        bool inside = first >= 0 && first + KAISER_TAPS <= length;
+#if defined(MIP_GENERATOR_AVX2) || defined(MIP_GENERATOR_SSE2)
+        __m128 sum = _mm_setzero_ps();
+        for (int i = 0; i < KAISER_TAPS; i++)
+        {
+            int s = inside ? first + i : std::min(std::max(first + i, 0), length - 1);
+            sum = _mm_add_ps(sum, _mm_mul_ps(_mm_set1_ps(weights[i]), _mm_loadu_ps(line + static_cast<size_t>(s) * stride)));
+        }
+        _mm_storeu_ps(out, sum);
+#else
+        out[0] = out[1] = out[2] = out[3] = 0.0f;
+        for (int i = 0; i < KAISER_TAPS; i++)
+        {
+            int s = inside ? first + i : std::min(std::max(first + i, 0), length - 1);
+            for (int c = 0; c < 4; c++)
+                out[c] += weights[i] * line[static_cast<size_t>(s) * stride + c];
+        }
+#endif
+    }
+
+    // separable: horizontal pass into temporary (destinationWidth x height), then vertical pass
+    inline void downsampleKaiser(const float* source, int width, int height, float* destination, int destinationWidth, int destinationHeight, std::vector<float>& temporary)
+    {
+        const float* weights = getKaiserWeights();
+        temporary.resize(static_cast<size_t>(destinationWidth) * height * 4);
+
+        // a dimension of 1 isn't filtered
+        for (int y = 0; y < height; y++)
+        {
+            const float* line = source + static_cast<size_t>(y) * width * 4;
+            float* out = &temporary[static_cast<size_t>(y) * destinationWidth * 4];
+            if (width == 1)
+            {
+                std::copy(line, line + 4, out);
+                continue;
+            }
+            int x = 0;
+#if defined(MIP_GENERATOR_AVX2)
+            // the first 2 pixels are clamped at the border
+            for (; x < 2 && x < destinationWidth; x++)
+                filterKaiser(line, width, 4, x, weights, out + x * 4);
+            // 2 output pixels per iteration, their source pixels are 2 pixels apart
+            for (; x + 1 < destinationWidth && 2 * (x + 1) + 5 <= width; x += 2)
+            {
+                __m256 sum = _mm256_setzero_ps();
+                const float* p = line + static_cast<size_t>(2 * x - 3) * 4;
+                for (int i = 0; i < KAISER_TAPS; i++)
+                {
+                    __m256 pixels = _mm256_insertf128_ps(_mm256_castps128_ps256(_mm_loadu_ps(p + i * 4)), _mm_loadu_ps(p + (i + 2) * 4), 1);
+                    sum = _mm256_add_ps(sum, _mm256_mul_ps(_mm256_set1_ps(weights[i]), pixels));
+                }
+                _mm256_storeu_ps(out + x * 4, sum);
+            }
+#endif
+            for (; x < destinationWidth; x++)
+                filterKaiser(line, width, 4, x, weights, out + x * 4);
+        }
+
+        for (int y = 0; y < destinationHeight; y++)
+        {
+            float* out = destination + static_cast<size_t>(y) * destinationWidth * 4;
+            if (height == 1)
+            {
+                std::copy(temporary.begin(), temporary.begin() + destinationWidth * 4, out);
+                continue;
+            }
+            int x = 0;
+#if defined(MIP_GENERATOR_AVX2)
+            int first = 2 * y - 3;
+            bool inside = first >= 0 && first + KAISER_TAPS <= height;
+            // the rows are contiguous: 2 pixels of the same row per register
+            for (; inside && x + 1 < destinationWidth; x += 2)
+            {
+                __m256 sum = _mm256_setzero_ps();
+                for (int i = 0; i < KAISER_TAPS; i++)
+                {
+                    const float* p = &temporary[(static_cast<size_t>(first + i) * destinationWidth + x) * 4];
+                    sum = _mm256_add_ps(sum, _mm256_mul_ps(_mm256_set1_ps(weights[i]), _mm256_loadu_ps(p)));
+                }
+                _mm256_storeu_ps(out + x * 4, sum);
+            }
+#endif
+            for (; x < destinationWidth; x++)
+                filterKaiser(&temporary[static_cast<size_t>(x) * 4], height, destinationWidth * 4, y, weights, out + x * 4);
+        }
+    }
+
+    // fraction of the texels whose alpha * scale passes the cutoff
+    inline float getAlphaCoverage(const float* image, int count, float cutoff, float scale)
+    {
+        int covered = 0;
+        for (int i = 0; i < count; i++)
+        {
+            if (image[i * 4 + 3] * scale >= cutoff)
+                covered++;
+        }
+        return count > 0 ? static_cast<float>(covered) / count : 0.0f;
+    }
+
+    // the alpha scale giving this coverage (binary search)
+    inline float findAlphaScale(const float* image, int count, float cutoff, float coverage)
+    {
+        float low = 0.0f, high = 4.0f;
+        for (int i = 0; i < 12; i++)
+        {
+            float middle = 0.5f * (low + high);
+            if (getAlphaCoverage(image, count, cutoff, middle) < coverage)
+                low = middle;
+            else
+                high = middle;
+        }
+        return high;
+    }
+
+    // every level of the image (level 0 included, with the same number of channels) one after the other in output
+    inline std::vector<Level> generate(const unsigned char* pixels, int width, int height, int channels, const Options& options, std::vector<unsigned char>& output)
+    {
+        std::vector<Level> levels;
+        std::vector<float> current(static_cast<size_t>(width) * height * 4), next, temporary;
+        unpack(pixels, width * height, channels, options.srgb, current.data());
+
+        bool coverage = options.preserveAlphaCoverage && channels == 4;
+        float targetCoverage = coverage ? getAlphaCoverage(current.data(), width * height, options.alphaCutoff, 1.0f) : 0.0f;
+
+        size_t total = 0;
+        for (int w = width, h = height; ; w = std::max(w / 2, 1), h = std::max(h / 2, 1))
+        {
+            Level level = { w, h, total, static_cast<size_t>(w) * h * channels };
+            levels.push_back(level);
+            total += level.size;
+            if (w == 1 && h == 1)
+                break;
+        }
+        output.resize(total);
+        std::copy(pixels, pixels + levels[0].size, output.begin());
+
+        for (unsigned int l = 1; l < levels.size(); l++)
+        {
+            int sourceWidth = levels[l - 1].width, sourceHeight = levels[l - 1].height;
+            int w = levels[l].width, h = levels[l].height;
+            next.resize(static_cast<size_t>(w) * h * 4);
+            if (options.filter == FILTER_KAISER)
+                downsampleKaiser(current.data(), sourceWidth, sourceHeight, next.data(), w, h, temporary);
+            else
+                downsampleBox(current.data(), sourceWidth, sourceHeight, next.data(), w, h);
+            // keep filtering the unscaled alpha, the scale is only for the stored level
+            float alphaScale = coverage ? findAlphaScale(next.data(), w * h, options.alphaCutoff, targetCoverage) : 1.0f;
+            pack(next.data(), w * h, channels, options.srgb, alphaScale, &output[levels[l].offset]);
+            current.swap(next);
+        }
+        return levels;
+    }
+
+    // only the next level (half the size) of an image, in output
+    inline void downsample(const unsigned char* pixels, int width, int height, int channels, const Options& options, std::vector<unsigned char>& output, int& outputWidth, int& outputHeight)
+    {
+        outputWidth = std::max(width / 2, 1);
+        outputHeight = std::max(height / 2, 1);
+        std::vector<float> source(static_cast<size_t>(width) * height * 4), destination(static_cast<size_t>(outputWidth) * outputHeight * 4), temporary;
+        unpack(pixels, width * height, channels, options.srgb, source.data());
+        if (options.filter == FILTER_KAISER)
+            downsampleKaiser(source.data(), width, height, destination.data(), outputWidth, outputHeight, temporary);
+        else
+            downsampleBox(source.data(), width, height, destination.data(), outputWidth, outputHeight);
+        output.resize(static_cast<size_t>(outputWidth) * outputHeight * channels);
+        pack(destination.data(), outputWidth * outputHeight, channels, options.srgb, 1.0f, output.data());
+    }
+
+    // megapixels of source per second (level 0 of every chain), for each filter & color space, and with the
+    // alpha coverage preserved
+    inline void runBenchmark(int size, int iterations)
+    {
+        std::vector<unsigned char> image(static_cast<size_t>(size) * size * 4);
+        unsigned int seed = 12345;
+        for (size_t i = 0; i < image.size(); i++)
+        {
+            seed = seed * 1664525u + 1013904223u;
+            image[i] = static_cast<unsigned char>(seed >> 24);
+        }
+
+        std::cout << "Mip generation benchmark: " << size << "x" << size << " RGBA, " << iterations << " iterations, " << getInstructionSet() << std::endl;
+        const char* filterNames[] = { "box", "kaiser" };
+        std::vector<unsigned char> output;
+        for (int filter = 0; filter < 2; filter++)
+        {
+            for (int srgb = 0; srgb < 3; srgb++)
+            {
+                // 2: sRGB & alpha coverage
+                Options options;
+                options.filter = static_cast<Filter>(filter);
+                options.srgb = srgb != 0;
+                options.preserveAlphaCoverage = srgb == 2;
+                generate(image.data(), size, size, 4, options, output); // warm up (tables, allocations)
+                std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+                for (int i = 0; i < iterations; i++)
+                    generate(image.data(), size, size, 4, options, output);
+                double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+                double megapixels = static_cast<double>(size) * size * iterations / 1e6;
+                std::cout << "  " << filterNames[filter] << (srgb == 2 ? " srgb+coverage" : srgb ? " srgb         " : " linear       ") << ": " << megapixels / seconds << " MP/s ("
+                    << seconds * 1000.0 / iterations << " ms per chain)" << std::endl;
+            }
+        }
+    }
+}
+
+#endif
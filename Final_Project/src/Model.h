@@ -21,32 +21,54 @@
 
 #include "AssimpMesh.h"
 #include "shader.h"
+#include "CpuProfiler.h"
+#include "TextureCache.h"
+#include "MaterialArrays.h"
+#include "TextureAtlas.h"
+#include "MeshOptimizer.h"
+#include "MeshSimplifier.h"
+#include "Meshlets.h"
+#include "SceneGraph.h"
 
 #include <string>
 #include <fstream>
 #include <sstream>
+#include <iomanip>
 #include <iostream>
 #include <map>
 #include <vector>
 using namespace std;
 
-unsigned int TextureFromFile(const char* path, const string& directory, bool gamma = false);
-
 class Model
 {
 public:
     // model data 
-    vector<Texture> textures_loaded;	// stores all the textures loaded so far, optimization to make sure textures aren't loaded more than once.
     vector<AssimpMesh>    meshes;
     string directory;
     bool gammaCorrection;
+    int lodBias;       // added to the level of detail of every mesh (coarser when > 0)
+    int shadowLodBias; // same for the shadow cubemap, which hides most of the simplification
+    // node 0 places the whole model, the nodes of the file are below it (each mesh has the world matrix of its node)
+    SceneGraph sceneGraph;
 
     // constructor, expects a filepath to a 3D model.
-    Model(string const& path, bool gamma = false) : gammaCorrection(gamma)
+    Model(string const& path, bool gamma = false) : gammaCorrection(gamma), lodBias(0), shadowLodBias(1), materialArraysFailed(false), meshletStats(), rotation(glm::mat4(1.0f)), selectedNode(0), selectedCenter(0.0f)
     {
+        sceneGraph.addNode(-1, getPlacement(), "model");
         loadModel(path);
     }
 
+    // every texture of the meshes holds a reference in the TextureCache
+    ~Model()
+    {
+        for (unsigned int i = 0; i < meshes.size(); i++)
+            for (unsigned int j = 0; j < meshes[i].textures.size(); j++)
+                TextureCache::instance().release(meshes[i].textures[j].id);
+    }
+
+    Model(const Model&) = delete;
+    Model& operator=(const Model&) = delete;
+
     // draws the model, and thus all its meshes
     void Draw(Shader& shader)
     {
@@ -54,10 +76,71 @@ public:
             meshes[i].Draw(shader);
     }
 
+    // the node rotated by the trackball: the one of a picked mesh, the whole model for -1
+    void select(int mesh)
+    {
+        selectedNode = mesh >= 0 && mesh < static_cast<int>(meshes.size()) ? meshes[mesh].node : 0;
+        selectedCenter = mesh >= 0 && mesh < static_cast<int>(meshes.size()) ? meshes[mesh].getCenter() : glm::vec3(0.0f);
+        std::cout << "Selected: " << (selectedNode > 0 ? sceneGraph.getName(selectedNode) : "model") << std::endl;
+    }
+
+    // rotates the selected node (the whole model around its origin, a node around the center of the picked mesh)
     void updateRotation(std::pair<glm::vec3, float> p)
+    {
+        if (selectedNode <= 0)
+        {
+            rotation = glm::rotate(glm::mat4(1.0f), p.second, p.first) * rotation;
+            sceneGraph.setLocal(0, getPlacement());
+            return;
+        }
+        // the axis is in world space
+        glm::vec3 axis = glm::mat3(glm::inverse(sceneGraph.getWorld(selectedNode))) * p.first;
+        if (p.second == 0.0f || glm::length(axis) <= 0.0f)
+            return;
+        glm::mat4 identity(1.0f);
+        glm::mat4 pivot = glm::translate(identity, selectedCenter) * glm::rotate(identity, p.second, glm::normalize(axis)) * glm::translate(identity, -selectedCenter);
+        sceneGraph.setLocal(selectedNode, sceneGraph.getLocal(selectedNode) * pivot);
+    }
+
+    // once per frame, before selectLods: the world matrices of the changed nodes & of their meshes.
+    // Returns the number of nodes recomputed
+    unsigned int updateTransforms()
+    {
+        unsigned int updated = sceneGraph.update();
+        if (updated == 0)
+            return 0;
+        for (unsigned int i = 0; i < meshes.size(); i++)
+        {
+            if (sceneGraph.isUpdated(meshes[i].node))
+                meshes[i].modelMatrix = sceneGraph.getWorld(meshes[i].node);
+        }
+        return updated;
+    }
+
+    // once per frame, before the passes (see AssimpMesh::selectLod)
+    void selectLods(const glm::vec3& viewPos, float viewScale, const glm::vec3& lightPos, float shadowScale)
+    {
+        for (unsigned int i = 0; i < meshes.size(); i++)
+            meshes[i].selectLod(viewPos, viewScale, lodBias, lightPos, shadowScale, shadowLodBias);
+    }
+
+    // once per frame, after selectLods (see AssimpMesh::cullMeshlets)
+    void cullMeshlets(const glm::mat4& viewProjection, const glm::vec3& viewPos, bool backfaceCulling)
     {
         for (unsigned int i = 0; i < meshes.size(); i++)
-            meshes[i].updateRotation(p);
+            meshes[i].cullMeshlets(viewProjection, viewPos, backfaceCulling, meshletStats);
+        meshletStats.frames++;
+    }
+
+    // the triangles of the meshlets culled since the start
+    void printMeshletStats()
+    {
+        if (meshletStats.triangles == 0)
+            return;
+        std::ostringstream line;
+        line << "Meshlet culling: " << std::fixed << std::setprecision(1) << 100.0 * meshletStats.culledTriangles / meshletStats.triangles
+            << "% of " << meshletStats.triangles / meshletStats.frames << " triangles per frame culled (" << meshletStats.frames << " frames)";
+        cout << line.str() << endl;
     }
 
     void draw_blinn_Phong(Shader& blinnPhongShader, const glm::vec3& lightPos, const glm::vec3& viewPos, const glm::mat4& view, const glm::mat4& projection)
@@ -66,7 +149,51 @@ public:
             meshes[i].draw_blinn_phong(blinnPhongShader, lightPos, viewPos, view, projection);
     }
 
-    void draw_point_shadow(Shader& pointShadowShader, Shader& singleColorShader, const glm::mat4& projection, const glm::mat4& view, const glm::vec3 viewPos, const glm::vec3 lightPos, myTexture2D& texture, unsigned int& depthCubeMap, unsigned int& sceneTexture, const float& invisible, const float& far_plane, const bool& stencil, const bool& drawShadow)
+    // pack the diffuse & specular textures into MaterialArrays once they're all loaded (the streamed ones arrive
+    // over several frames). true once the model is drawn with them: the shader needs the MATERIAL_ARRAYS variant
+    bool prepareMaterialArrays()
+    {
+        if (materialArrays.isBuilt() || materialArraysFailed)
+            return materialArrays.isBuilt();
+        for (unsigned int i = 0; i < meshes.size(); i++)
+        {
+            for (unsigned int j = 0; j < meshes[i].textures.size(); j++)
+            {
+                const TextureCache::Info* info = TextureCache::instance().getInfo(meshes[i].textures[j].id);
+                if (info != nullptr && !info->resident)
+                    return false;
+            }
+        }
+
+        for (unsigned int i = 0; i < meshes.size(); i++)
+            meshes[i].materialID = materialArrays.addMaterial(meshes[i].getTexture("texture_diffuse"), meshes[i].getTexture("texture_specular"));
+        if (!materialArrays.build())
+        {
+            std::cout << "Material arrays: the textures don't fit, they're bound for each mesh" << std::endl;
+            for (unsigned int i = 0; i < meshes.size(); i++)
+                meshes[i].materialID = -1;
+            materialArraysFailed = true;
+            return false;
+        }
+
+        // the arrays have their own copy (textures of the cache, under its budget), the meshes only keep the other
+        // textures (normal & height maps)
+        for (unsigned int i = 0; i < meshes.size(); i++)
+        {
+            vector<Texture> kept;
+            for (unsigned int j = 0; j < meshes[i].textures.size(); j++)
+            {
+                if (meshes[i].textures[j].type == "texture_diffuse" || meshes[i].textures[j].type == "texture_specular")
+                    TextureCache::instance().release(meshes[i].textures[j].id);
+                else
+                    kept.push_back(meshes[i].textures[j]);
+            }
+            meshes[i].textures = kept;
+        }
+        return true;
+    }
+
+    void draw_point_shadow(Shader& pointShadowShader, Shader& singleColorShader, const glm::mat4& projection, const glm::mat4& view, const glm::vec3 viewPos, const glm::vec3 lightPos, myTexture2D& texture, unsigned int& depthCubeMap, unsigned int& sceneTexture, const float& invisible, const float& far_plane, const bool& stencil)
     {
         if (stencil)
         {
@@ -75,9 +202,44 @@ public:
             glStencilMask(0xFF);
         }
 
+        if (materialArrays.isBuilt())
+        {
+            // one set of uniforms & bindings for the whole model, the meshes only set their model matrix & material
+            pointShadowShader.use();
+            pointShadowShader.setVec3("viewPos", viewPos);
+            pointShadowShader.setVec3("lightPos", lightPos);
+            pointShadowShader.setMat4("projection", projection);
+            pointShadowShader.setMat4("view", view);
+            pointShadowShader.setFloat("far_plane", far_plane);
+            pointShadowShader.setFloat("invisible", invisible);
+
+            glActiveTexture(GL_TEXTURE0);
+            texture.bind();
+            glActiveTexture(GL_TEXTURE1);
+            glBindTexture(GL_TEXTURE_CUBE_MAP, depthCubeMap);
+            glActiveTexture(GL_TEXTURE2);
+            glBindTexture(GL_TEXTURE_2D, sceneTexture);
+            materialArrays.bind(pointShadowShader);
+
+            for (unsigned int i = 0; i < meshes.size(); i++)
+            {
+                if (meshes[i].visible)
+                    meshes[i].draw_material(pointShadowShader);
+            }
+            return;
+        }
+
         for (unsigned int i = 0; i < meshes.size(); i++)
-            meshes[i].draw_point_shadow(pointShadowShader, singleColorShader, projection, view, viewPos, lightPos, texture, depthCubeMap, sceneTexture, invisible, far_plane, drawShadow);
+        {
+            if (meshes[i].visible)
+                meshes[i].draw_point_shadow(pointShadowShader, singleColorShader, projection, view, viewPos, lightPos, texture, depthCubeMap, sceneTexture, invisible, far_plane);
+        }
+    }
 
+    // render the frame around the model, using the stencil recorded by draw_point_shadow
+    // (separated from draw_point_shadow so that it can be measured as its own pass)
+    void draw_stencil_frame(Shader& singleColorShader, const glm::mat4& projection, const glm::mat4& view, const bool& stencil)
+    {
         if (stencil)
         {
             glStencilFunc(GL_NOTEQUAL, 1, 0xFF);
@@ -85,7 +247,10 @@ public:
             glDisable(GL_DEPTH_TEST);
 
             for (unsigned int i = 0; i < meshes.size(); i++)
-                meshes[i].draw_single_color(singleColorShader, projection, view);
+            {
+                if (meshes[i].visible)
+                    meshes[i].draw_single_color(singleColorShader, projection, view);
+            }
 
             glStencilMask(0xFF);
             glStencilFunc(GL_ALWAYS, 0, 0xFF);
@@ -96,16 +261,103 @@ public:
     void draw_only_model(Shader& shader)
     {
         for (unsigned int i = 0; i < meshes.size(); i++)
-            meshes[i].draw_only_model(shader);
+        {
+            if (meshes[i].shadowVisible)
+                meshes[i].draw_only_model(shader);
+        }
+    }
+
+    // vertex count & cache efficiency of every mesh of the file before and after the optimization (no OpenGL needed)
+    static bool printOptimizationReport(string const& path)
+    {
+        Assimp::Importer importer;
+        const aiScene* scene = importer.ReadFile(path, getImportFlags());
+        if (!scene || scene->mFlags & AI_SCENE_FLAGS_INCOMPLETE || !scene->mRootNode)
+        {
+            cout << "ERROR::ASSIMP:: " << path << ": " << importer.GetErrorString() << endl;
+            return false;
+        }
+        for (unsigned int i = 0; i < scene->mNumMeshes; i++)
+        {
+            vector<Vertex> vertices;
+            vector<unsigned int> indices;
+            readMesh(scene->mMeshes[i], vertices, indices);
+            MeshOptimizer::Report report = MeshOptimizer::optimize(vertices, 1, indices);
+            std::ostringstream line;
+            line << path << " [" << scene->mMeshes[i]->mName.C_Str() << "]: " << report.triangles << " triangles, "
+                << report.inputVertices << " -> " << report.vertices << " vertices, " << std::fixed << std::setprecision(3)
+                << "ACMR " << report.before.acmr << " -> " << report.after.acmr << ", ATVR " << report.before.atvr << " -> " << report.after.atvr;
+            cout << line.str() << endl;
+        }
+        return true;
     }
 
 private:
+    MaterialArrays materialArrays;
+    bool materialArraysFailed;
+    Meshlets::Stats meshletStats;
+    glm::mat4 rotation; // of the trackball
+    int selectedNode;
+    glm::vec3 selectedCenter; // object space
+
+    // local matrix of node 0
+    glm::mat4 getPlacement() const
+    {
+        return glm::translate(glm::mat4(1.0f), glm::vec3(0.0f, -1.3f, 0.0f)) * rotation;
+    }
+
+    static glm::mat4 toMat4(const aiMatrix4x4& m)
+    {
+        // ASSIMP matrices are row-major
+        return glm::transpose(glm::mat4(m.a1, m.a2, m.a3, m.a4, m.b1, m.b2, m.b3, m.b4, m.c1, m.c2, m.c3, m.c4, m.d1, m.d2, m.d3, m.d4));
+    }
+
+    // the texture types of the materials, and their sampler names
+    static const unsigned int NUM_TEXTURE_TYPES = 4;
+    static aiTextureType getTextureType(unsigned int i)
+    {
+        const aiTextureType types[NUM_TEXTURE_TYPES] = { aiTextureType_DIFFUSE, aiTextureType_SPECULAR, aiTextureType_HEIGHT, aiTextureType_AMBIENT };
+        return types[i];
+    }
+    static string getTextureTypeName(unsigned int i)
+    {
+        const char* names[NUM_TEXTURE_TYPES] = { "texture_diffuse", "texture_specular", "texture_normal", "texture_height" };
+        return names[i];
+    }
+
+    // a material packed into the atlases: its UVs are moved into its tile
+    struct AtlasTile
+    {
+        glm::vec2 offset;
+        glm::vec2 scale;
+    };
+    std::map<unsigned int, AtlasTile> atlasTiles; // material -> tile
+    vector<Texture> atlasTextures; // one per texture type, for the meshes of these materials
+
+    // the CPU work of a mesh, done for all of them in parallel before the GL phase
+    struct MeshData
+    {
+        vector<Vertex> vertices;
+        vector<unsigned int> indices; // every level of detail
+        vector<MeshSimplifier::Lod> lods;
+        MeshSimplifier::Sphere boundingSphere;
+        vector<Meshlets::Meshlet> meshlets;
+        MeshOptimizer::Report report;
+    };
+    vector<MeshData> meshData; // one per mesh of the scene
+
+    static unsigned int getImportFlags()
+    {
+        return aiProcess_Triangulate | aiProcess_GenSmoothNormals | aiProcess_FlipUVs | aiProcess_CalcTangentSpace;
+    }
+
     // loads a model with supported ASSIMP extensions from file and stores the resulting meshes in the meshes vector.
     void loadModel(string const& path)
     {
+        CPU_PROFILE_SCOPE("Model::loadModel");
         // read file via ASSIMP
         Assimp::Importer importer;
-        const aiScene* scene = importer.ReadFile(path, aiProcess_Triangulate | aiProcess_GenSmoothNormals | aiProcess_FlipUVs | aiProcess_CalcTangentSpace);
+        const aiScene* scene = importer.ReadFile(path, getImportFlags());
         // check for errors
         if (!scene || scene->mFlags & AI_SCENE_FLAGS_INCOMPLETE || !scene->mRootNode) // if is Not Zero
         {
@@ -115,40 +367,239 @@ private:
         // retrieve the directory path of the filepath
         directory = path.substr(0, path.find_last_of('/'));
 
-        // process ASSIMP's root node recursively
-        processNode(scene->mRootNode, scene);
+        // the small textures are packed into atlases first
+        buildAtlases(scene);
+
+        // CPU phase: optimize the meshes & build their levels of detail, decode every texture of the materials
+        // (in parallel, streamed textures are decoded by the streamer)
+        prepareMeshes(scene);
+        if (!TextureCache::instance().isStreaming())
+            prefetchTextures(scene);
+
+        // GL phase: process ASSIMP's root node recursively (the textures are only uploaded)
+        processNode(scene->mRootNode, scene, 0);
+
+        // the meshes have their own references
+        for (unsigned int i = 0; i < atlasTextures.size(); i++)
+            TextureCache::instance().release(atlasTextures[i].id);
+
+        // the optimization & the index buffers of all the meshes (per triangle)
+        unsigned int inputVertices = 0, vertices = 0, triangles = 0, shortMeshes = 0;
+        size_t indexBytes = 0;
+        for (unsigned int i = 0; i < meshes.size(); i++)
+        {
+            shortMeshes += meshes[i].indexType == GL_UNSIGNED_SHORT ? 1 : 0;
+            indexBytes += meshes[i].indexBytes;
+        }
+        float acmrBefore = 0.0f, acmrAfter = 0.0f;
+        unsigned int lodTriangles[4] = { 0, 0, 0, 0 }, meshlets = 0;
+        for (unsigned int i = 0; i < meshData.size(); i++)
+        {
+            meshlets += static_cast<unsigned int>(meshData[i].meshlets.size());
+            for (unsigned int l = 0; l < meshData[i].lods.size() && l < 4; l++)
+                lodTriangles[l] += meshData[i].lods[l].count / 3;
+            const MeshOptimizer::Report& report = meshData[i].report;
+            inputVertices += report.inputVertices;
+            vertices += report.vertices;
+            triangles += report.triangles;
+            acmrBefore += report.before.acmr * report.triangles;
+            acmrAfter += report.after.acmr * report.triangles;
+        }
+        if (triangles > 0)
+        {
+            std::ostringstream line;
+            line << "Mesh optimization: " << meshData.size() << " meshes, " << inputVertices << " -> " << vertices << " vertices, "
+                << std::fixed << std::setprecision(3) << "ACMR " << acmrBefore / triangles << " -> " << acmrAfter / triangles << ", indices: "
+                << shortMeshes << " 16-bit & " << meshes.size() - shortMeshes << " 32-bit meshes (" << indexBytes / 1024 << " KB)"
+                << ", LOD triangles: " << lodTriangles[0] << " / " << lodTriangles[1] << " / " << lodTriangles[2] << " / " << lodTriangles[3]
+                << ", " << meshlets << " meshlets";
+            cout << line.str() << endl;
+        }
+        meshData.clear();
+    }
+
+    void prepareMeshes(const aiScene* scene)
+    {
+        CPU_PROFILE_SCOPE("Model::prepareMeshes");
+        meshData.resize(scene->mNumMeshes);
+        ThreadPool::instance().parallelFor(scene->mNumMeshes, [&](unsigned int i) {
+            MeshData& data = meshData[i];
+            vector<unsigned int> indices;
+            readMesh(scene->mMeshes[i], data.vertices, indices);
+            data.report = MeshOptimizer::optimize(data.vertices, 1, indices);
+            const float* positions = data.vertices.empty() ? nullptr : &data.vertices[0].Position.x;
+            MeshSimplifier::buildLods(positions, sizeof(Vertex) / sizeof(float), static_cast<unsigned int>(data.vertices.size()),
+                indices, data.indices, data.lods, data.boundingSphere);
+            if (!data.lods.empty() && data.lods[0].count / 3 >= Meshlets::MIN_TRIANGLES)
+                Meshlets::build(positions, sizeof(Vertex) / sizeof(float), static_cast<unsigned int>(data.vertices.size()),
+                    &data.indices[data.lods[0].offset], data.lods[0].count, data.meshlets);
+        });
+    }
+
+    // the texture types used by processMesh (the ones of the atlases are already loaded)
+    void prefetchTextures(const aiScene* scene)
+    {
+        vector<string> files;
+        for (unsigned int i = 0; i < scene->mNumMaterials; i++)
+        {
+            if (atlasTiles.count(i) > 0)
+                continue;
+            for (unsigned int t = 0; t < NUM_TEXTURE_TYPES; t++)
+            {
+                for (unsigned int j = 0; j < scene->mMaterials[i]->GetTextureCount(getTextureType(t)); j++)
+                {
+                    aiString str;
+                    scene->mMaterials[i]->GetTexture(getTextureType(t), j, &str);
+                    files.push_back(this->directory + '/' + str.C_Str());
+                }
+            }
+        }
+        TextureCache::instance().prefetch(files, 0);
+    }
+
+    // the UVs of every mesh of the material stay in its tile (with a margin within the padding): no tiling
+    bool fitsInTile(const aiScene* scene, unsigned int material, int width, int height)
+    {
+        float marginU = static_cast<float>(TextureAtlas::PADDING) / width;
+        float marginV = static_cast<float>(TextureAtlas::PADDING) / height;
+        bool used = false;
+        for (unsigned int i = 0; i < scene->mNumMeshes; i++)
+        {
+            const aiMesh* mesh = scene->mMeshes[i];
+            if (mesh->mMaterialIndex != material || !mesh->mTextureCoords[0])
+                continue;
+            used = true;
+            for (unsigned int v = 0; v < mesh->mNumVertices; v++)
+            {
+                const aiVector3D& uv = mesh->mTextureCoords[0][v];
+                if (uv.x < -marginU || uv.x > 1.0f + marginU || uv.y < -marginV || uv.y > 1.0f + marginV)
+                    return false;
+            }
+        }
+        return used;
+    }
+
+    // materials with small textures (at most maxTileSize, the same size for all their types) and no tiling share
+    // one atlas per texture type: fewer texture switches, and their meshes could be merged into one draw
+    void buildAtlases(const aiScene* scene)
+    {
+        CPU_PROFILE_SCOPE("Model::buildAtlases");
+        const int maxTileSize = 1024;
+        GLint maxSize = 0;
+        glGetIntegerv(GL_MAX_TEXTURE_SIZE, &maxSize);
+        maxSize = std::min(maxSize, 8192);
+
+        vector<unsigned int> materials;
+        vector<string> files; // NUM_TEXTURE_TYPES per material ("" if it has none)
+        vector<TextureAtlas::Rect> tiles;
+        for (unsigned int m = 0; m < scene->mNumMaterials; m++)
+        {
+            vector<string> typeFiles(NUM_TEXTURE_TYPES);
+            int width = 0, height = 0;
+            bool fits = true;
+            for (unsigned int t = 0; t < NUM_TEXTURE_TYPES && fits; t++)
+            {
+                unsigned int count = scene->mMaterials[m]->GetTextureCount(getTextureType(t));
+                if (count == 0)
+                    continue;
+                aiString str;
+                scene->mMaterials[m]->GetTexture(getTextureType(t), 0, &str);
+                typeFiles[t] = this->directory + '/' + str.C_Str();
+                int fileWidth, fileHeight, fileChannels;
+                fits = count == 1 && stbi_info(typeFiles[t].c_str(), &fileWidth, &fileHeight, &fileChannels) &&
+                    (width == 0 || (fileWidth == width && fileHeight == height));
+                width = fileWidth;
+                height = fileHeight;
+            }
+            if (!fits || typeFiles[0].empty() || width > maxTileSize || height > maxTileSize || !fitsInTile(scene, m, width, height))
+                continue;
+            materials.push_back(m);
+            files.insert(files.end(), typeFiles.begin(), typeFiles.end());
+            tiles.push_back(TextureAtlas::makeTile(0, 0, width, height));
+        }
+        int width = 0, height = 0;
+        if (materials.size() < 2 || !TextureAtlas::pack(tiles, maxSize, width, height))
+            return;
+
+        // RGBA, decoded in parallel
+        vector<unsigned char*> images(files.size(), nullptr);
+        ThreadPool::instance().parallelFor(static_cast<unsigned int>(files.size()), [&](unsigned int i) {
+            int fileWidth, fileHeight, fileChannels;
+            stbi_set_flip_vertically_on_load_thread(false); // the global flag is left as it is
+            if (!files[i].empty())
+                images[i] = stbi_load(files[i].c_str(), &fileWidth, &fileHeight, &fileChannels, 4);
+        });
+
+        const char* suffixes[NUM_TEXTURE_TYPES] = { "diffuse", "specular", "normal", "height" };
+        for (unsigned int t = 0; t < NUM_TEXTURE_TYPES; t++)
+        {
+            vector<unsigned char> atlas;
+            for (unsigned int m = 0; m < materials.size(); m++)
+            {
+                if (images[m * NUM_TEXTURE_TYPES + t] == nullptr)
+                    continue;
+                atlas.resize(static_cast<size_t>(width) * height * 4);
+                TextureAtlas::blit(images[m * NUM_TEXTURE_TYPES + t], tiles[m], atlas.data(), width, height);
+            }
+            if (atlas.empty())
+                continue;
+
+            // box filter: the mip levels of a tile stay inside its padding (up to TextureAtlas::getMaxLevels())
+            string name = this->directory + "/atlas_" + suffixes[t];
+            MipGenerator::Options options = MipGenerator::getOptions(name, 4);
+            options.filter = MipGenerator::FILTER_BOX;
+            Texture texture;
+            texture.id = TextureCache::instance().acquireImage(name, atlas.data(), width, height, 4,
+                TextureDesc::texture2D(4, false, true, GL_CLAMP_TO_EDGE), options, TextureAtlas::getMaxLevels());
+            texture.type = getTextureTypeName(t);
+            texture.path = name;
+            atlasTextures.push_back(texture);
+        }
+        for (unsigned int i = 0; i < images.size(); i++)
+        {
+            if (images[i] != nullptr)
+                stbi_image_free(images[i]);
+        }
+
+        for (unsigned int m = 0; m < materials.size(); m++)
+        {
+            AtlasTile tile;
+            tile.offset = glm::vec2(static_cast<float>(tiles[m].x) / width, static_cast<float>(tiles[m].y) / height);
+            tile.scale = glm::vec2(static_cast<float>(tiles[m].width) / width, static_cast<float>(tiles[m].height) / height);
+            atlasTiles[materials[m]] = tile;
+        }
+        std::cout << "Texture atlas: " << materials.size() << " materials in " << width << "x" << height << " ("
+            << atlasTextures.size() << " texture types)" << std::endl;
     }
 
     // processes a node in a recursive fashion. Processes each individual mesh located at the node and repeats this process on its children nodes (if any).
-    void processNode(aiNode* node, const aiScene* scene)
+    // parent: the node of the scene graph above this one (the nodes are added depth first, parents first)
+    void processNode(aiNode* node, const aiScene* scene, int parent)
     {
+        int index = sceneGraph.addNode(parent, toMat4(node->mTransformation), node->mName.C_Str());
         // process each mesh located at the current node
         for (unsigned int i = 0; i < node->mNumMeshes; i++)
         {
             // the node object only contains indices to index the actual objects in the scene. 
             // the scene contains all the data, node is just to keep stuff organized (like relations between nodes).
-            aiMesh* mesh = scene->mMeshes[node->mMeshes[i]];
-            meshes.push_back(processMesh(mesh, scene));
+            meshes.push_back(processMesh(node->mMeshes[i], scene));
+            meshes.back().node = index;
         }
         // after we've processed all of the meshes (if any) we then recursively process each of the children nodes
         for (unsigned int i = 0; i < node->mNumChildren; i++)
         {
-            processNode(node->mChildren[i], scene);
+            processNode(node->mChildren[i], scene, index);
         }
 
     }
 
-    AssimpMesh processMesh(aiMesh* mesh, const aiScene* scene)
+    // the vertices & indices of the mesh as ASSIMP gives them (one vertex per face corner)
+    static void readMesh(const aiMesh* mesh, vector<Vertex>& vertices, vector<unsigned int>& indices)
     {
-        // data to fill
-        vector<Vertex> vertices;
-        vector<unsigned int> indices;
-        vector<Texture> textures;
-
         // walk through each of the mesh's vertices
         for (unsigned int i = 0; i < mesh->mNumVertices; i++)
         {
-            Vertex vertex;
+            Vertex vertex = Vertex(); // zeroed: the optimizer compares whole vertices
             glm::vec3 vector; // we declare a placeholder vector since assimp uses its own vector class that doesn't directly convert to glm's vec3 class so we transfer the data to this placeholder glm::vec3 first.
             // positions
             vector.x = mesh->mVertices[i].x;
@@ -192,10 +643,34 @@ private:
         for (unsigned int i = 0; i < mesh->mNumFaces; i++)
         {
             aiFace face = mesh->mFaces[i];
+            // points & lines left by aiProcess_Triangulate are skipped (drawn as triangles)
+            if (face.mNumIndices != 3)
+                continue;
             // retrieve all indices of the face and store them in the indices vector
             for (unsigned int j = 0; j < face.mNumIndices; j++)
                 indices.push_back(face.mIndices[j]);
         }
+    }
+
+    AssimpMesh processMesh(unsigned int index, const aiScene* scene)
+    {
+        // data to fill
+        aiMesh* mesh = scene->mMeshes[index];
+        const MeshData& data = meshData[index];
+        vector<Vertex> vertices(data.vertices);
+        vector<Texture> textures;
+
+        // a material of the atlases: its textures are shared, the UVs move into its tile
+        std::map<unsigned int, AtlasTile>::const_iterator tile = atlasTiles.find(mesh->mMaterialIndex);
+        if (tile != atlasTiles.end())
+        {
+            for (unsigned int i = 0; i < vertices.size(); i++)
+                vertices[i].TexCoords = tile->second.offset + vertices[i].TexCoords * tile->second.scale;
+            for (unsigned int i = 0; i < atlasTextures.size(); i++)
+                TextureCache::instance().addReference(atlasTextures[i].id);
+            return AssimpMesh(vertices, data.indices, atlasTextures, data.lods, data.boundingSphere, data.meshlets);
+        }
+
         // process materials
         aiMaterial* material = scene->mMaterials[mesh->mMaterialIndex];
         // we assume a convention for sampler names in the shaders. Each diffuse texture should be named
@@ -225,10 +700,11 @@ private:
         std::cout << std::endl;
 
         // return a mesh object created from the extracted mesh data
-        return AssimpMesh(vertices, indices, textures);
+        return AssimpMesh(vertices, data.indices, textures, data.lods, data.boundingSphere, data.meshlets);
     }
 
-    // checks all material textures of a given type and loads the textures if they're not loaded yet.
+    // gets all material textures of a given type from the TextureCache (shared with the other models,
+    // a texture is only loaded the first time its file is used, streamed when streaming is on)
     // the required info is returned as a Texture struct.
     vector<Texture> loadMaterialTextures(aiMaterial* mat, aiTextureType type, string typeName)
     {
@@ -237,69 +713,14 @@ private:
         {
             aiString str;
             mat->GetTexture(type, i, &str);
-            // check if texture was loaded before and if so, continue to next iteration: skip loading a new texture
-            bool skip = false;
-            for (unsigned int j = 0; j < textures_loaded.size(); j++)
-            {
-                if (std::strcmp(textures_loaded[j].path.data(), str.C_Str()) == 0)
-                {
-                    textures.push_back(textures_loaded[j]);
-                    skip = true; // a texture with the same filepath has already been loaded, continue to next one. (optimization)
-                    break;
-                }
-            }
-            if (!skip)
-            {   // if texture hasn't been loaded already, load it
-                Texture texture;
-                texture.id = TextureFromFile(str.C_Str(), this->directory);
-                texture.type = typeName;
-                texture.path = str.C_Str();
-                textures.push_back(texture);
-                textures_loaded.push_back(texture);  // store it as texture loaded for entire model, to ensure we won't unnecesery load duplicate textures.
-            }
+            Texture texture;
+            texture.id = TextureCache::instance().acquireStreamed(this->directory + '/' + str.C_Str(), TextureDesc::texture2D(0, true, true));
+            texture.type = typeName;
+            texture.path = str.C_Str();
+            textures.push_back(texture);
         }
         return textures;
     }
 };
 
-
-unsigned int TextureFromFile(const char* path, const string& directory, bool gamma)
-{
-    string filename = string(path);
-    filename = directory + '/' + filename;
-
-    unsigned int textureID;
-    glGenTextures(1, &textureID);
-
-    int width, height, nrComponents;
-    unsigned char* data = stbi_load(filename.c_str(), &width, &height, &nrComponents, 0);
-    if (data)
-    {
-        GLenum format;
-        if (nrComponents == 1)
-            format = GL_RED;
-        else if (nrComponents == 3)
-            format = GL_RGB;
-        else if (nrComponents == 4)
-            format = GL_RGBA;
-
-        glBindTexture(GL_TEXTURE_2D, textureID);
-        glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, format, GL_UNSIGNED_BYTE, data);
-        glGenerateMipmap(GL_TEXTURE_2D);
-
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-
-        stbi_image_free(data);
-    }
-    else
-    {
-        std::cout << "Texture failed to load at path: " << path << std::endl;
-        stbi_image_free(data);
-    }
-
-    return textureID;
-}
 #endif
\ No newline at end of file
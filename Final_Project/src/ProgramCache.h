@@ -0,0 +1,215 @@
+#ifndef PROGRAM_CACHE_H
+#define PROGRAM_CACHE_H
+
+#include <glad/glad.h>
+
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#ifdef _WIN32
+#include <direct.h>
+#else
+#include <sys/stat.h>
+#endif
+
+// On-disk cache of linked shader programs (glGetProgramBinary / glProgramBinary)
+// A program is stored in <directory>/<key>.bin, the key is a hash of the shader sources, the defines and
+// the driver (vendor, renderer, version), so a driver update or a modified shader never loads a stale binary.
+// The driver may still reject a binary (e.g. after an update keeping the same version string):
+// then the program is compiled as usual and the cache entry is rewritten.
+class ProgramCache
+{
+public:
+    static ProgramCache& instance()
+    {
+        static ProgramCache cache;
+        return cache;
+    }
+
+    void setEnabled(bool _enabled)
+    {
+        enabled = _enabled;
+    }
+
+    // program binaries need GL 4.1 or ARB_get_program_binary, and at least one binary format
+    bool isAvailable()
+    {
+        if (!enabled || glProgramBinary == NULL || glGetProgramBinary == NULL || glProgramParameteri == NULL)
+            return false;
+        GLint numFormats = 0;
+        glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &numFormats);
+        return numFormats > 0;
+    }
+
+    std::string makeKey(const std::string& vertexCode, const std::string& fragmentCode, const std::string& geometryCode, const std::string& defines)
+    {
+        if (driver.empty())
+        {
+            const char* vendor = reinterpret_cast<const char*>(glGetString(GL_VENDOR));
+            const char* renderer = reinterpret_cast<const char*>(glGetString(GL_RENDERER));
+            const char* version = reinterpret_cast<const char*>(glGetString(GL_VERSION));
+            driver = std::string(vendor ? vendor : "") + "|" + (renderer ? renderer : "") + "|" + (version ? version : "");
+        }
+
+        unsigned long long hash = 14695981039346656037ull; // FNV-1a
+        hashString(hash, driver);
+        hashString(hash, defines);
+        hashString(hash, vertexCode);
+        hashString(hash, fragmentCode);
+        hashString(hash, geometryCode);
+
+        char key[17];
+        std::snprintf(key, sizeof(key), "%016llx", hash);
+        return key;
+    }
+
+    // link the program from the cache, returns false if there's no (valid) binary
+    bool load(const std::string& key, unsigned int program)
+    {
+        long long start = now();
+        std::ifstream in(getPath(key), std::ios::binary);
+        if (!in)
+        {
+            misses++;
+            return false;
+        }
+
+        Header header;
+        in.read(reinterpret_cast<char*>(&header), sizeof(header));
+        // the length must be the rest of the file (a truncated or garbage file is a miss, not an allocation)
+        std::streamoff available = 0;
+        if (in)
+        {
+            std::streampos dataStart = in.tellg();
+            in.seekg(0, std::ios::end);
+            available = in.tellg() - dataStart;
+            in.seekg(dataStart);
+        }
+        bool valid = in && header.magic == MAGIC && static_cast<std::streamoff>(header.length) == available;
+        std::vector<char> binary(valid ? header.length : 0);
+        if (valid)
+            in.read(binary.data(), binary.size());
+        if (!in || header.magic != MAGIC || binary.empty())
+        {
+            misses++;
+            return false;
+        }
+
+        glProgramBinary(program, header.binaryFormat, binary.data(), static_cast<GLsizei>(binary.size()));
+        GLint success = 0;
+        glGetProgramiv(program, GL_LINK_STATUS, &success);
+        if (!success)
+        {
+            // rejected by the driver: fall back to compiling
+            rejected++;
+            misses++;
+            return false;
+        }
+
+        float loadMs = static_cast<float>(now() - start) / 1000.0f;
+        hits++;
+        savedMs += header.compileMs - loadMs;
+        return true;
+    }
+
+    // call before linking, so the driver keeps the binary
+    void prepare(unsigned int program)
+    {
+        glProgramParameteri(program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+    }
+
+    void store(const std::string& key, unsigned int program, float compileMs)
+    {
+        GLint length = 0;
+        glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+        if (length <= 0)
+            return;
+
+        Header header;
+        header.magic = MAGIC;
+        header.compileMs = compileMs;
+        std::vector<char> binary(length);
+        GLsizei written = 0;
+        glGetProgramBinary(program, length, &written, &header.binaryFormat, binary.data());
+        header.length = static_cast<unsigned int>(written);
+
+        makeDirectory();
+        std::ofstream out(getPath(key), std::ios::binary);
+        if (!out)
+        {
+            std::cout << "ProgramCache: can't write " << getPath(key) << std::endl;
+            return;
+        }
+        out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        out.write(binary.data(), written);
+    }
+
+    void printReport() const
+    {
+        std::cout << "Program cache: " << hits << " loaded, " << misses << " compiled";
+        if (rejected > 0)
+            std::cout << " (" << rejected << " binaries rejected by the driver)";
+        if (hits > 0)
+            std::cout << ", startup time saved: " << savedMs << " ms";
+        std::cout << std::endl;
+    }
+
+    long long now() const
+    {
+        return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+private:
+    static const unsigned int MAGIC = 0x42504C47; // "GLPB"
+
+    struct Header
+    {
+        unsigned int magic;
+        GLenum binaryFormat;
+        float compileMs; // time it took to compile & link (to report the time saved)
+        unsigned int length;
+    };
+
+    ProgramCache() : enabled(true), directory("shader_cache"), hits(0), misses(0), rejected(0), savedMs(0.0f) {}
+
+    static void hashString(unsigned long long& hash, const std::string& s)
+    {
+        for (size_t i = 0; i < s.size(); i++)
+        {
+            hash ^= static_cast<unsigned char>(s[i]);
+            hash *= 1099511628211ull;
+        }
+        // separator, so "ab"+"c" and "a"+"bc" are different
+        hash ^= 0xFF;
+        hash *= 1099511628211ull;
+    }
+
+    std::string getPath(const std::string& key) const
+    {
+        return directory + "/" + key + ".bin";
+    }
+
+    void makeDirectory() const
+    {
+#ifdef _WIN32
+        _mkdir(directory.c_str());
+#else
+        mkdir(directory.c_str(), 0755);
+#endif
+    }
+
+    bool enabled;
+    std::string directory;
+    std::string driver;
+
+    unsigned int hits;
+    unsigned int misses;
+    unsigned int rejected;
+    float savedMs;
+};
+
+#endif
@@ -0,0 +1,584 @@
+#ifndef RENDERER_H
+#define RENDERER_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <stbi_image.h>
+
+#include <string>
+#include <vector>
+#include <iostream>
+
+#include "Shader.h"
+#include "ShaderLibrary.h"
+#include "ShaderVariants.h"
+#include "ShaderReloader.h"
+#include "TextureCache.h"
+#include "my_texture_2d.h"
+#include "Mesh.h"
+#include "Skybox.h"
+#include "Model.h"
+#include "Bvh.h"
+#include "Meshlets.h"
+#include "DynamicResolution.h"
+#include "GpuProfiler.h"
+#include "CpuProfiler.h"
+
+const unsigned int SHADOW_WIDTH = 1024;
+const unsigned int SHADOW_HEIGHT = 1024;
+
+// Everything a frame depends on (camera, light & effect switches)
+struct FrameSettings
+{
+    glm::mat4 projection;
+    glm::mat4 view;
+    glm::vec3 viewPos;
+    glm::vec3 lightPos;
+
+    bool toon;
+    bool stencil;
+    bool bloom;
+    float invisible;
+};
+
+myTexture2D loadTextureFromFile(const char* file, bool alpha);
+void renderQuad();
+
+// The rendering pipeline: point shadow cubemap -> skybox & lit scene (into blurFBO) -> blur -> composite
+// It only needs a current OpenGL context, so the window and the headless mode share it.
+class Renderer
+{
+public:
+    Renderer(unsigned int _width, unsigned int _height, DynamicResolution& _dynamicResolution, GpuProfiler& _gpuProfiler)
+        : width(_width), height(_height), dynamicResolution(_dynamicResolution), gpuProfiler(_gpuProfiler),
+          // the compile & link of every program is submitted first, and overlaps with the loading of the assets
+          singleColorShader(shaderLibrary.add("singleColor", "shaders/singleColorShader.vert", "shaders/singleColorShader.frag")),
+          simplePointDepthShader(shaderLibrary.add("simplePointDepth", "shaders/simplePointDepthShader.vert", "shaders/simplePointDepthShader.frag", "shaders/simplePointDepthShader.geo")),
+          bloomShader(shaderLibrary.add("bloom", "shaders/bloomShader.vert", "shaders/bloomShader.frag")), // Final bloom shader
+          blurShader(shaderLibrary.add("blur", "shaders/blurShader.vert", "shaders/blurShader.frag")),
+          skyboxShader(shaderLibrary.add("skybox", "shaders/skyboxShader.vert", "shaders/skyboxShader.frag")),
+          pointShadowShaders("shaders/pointShadowShader.vert", "shaders/pointShadowShader.frag"),
+          hotReload(false),
+          floorMesh(glm::vec3(0.0f)),
+          ourModel("meshs/nanosuit/nanosuit.obj"),
+          // the textures of the cache are assigned below (no GL texture of their own)
+          spotTexture(0), hmap(0), floorTexture(0)
+    {
+        // the lit meshes use variants of pointShadowShader, the ones of the default settings are compiled now
+        pointShadowShaders.setSampler("meshTexture", 0);
+        pointShadowShaders.setSampler("shadowMap", 1);
+        pointShadowShaders.setSampler("scene", 2);
+        for (int i = 0; i < MaterialArrays::MAX_ARRAYS; i++)
+            pointShadowShaders.setSampler("materialArray" + std::to_string(i), MaterialArrays::FIRST_UNIT + i);
+        pointShadowShaders.prepare(ShaderVariants::MESH_TEXTURE | ShaderVariants::SHADOW);
+        pointShadowShaders.prepare(ShaderVariants::SHADOW);
+        pointShadowShaders.prepare(ShaderVariants::SHADOW | ShaderVariants::MATERIAL_ARRAYS);
+
+        // configure global opengl state
+        // -----------------------------
+        glEnable(GL_DEPTH_TEST);
+    
+        glDepthFunc(GL_LESS);
+        glEnable(GL_STENCIL_TEST);
+        glStencilFunc(GL_NOTEQUAL, 1, 0xFF);
+        glStencilOp(GL_KEEP, GL_KEEP, GL_REPLACE);
+
+        glEnable(GL_CULL_FACE);
+
+        std::vector<std::string> faces
+        {
+            "textures/skybox_rock/right.png",
+            "textures/skybox_rock/left.png",
+            "textures/skybox_rock/top.png",
+            "textures/skybox_rock/bottom.png",
+            "textures/skybox_rock/front.png",
+            "textures/skybox_rock/back.png"
+        };
+
+        // decode the images of the textures below in parallel (RGB & RGBA ones), then upload them
+        TextureCache::instance().prefetch({ "textures/others/spot_texture.png", "textures/others/hmap.jpg" }, 3);
+        TextureCache::instance().prefetch(faces, 4);
+
+        // load textures
+
+        spotTexture = loadTextureFromFile("textures/others/spot_texture.png", false);
+        hmap = loadTextureFromFile("textures/others/hmap.jpg", false); //test
+        floorTexture = loadTextureFromFile("textures/skybox_rock/bottom.png", true);
+
+        // load models (the nanosuit model is loaded in the initializer list)
+        floorMesh.load_vtn("meshs/others/floor.obj");
+
+        // load skybox's texture & vertices
+
+        skybox.load_vertices();
+        skybox.loadCubemap(faces, true);
+
+        // the assets are loaded, now the shaders are needed (use() waits for the ones still compiling)
+        shaderLibrary.printStatus();
+
+        blurShader.use();
+        blurShader.setInt("image", 0);
+
+        bloomShader.use();
+        bloomShader.setInt("scene", 0);
+        bloomShader.setInt("bloomBlur", 1);
+
+        skyboxShader.use();
+        skyboxShader.setInt("skybox", 0);
+
+        ProgramCache::instance().printReport();
+        TextureCache::instance().trimDecoded();
+        TextureCache::instance().printStats();
+
+        // Cube depth map (For point shadow)
+     
+        // Create FBO for storing depth map(cube)    
+        glGenFramebuffers(1, &depthCubeMapFBO);
+        // Create depth cubemap texture
+        glGenTextures(1, &depthCubemap);
+        glBindTexture(GL_TEXTURE_CUBE_MAP, depthCubemap);
+        for (unsigned int i = 0; i < 6; ++i)
+            glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, 0, GL_DEPTH_COMPONENT, SHADOW_WIDTH, SHADOW_HEIGHT, 0, GL_DEPTH_COMPONENT, GL_FLOAT, NULL);
+        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+        //Attach texture to FBO
+        glBindFramebuffer(GL_FRAMEBUFFER, depthCubeMapFBO);
+        glFramebufferTexture(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, depthCubemap, 0);
+        glDrawBuffer(GL_NONE);
+        glReadBuffer(GL_NONE);
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    
+
+        // Create FBO for post-processing
+        glGenFramebuffers(1, &blurFBO);
+        glBindFramebuffer(GL_FRAMEBUFFER, blurFBO);
+
+        // Create 2 color attachment to this FBO. One for the real scene, and the other for the bright part
+        glGenTextures(2, colorBuffers);
+        for (unsigned int i = 0; i < 2; i++)
+        {
+            glBindTexture(GL_TEXTURE_2D, colorBuffers[i]);
+            glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA16F, width, height, 0, GL_RGBA, GL_FLOAT, NULL);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);  // we clamp to the edge as the blur filter would otherwise sample repeated texture values!
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+            // attach texture to framebuffer
+            glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0 + i, GL_TEXTURE_2D, colorBuffers[i], 0);
+        }
+
+        // create depth & stencil buffer (renderbuffer)
+        // note that we need both depth and stencil buffer
+        glGenRenderbuffers(1, &rboDepthStencil);
+        glBindRenderbuffer(GL_RENDERBUFFER, rboDepthStencil);
+        glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH24_STENCIL8, width, height);
+        glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_RENDERBUFFER, rboDepthStencil);
+    
+        // tell OpenGL which color attachments we'll use (of this framebuffer) for rendering 
+        unsigned int attachments[2] = { GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1 };
+        glDrawBuffers(2, attachments);
+        // finally check if framebuffer is complete
+        if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+            std::cout << "Framebuffer not complete!" << std::endl;
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+        // ping-pong-framebuffer for blurring
+        // ping-pong: blur horizentally and then vertically, repeat these 2 steps to save the blur time(Ex. 1024 -> 32+32)
+        glGenFramebuffers(2, pingpongFBO);
+        glGenTextures(2, pingpongColorbuffers);
+        // Create 2 color attachment to ping-pong FBO
+        for (unsigned int i = 0; i < 2; i++)
+        {
+            glBindFramebuffer(GL_FRAMEBUFFER, pingpongFBO[i]);
+            glBindTexture(GL_TEXTURE_2D, pingpongColorbuffers[i]);
+            glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA16F, width, height, 0, GL_RGBA, GL_FLOAT, NULL);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE); // we clamp to the edge as the blur filter would otherwise sample repeated texture values!
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+            glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, pingpongColorbuffers[i], 0);
+            // also check if framebuffers are complete (no need for depth buffer)
+            if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+                std::cout << "Framebuffer not complete!" << std::endl;
+        }
+    }
+
+    ~Renderer()
+    {
+        TextureCache::instance().stopStreaming();
+        TextureCache::instance().release(spotTexture.textureID);
+        TextureCache::instance().release(hmap.textureID);
+        TextureCache::instance().release(floorTexture.textureID);
+    }
+
+    // rebuild the shaders when the files in shaders/ are saved (the window only, the other modes need fixed shaders)
+    void enableHotReload()
+    {
+        if (!shaderReloader.start())
+            return;
+        shaderReloader.watch(singleColorShader);
+        shaderReloader.watch(simplePointDepthShader);
+        shaderReloader.watch(blurShader, [](Shader& shader) {
+            shader.use();
+            shader.setInt("image", 0);
+        });
+        shaderReloader.watch(bloomShader, [](Shader& shader) {
+            shader.use();
+            shader.setInt("scene", 0);
+            shader.setInt("bloomBlur", 1);
+        });
+        shaderReloader.watch(skyboxShader, [](Shader& shader) {
+            shader.use();
+            shader.setInt("skybox", 0);
+        });
+        pointShadowShaders.setReloader(&shaderReloader);
+        hotReload = true;
+    }
+
+    // render one frame, the final (tone mapped) image goes to outputFBO (0: the window)
+    void renderFrame(const FrameSettings& settings, unsigned int outputFBO)
+    {
+        if (hotReload)
+            shaderReloader.update();
+        TextureCache::instance().update();
+
+        CpuStageTimer stage;
+        stage.next("matrices");
+
+        dynamicResolution.beginFrame();
+        gpuProfiler.beginFrame();
+        glBindFramebuffer(GL_FRAMEBUFFER, outputFBO);
+        glClearColor(0.3f, 0.3f, 0.3f, 1.0f);
+        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT | GL_STENCIL_BUFFER_BIT); // stencil buffer
+
+        const glm::mat4& projection = settings.projection;
+        const glm::mat4& view = settings.view;
+        glm::vec3 viewPos = settings.viewPos;
+        glm::vec3 lightPos = settings.lightPos;
+        float invisible = settings.invisible;
+        bool toon = settings.toon;
+        bool stencil = settings.stencil;
+        bool bloom = settings.bloom;
+
+        // Step 1. Render to depth map
+        // Setting transform matrices
+        float point_near_plane = 1.0f;
+        float point_far_plane = 250.0f;
+        glm::mat4 shadowProj = glm::perspective(glm::radians(90.0f), (float)SHADOW_WIDTH / (float)SHADOW_HEIGHT, point_near_plane, point_far_plane);
+        std::vector<glm::mat4> shadowTransforms;
+        // Light will face 6 different direction and record the depth of objects on cubemap
+        shadowTransforms.push_back(shadowProj * glm::lookAt(lightPos, lightPos + glm::vec3(1.0f, 0.0f, 0.0f), glm::vec3(0.0f, -1.0f, 0.0f)));
+        shadowTransforms.push_back(shadowProj * glm::lookAt(lightPos, lightPos + glm::vec3(-1.0f, 0.0f, 0.0f), glm::vec3(0.0f, -1.0f, 0.0f)));
+        shadowTransforms.push_back(shadowProj * glm::lookAt(lightPos, lightPos + glm::vec3(0.0f, 1.0f, 0.0f), glm::vec3(0.0f, 0.0f, 1.0f)));
+        shadowTransforms.push_back(shadowProj * glm::lookAt(lightPos, lightPos + glm::vec3(0.0f, -1.0f, 0.0f), glm::vec3(0.0f, 0.0f, -1.0f)));
+        shadowTransforms.push_back(shadowProj * glm::lookAt(lightPos, lightPos + glm::vec3(0.0f, 0.0f, 1.0f), glm::vec3(0.0f, -1.0f, 0.0f)));
+        shadowTransforms.push_back(shadowProj * glm::lookAt(lightPos, lightPos + glm::vec3(0.0f, 0.0f, -1.0f), glm::vec3(0.0f, -1.0f, 0.0f)));
+
+        // world matrices of the meshes which moved (the BVH is refitted), what the camera & the faces of the shadow
+        // cubemap can see, then the levels of detail of the model for the camera & the shadow cubemap
+        updateSceneBvh(ourModel.updateTransforms() > 0);
+        cullObjects(projection * view, shadowTransforms);
+        ourModel.selectLods(viewPos, projection[1][1] * 0.5f * dynamicResolution.getHeight(), lightPos, shadowProj[1][1] * 0.5f * SHADOW_HEIGHT);
+        // the meshlets which the camera can't see (back faces are culled by GL_CULL_FACE anyway)
+        ourModel.cullMeshlets(projection * view, viewPos, true);
+
+        stage.next("shadow pass");
+        glViewport(0, 0, SHADOW_WIDTH, SHADOW_HEIGHT);
+        simplePointDepthShader.use();
+        for (unsigned int i = 0; i < 6; ++i)
+            simplePointDepthShader.setMat4("shadowMatrices[" + std::to_string(i) + "]", shadowTransforms[i]);
+        simplePointDepthShader.setFloat("far_plane", point_far_plane);
+        simplePointDepthShader.setVec3("lightPos", lightPos);
+
+        // Bind the framebuffer to depth FBO to store the depth of objects
+        gpuProfiler.begin("shadow cubemap");
+        glBindFramebuffer(GL_FRAMEBUFFER, depthCubeMapFBO);
+        glClear(GL_DEPTH_BUFFER_BIT);
+
+        // Draw to store the depths
+        if (shadowVisible[FLOOR_OBJECT])
+            floorMesh.draw_only_model(simplePointDepthShader, false);
+        ourModel.draw_only_model(simplePointDepthShader);
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+        gpuProfiler.end();
+
+        // Step 2. Draw the scene onto the blurFBO. Using the depthFBO to create shadow
+
+        // Bind the framebuffer to blurFBO
+        stage.next("scene pass");
+        // With dynamic resolution, only the lower-left (scaled) part of blurFBO is rendered
+        unsigned int renderWidth = dynamicResolution.getWidth();
+        unsigned int renderHeight = dynamicResolution.getHeight();
+        glm::vec2 renderScale = dynamicResolution.getUVScale();
+        glBindFramebuffer(GL_FRAMEBUFFER, blurFBO);
+        glViewport(0, 0, renderWidth, renderHeight);
+        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT | GL_STENCIL_BUFFER_BIT);
+        glEnable(GL_DEPTH_TEST);
+
+    
+        // Draw the skybox
+        gpuProfiler.begin("skybox");
+        skybox.draw(skyboxShader, view, projection);
+        glClear(GL_STENCIL_BUFFER_BIT);
+        gpuProfiler.end();
+
+        // Draw the real scene
+        gpuProfiler.begin("lit meshes");
+        // the floor has no shadow while the model is invisible, the invisible model doesn't need the shadow
+        unsigned int toonFeature = toon ? ShaderVariants::TOON : 0;
+        unsigned int floorFeatures = ShaderVariants::MESH_TEXTURE | toonFeature | (invisible < 0.1f ? ShaderVariants::SHADOW : 0);
+        unsigned int modelFeatures = toonFeature | (invisible > 0.1f ? ShaderVariants::INVISIBLE : ShaderVariants::SHADOW) |
+            (ourModel.prepareMaterialArrays() ? ShaderVariants::MATERIAL_ARRAYS : 0);
+        if (cameraVisible[FLOOR_OBJECT])
+            floorMesh.draw_point_shadow(pointShadowShaders.get(floorFeatures), singleColorShader, projection, view, viewPos, lightPos, floorTexture, depthCubemap, colorBuffers[0], 0.0f, point_far_plane, false, false);
+        glClear(GL_STENCIL_BUFFER_BIT);
+        ourModel.draw_point_shadow(pointShadowShaders.get(modelFeatures), singleColorShader, projection, view, viewPos, lightPos, floorTexture, depthCubemap, colorBuffers[0], invisible, point_far_plane, stencil);
+        gpuProfiler.end();
+
+        // Draw the frame of the model
+        gpuProfiler.begin("stencil outline");
+        ourModel.draw_stencil_frame(singleColorShader, projection, view, stencil);
+        gpuProfiler.end();
+
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+        // Step 3. Blur. Use the hdrFBO, which contain normal scene and bloom part, to create the blur effect.
+
+        // Use ping-pong skill to blur the bloom part of the FBO(using gauss blur)
+        stage.next("blur");
+        bool horizontal = true, first_iteration = true;
+        gpuProfiler.begin("blur");
+        if (bloom)
+        {
+            unsigned int amount = 14;
+            blurShader.use();
+            blurShader.setVec2("renderScale", renderScale);
+            for (unsigned int i = 0; i < amount; i++)
+            {
+                glBindFramebuffer(GL_FRAMEBUFFER, pingpongFBO[horizontal]);
+                blurShader.setInt("horizontal", horizontal);
+                glActiveTexture(GL_TEXTURE0);
+                glBindTexture(GL_TEXTURE_2D, first_iteration ? colorBuffers[1] : pingpongColorbuffers[!horizontal]);  // bind texture of other framebuffer (or scene if first iteration)
+                renderQuad();
+                horizontal = !horizontal;
+                if (first_iteration)
+                    first_iteration = false;
+            }
+            glBindFramebuffer(GL_FRAMEBUFFER, 0);
+        }
+        gpuProfiler.end();
+
+        // Step 4. Render the blurred scene onto the screen (upscaled to the screen resolution).
+        stage.next("composite");
+        gpuProfiler.begin("composite");
+        glBindFramebuffer(GL_FRAMEBUFFER, outputFBO);
+        glViewport(0, 0, width, height);
+        glClear(GL_COLOR_BUFFER_BIT);
+        bloomShader.use();
+        bloomShader.setVec2("renderScale", renderScale);
+        glActiveTexture(GL_TEXTURE0);
+        glBindTexture(GL_TEXTURE_2D, colorBuffers[0]);
+        glActiveTexture(GL_TEXTURE1);
+        if (bloom)
+        {
+            glBindTexture(GL_TEXTURE_2D, pingpongColorbuffers[!horizontal]);
+        }
+        else
+        {
+            glBindTexture(GL_TEXTURE_2D, colorBuffers[1]);
+        }
+        renderQuad();
+        gpuProfiler.end();
+
+        dynamicResolution.endFrame();
+    }
+
+    unsigned int getWidth() const
+    {
+        return width;
+    }
+
+    unsigned int getHeight() const
+    {
+        return height;
+    }
+
+    // the mesh of the model whose nearest triangle is hit by a world space ray (the floor hides what is behind it), -1 for none
+    int pick(const glm::vec3& origin, const glm::vec3& direction)
+    {
+        std::vector<std::pair<float, unsigned int> > hits;
+        sceneBvh.queryRay(origin, direction, hits);
+        int picked = -1;
+        bool hit = false;
+        float nearest = 0.0f;
+        for (unsigned int i = 0; i < hits.size(); i++)
+        {
+            // the boxes further than the nearest hit can't have a nearer triangle
+            if (hit && hits[i].first > nearest)
+                break;
+            float t;
+            bool floor = hits[i].second == FLOOR_OBJECT;
+            bool objectHit = floor ? floorMesh.intersectRay(origin, direction, false, t) : ourModel.meshes[hits[i].second - 1].intersectRay(origin, direction, t);
+            if (objectHit && (!hit || t < nearest))
+            {
+                picked = floor ? -1 : static_cast<int>(hits[i].second) - 1;
+                nearest = t;
+                hit = true;
+            }
+        }
+        return picked;
+    }
+
+    const Bvh& getBvh() const { return sceneBvh; }
+
+private:
+    unsigned int width;
+    unsigned int height;
+
+    DynamicResolution& dynamicResolution;
+    GpuProfiler& gpuProfiler;
+
+    // Shaders
+    ShaderLibrary shaderLibrary;
+    Shader& singleColorShader;
+    Shader& simplePointDepthShader;
+    Shader& bloomShader;
+    Shader& blurShader;
+    Shader& skyboxShader;
+    ShaderVariants pointShadowShaders;
+    ShaderReloader shaderReloader;
+    bool hotReload;
+
+public:
+    // Meshs
+    Mesh floorMesh;
+    Model ourModel;
+
+private:
+    // Textures
+    myTexture2D spotTexture;
+    myTexture2D hmap;
+    myTexture2D floorTexture;
+
+    // Skyboxs
+    Skybox skybox;
+
+    // Cube depth map (For point shadow)
+    unsigned int depthCubeMapFBO;
+    unsigned int depthCubemap;
+
+    // FBO for post-processing (scene & bright part) and its depth & stencil buffer
+    unsigned int blurFBO;
+    unsigned int colorBuffers[2];
+    unsigned int rboDepthStencil;
+
+    // ping-pong-framebuffer for blurring
+    unsigned int pingpongFBO[2];
+    unsigned int pingpongColorbuffers[2];
+
+    // BVH over the world bounds of the floor (object 0) & of the meshes of the model (object i + 1: mesh i)
+    static const unsigned int FLOOR_OBJECT = 0;
+    Bvh sceneBvh;
+    std::vector<Bvh::Aabb> objectBounds;
+    std::vector<unsigned char> cameraVisible;
+    std::vector<unsigned char> shadowVisible; // from any face of the shadow cubemap
+
+    // built when the objects change, refitted when they moved
+    void updateSceneBvh(bool moved)
+    {
+        unsigned int objects = static_cast<unsigned int>(ourModel.meshes.size()) + 1;
+        if (sceneBvh.size() == objects && !moved)
+            return;
+        objectBounds.resize(objects);
+        objectBounds[FLOOR_OBJECT] = floorMesh.getWorldBounds(false);
+        for (unsigned int i = 0; i < ourModel.meshes.size(); i++)
+            objectBounds[i + 1] = ourModel.meshes[i].getWorldBounds();
+        if (sceneBvh.size() != objects)
+            sceneBvh.build(objectBounds);
+        else
+            sceneBvh.refit(objectBounds);
+    }
+
+    // the objects which the camera & the faces of the shadow cubemap can see (the others aren't drawn by their pass)
+    void cullObjects(const glm::mat4& viewProjection, const std::vector<glm::mat4>& shadowTransforms)
+    {
+        glm::vec4 planes[6];
+        cameraVisible.assign(sceneBvh.size(), 0);
+        Meshlets::extractPlanes(viewProjection, planes);
+        sceneBvh.queryFrustum(planes, cameraVisible);
+        shadowVisible.assign(sceneBvh.size(), 0);
+        for (unsigned int i = 0; i < shadowTransforms.size(); i++)
+        {
+            Meshlets::extractPlanes(shadowTransforms[i], planes);
+            sceneBvh.queryFrustum(planes, shadowVisible);
+        }
+        for (unsigned int i = 0; i < ourModel.meshes.size(); i++)
+        {
+            ourModel.meshes[i].visible = cameraVisible[i + 1] != 0;
+            ourModel.meshes[i].shadowVisible = shadowVisible[i + 1] != 0;
+        }
+    }
+};
+
+
+// Render the recorded texture/framebuffer.
+unsigned int quadVAO = 0;
+unsigned int quadVBO;
+void renderQuad()
+{
+    if (quadVAO == 0)
+    {
+        float quadVertices[] = {
+            // positions        // texture Coords
+            -1.0f,  1.0f, 0.0f, 0.0f, 1.0f,
+            -1.0f, -1.0f, 0.0f, 0.0f, 0.0f,
+             1.0f,  1.0f, 0.0f, 1.0f, 1.0f,
+             1.0f, -1.0f, 0.0f, 1.0f, 0.0f,
+        };
+        // setup plane VAO
+        glGenVertexArrays(1, &quadVAO);
+        glGenBuffers(1, &quadVBO);
+        glBindVertexArray(quadVAO);
+        glBindBuffer(GL_ARRAY_BUFFER, quadVBO);
+        glBufferData(GL_ARRAY_BUFFER, sizeof(quadVertices), &quadVertices, GL_STATIC_DRAW);
+        glEnableVertexAttribArray(0);
+        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 5 * sizeof(float), (void*)0);
+        glEnableVertexAttribArray(1);
+        glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 5 * sizeof(float), (void*)(3 * sizeof(float)));
+    }
+    glBindVertexArray(quadVAO);
+    glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+    glBindVertexArray(0);
+}
+
+myTexture2D loadTextureFromFile(const char* file, bool alpha)
+{
+    CPU_PROFILE_SCOPE("loadTextureFromFile");
+
+    // load image (flipped, preventing from upside down), the texture is the one of the cache
+    TextureDesc desc = TextureDesc::texture2D(alpha ? 4 : 3, true, false, GL_REPEAT);
+    myTexture2D texture(TextureCache::instance().acquire(file, desc));
+
+    // change format if the image has the alpha channel
+    if (alpha)
+    {
+        texture.internalFormat = GL_RGBA;
+        texture.imageFormat = GL_RGBA;
+    }
+    const TextureCache::Info* info = TextureCache::instance().getInfo(texture.textureID);
+    if (info == nullptr)
+    {
+        std::cout << "loadTextureFromFile: " << file << " isn't a texture of the cache" << std::endl;
+        return texture;
+    }
+    texture.width = info->width;
+    texture.height = info->height;
+    return texture;
+}
+
+#endif
@@ -0,0 +1,70 @@
+#ifndef SCENE_GRAPH_H
+#define SCENE_GRAPH_H
+
+#include <glm/glm.hpp>
+
+#include <string>
+#include <vector>
+
+// Transform hierarchy stored as flat arrays in topological order (a parent always comes before its children),
+// so that the world matrices are updated by one linear pass. setLocal only marks the node dirty: update()
+// recomputes the dirty nodes & their descendants, the world matrices of the other nodes stay cached.
+class SceneGraph
+{
+public:
+    // appends a node, its parent must already be in the graph (-1: a root). Returns its index
+    int addNode(int parent, const glm::mat4& local, const std::string& name)
+    {
+        if (parent >= static_cast<int>(parents.size()))
+            parent = -1;
+        parents.push_back(parent);
+        locals.push_back(local);
+        worlds.push_back(local);
+        names.push_back(name);
+        dirty.push_back(1);
+        updated.push_back(0);
+        return static_cast<int>(parents.size()) - 1;
+    }
+
+    void setLocal(int node, const glm::mat4& local)
+    {
+        locals[node] = local;
+        dirty[node] = 1;
+    }
+
+    // the world matrices of the dirty subtrees, returns the number of nodes recomputed
+    unsigned int update()
+    {
+        unsigned int count = 0;
+        for (unsigned int i = 0; i < parents.size(); i++)
+        {
+            int parent = parents[i];
+            updated[i] = dirty[i] || (parent >= 0 && updated[parent]) ? 1 : 0;
+            if (!updated[i])
+                continue;
+            worlds[i] = parent >= 0 ? worlds[parent] * locals[i] : locals[i];
+            dirty[i] = 0;
+            count++;
+        }
+        return count;
+    }
+
+    // whether the last update() changed the world matrix of the node
+    bool isUpdated(int node) const { return updated[node] != 0; }
+
+    const glm::mat4& getWorld(int node) const { return worlds[node]; }
+    const glm::mat4& getLocal(int node) const { return locals[node]; }
+    int getParent(int node) const { return parents[node]; }
+    const std::string& getName(int node) const { return names[node]; }
+    unsigned int size() const { return static_cast<unsigned int>(parents.size()); }
+
+private:
+    std::vector<int> parents;
+    std::vector<glm::mat4> locals;
+    std::vector<glm::mat4> worlds;
+    std::vector<std::string> names;
+    std::vector<unsigned char> dirty;   // setLocal since the last update
+    std::vector<unsigned char> updated; // recomputed by the last update
+};
+
+#endif
@@ -8,14 +8,42 @@
 #include <fstream>
 #include <sstream>
 #include <iostream>
+#include <vector>
+
+#include "CpuProfiler.h"
+#include "ProgramCache.h"
+#include "GLExtensions.h"
 
 class Shader
 {
 public:
     unsigned int ID;
-    
-    Shader(const char* vertexPath, const char* fragmentPath, const char* geometryPath = nullptr)
+
+    Shader() : ID(0), pending(false) {}
+
+    Shader(const char* vertexPath, const char* fragmentPath, const char* geometryPath = nullptr) : ID(0), pending(false)
     {
+        submit(vertexPath, fragmentPath, geometryPath);
+        finish();
+    }
+
+    // Start compiling & linking without asking for the result, so a driver supporting KHR_parallel_shader_compile
+    // can do it on its own threads. The result is checked by finish() (called by the first use()).
+    // defines: "#define ..." lines inserted after #version (see ShaderVariants)
+    void submit(const char* vertexPath, const char* fragmentPath, const char* geometryPath = nullptr, const std::string& defines = "")
+    {
+        CPU_PROFILE_SCOPE("Shader::submit");
+        // remember the sources, to build the program again when they change (see ShaderReloader)
+        vertexSource = vertexPath;
+        fragmentSource = fragmentPath;
+        geometrySource = geometryPath != nullptr ? geometryPath : "";
+        sourceDefines = defines;
+        files.clear();
+        files.push_back(vertexSource);
+        files.push_back(fragmentSource);
+        if (geometryPath != nullptr)
+            files.push_back(geometrySource);
+
         // 1. retrieve the vertex/fragment source code from filePath
         std::string vertexCode;
         std::string fragmentCode;
@@ -56,49 +84,143 @@ public:
         {
             std::cout << "ERROR::SHADER::FILE_NOT_SUCCESFULLY_READ: " << e.what() << std::endl;
         }
+        // resolve the #include directives and add the defines
+        vertexCode = preprocess(vertexCode, vertexPath, defines, files);
+        fragmentCode = preprocess(fragmentCode, fragmentPath, defines, files);
+        if (geometryPath != nullptr)
+            geometryCode = preprocess(geometryCode, geometryPath, defines, files);
+        // 2. load the linked program from the cache if it's there
+        ProgramCache& cache = ProgramCache::instance();
+        useCache = cache.isAvailable();
+        if (useCache)
+        {
+            cacheKey = cache.makeKey(vertexCode, fragmentCode, geometryCode, defines);
+            ID = glCreateProgram();
+            if (cache.load(cacheKey, ID))
+                return;
+            glDeleteProgram(ID);
+        }
+        long long submitStart = cache.now();
+
         const char* vShaderCode = vertexCode.c_str();
         const char* fShaderCode = fragmentCode.c_str();
-        // 2. compile shaders
-        unsigned int vertex, fragment;
+        // 3. compile shaders (the status is checked in finish(), asking for it now would wait for the compiler)
         // vertex shader
         vertex = glCreateShader(GL_VERTEX_SHADER);
         glShaderSource(vertex, 1, &vShaderCode, NULL);
         glCompileShader(vertex);
-        checkCompileErrors(vertex, "VERTEX");
         // fragment Shader
         fragment = glCreateShader(GL_FRAGMENT_SHADER);
         glShaderSource(fragment, 1, &fShaderCode, NULL);
         glCompileShader(fragment);
-        checkCompileErrors(fragment, "FRAGMENT");
         // if geometry shader is given, compile geometry shader
-        unsigned int geometry;
+        geometry = 0;
         if (geometryPath != nullptr)
         {
             const char* gShaderCode = geometryCode.c_str();
             geometry = glCreateShader(GL_GEOMETRY_SHADER);
             glShaderSource(geometry, 1, &gShaderCode, NULL);
             glCompileShader(geometry);
-            checkCompileErrors(geometry, "GEOMETRY");
         }
         // shader Program
         ID = glCreateProgram();
+        if (useCache)
+            cache.prepare(ID);
         glAttachShader(ID, vertex);
         glAttachShader(ID, fragment);
-        if (geometryPath != nullptr)
+        if (geometry != 0)
             glAttachShader(ID, geometry);
         glLinkProgram(ID);
+        pending = true;
+        compileUs = cache.now() - submitStart;
+    }
+
+    // the program can be used without waiting for the compiler
+    bool isReady() const
+    {
+        if (!pending || !GLExtensions::get().parallelShaderCompile)
+            return true;
+        int completed = 0;
+        glGetProgramiv(ID, GL_COMPLETION_STATUS_KHR, &completed);
+        return completed != 0;
+    }
+
+    // wait for the compile & link submitted by submit(), report the errors and save the binary
+    // returns false if the program couldn't be linked
+    bool finish()
+    {
+        if (!pending)
+            return true;
+        CPU_PROFILE_SCOPE("Shader::finish");
+        pending = false;
+
+        // the status queries wait for the compiler
+        ProgramCache& cache = ProgramCache::instance();
+        long long waitStart = cache.now();
+        checkCompileErrors(vertex, "VERTEX");
+        checkCompileErrors(fragment, "FRAGMENT");
+        if (geometry != 0)
+            checkCompileErrors(geometry, "GEOMETRY");
         checkCompileErrors(ID, "PROGRAM");
         // delete the shaders as they're linked into our program now and no longer necessery
         glDeleteShader(vertex);
         glDeleteShader(fragment);
-        if (geometryPath != nullptr)
+        if (geometry != 0)
             glDeleteShader(geometry);
 
+        // save the binary for the next launch, with the time spent in submit() & waiting for the compiler
+        // (not the time between them)
+        int linked = 0;
+        glGetProgramiv(ID, GL_LINK_STATUS, &linked);
+        compileUs += cache.now() - waitStart;
+        if (useCache && linked)
+            cache.store(cacheKey, ID, static_cast<float>(compileUs) / 1000.0f);
+        return linked != 0;
+    }
+
+    // delete the program (& the shaders of an unfinished submit()) without waiting for the compiler:
+    // deleting objects which are being compiled is legal
+    void abandon()
+    {
+        if (pending)
+        {
+            glDeleteShader(vertex);
+            glDeleteShader(fragment);
+            if (geometry != 0)
+                glDeleteShader(geometry);
+            pending = false;
+        }
+        if (ID != 0)
+            glDeleteProgram(ID);
+        ID = 0;
+    }
+
+    // build the program again from the same files & defines (into this shader, which must be empty)
+    void submitLike(const Shader& other)
+    {
+        submit(other.vertexSource.c_str(), other.fragmentSource.c_str(), other.geometrySource.empty() ? nullptr : other.geometrySource.c_str(), other.sourceDefines);
+    }
+
+    // replace the program by the one of other (after a successful reload)
+    void takeProgram(Shader& other)
+    {
+        glDeleteProgram(ID);
+        ID = other.ID;
+        other.ID = 0;
+        files = other.files;
+    }
+
+    // every file the program is built from (sources and #included files)
+    const std::vector<std::string>& getFiles() const
+    {
+        return files;
     }
 
-    // activate the shader
-    void use() const
+    // activate the shader (the first time, wait for it to be linked)
+    void use()
     {
+        if (pending)
+            finish();
         glUseProgram(ID);
     }
     // Uniform Setting functions
@@ -160,6 +282,59 @@ public:
         glUniformMatrix4fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE, &mat[0][0]);
     }
 private: 
+    // state between submit() and finish()
+    bool pending;
+    unsigned int vertex, fragment, geometry;
+    bool useCache;
+    std::string cacheKey;
+    long long compileUs; // submit() & the blocking part of finish()
+
+    // sources of the program
+    std::string vertexSource;
+    std::string fragmentSource;
+    std::string geometrySource;
+    std::string sourceDefines;
+    std::vector<std::string> files;
+
+    // GLSL has no #include: replace each '#include "file"' line by the file (relative to the including file),
+    // and insert the defines right after the #version line
+    static std::string preprocess(const std::string& source, const std::string& path, const std::string& defines, std::vector<std::string>& files, int depth = 0)
+    {
+        std::string directory = path.substr(0, path.find_last_of("/\\") + 1);
+        std::stringstream in(source);
+        std::stringstream out;
+        std::string line;
+        bool definesAdded = defines.empty();
+        while (std::getline(in, line))
+        {
+            size_t start = line.find_first_not_of(" \t");
+            if (start != std::string::npos && line.compare(start, 8, "#include") == 0)
+            {
+                size_t open = line.find('"', start);
+                size_t close = open == std::string::npos ? std::string::npos : line.find('"', open + 1);
+                std::string includePath = close == std::string::npos ? "" : directory + line.substr(open + 1, close - open - 1);
+                std::ifstream includeFile(includePath);
+                if (depth > 16 || !includeFile)
+                {
+                    std::cout << "ERROR::SHADER::INCLUDE_NOT_FOUND: " << line << " in " << path << std::endl;
+                    continue;
+                }
+                files.push_back(includePath);
+                std::stringstream includeStream;
+                includeStream << includeFile.rdbuf();
+                out << preprocess(includeStream.str(), includePath, "", files, depth + 1) << "\n";
+                continue;
+            }
+            out << line << "\n";
+            if (!definesAdded && start != std::string::npos && line.compare(start, 8, "#version") == 0)
+            {
+                out << defines;
+                definesAdded = true;
+            }
+        }
+        return out.str();
+    }
+
     void checkCompileErrors(unsigned int shader, std::string type)
     {
         int success;
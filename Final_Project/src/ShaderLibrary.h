@@ -0,0 +1,88 @@
+#ifndef SHADER_LIBRARY_H
+#define SHADER_LIBRARY_H
+
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "Shader.h"
+#include "GLExtensions.h"
+
+// Every shader program of the application
+// add() submits the compile & link right away and returns immediately: with KHR_parallel_shader_compile
+// the driver compiles on its own threads while we import models and decode textures.
+// A program only blocks the first time it's used (Shader::use() / get()).
+class ShaderLibrary
+{
+public:
+    // the returned reference stays valid for the lifetime of the library
+    Shader& add(const std::string& name, const char* vertexPath, const char* fragmentPath, const char* geometryPath = nullptr)
+    {
+        entries.push_back(Entry());
+        entries.back().name = name;
+        entries.back().shader.reset(new Shader());
+        entries.back().shader->submit(vertexPath, fragmentPath, geometryPath);
+        return *entries.back().shader;
+    }
+
+    // the program, linked (waits for the compiler if needed)
+    Shader& get(const std::string& name)
+    {
+        for (unsigned int i = 0; i < entries.size(); i++)
+        {
+            if (entries[i].name == name)
+            {
+                entries[i].shader->finish();
+                return *entries[i].shader;
+            }
+        }
+        std::cout << "ShaderLibrary: no shader named " << name << std::endl;
+        static Shader empty;
+        return empty;
+    }
+
+    // finish the programs the driver is done with (never blocks), returns how many are still compiling
+    unsigned int poll()
+    {
+        unsigned int stillPending = 0;
+        for (unsigned int i = 0; i < entries.size(); i++)
+        {
+            if (entries[i].shader->isReady())
+                entries[i].shader->finish();
+            else
+                stillPending++;
+        }
+        return stillPending;
+    }
+
+    void finishAll()
+    {
+        for (unsigned int i = 0; i < entries.size(); i++)
+            entries[i].shader->finish();
+    }
+
+    // how much of the compilation was hidden behind the asset loading
+    void printStatus()
+    {
+        unsigned int total = static_cast<unsigned int>(entries.size());
+        if (!GLExtensions::get().parallelShaderCompile)
+        {
+            std::cout << "ShaderLibrary: " << total << " programs (compiled serially)" << std::endl;
+            return;
+        }
+        unsigned int stillPending = poll();
+        std::cout << "ShaderLibrary: " << total - stillPending << "/" << total << " programs ready after loading the assets" << std::endl;
+    }
+
+private:
+    struct Entry
+    {
+        std::string name;
+        std::unique_ptr<Shader> shader;
+    };
+
+    std::vector<Entry> entries;
+};
+
+#endif
@@ -0,0 +1,198 @@
+#ifndef SHADER_RELOADER_H
+#define SHADER_RELOADER_H
+
+#include <glad/glad.h>
+
+#include <chrono>
+#include <functional>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <sys/stat.h>
+#ifdef __linux__
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+#include "Shader.h"
+#include "CpuProfiler.h"
+
+// Rebuild the shader programs when their files are saved, while the application is running
+// The new program is compiled beside the old one (on the driver threads with KHR_parallel_shader_compile,
+// so the frames keep going), and only replaces it if it links: a typo in a shader prints the error and
+// the previous program stays in use.
+// Linux uses inotify on the shader directory, the other platforms check the modification times twice a second.
+class ShaderReloader
+{
+public:
+    typedef std::function<void(Shader&)> Callback;
+
+    ShaderReloader(const std::string& _directory = "shaders") : directory(_directory), watchFD(-1), lastPoll(std::chrono::steady_clock::now()) {}
+
+    ~ShaderReloader()
+    {
+        stop();
+    }
+
+    bool start()
+    {
+#ifdef __linux__
+        watchFD = inotify_init1(IN_NONBLOCK);
+        if (watchFD < 0 || inotify_add_watch(watchFD, directory.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE) < 0)
+        {
+            std::cout << "ShaderReloader: can't watch " << directory << std::endl;
+            stop();
+            return false;
+        }
+#endif
+        std::cout << "Shader hot reload: watching " << directory << std::endl;
+        return true;
+    }
+
+    void stop()
+    {
+#ifdef __linux__
+        if (watchFD >= 0)
+            close(watchFD);
+#endif
+        watchFD = -1;
+    }
+
+    // onReload is called after the program of the shader has been replaced (to set its uniforms again)
+    void watch(Shader& shader, Callback onReload = Callback())
+    {
+        Entry entry;
+        entry.shader = &shader;
+        entry.onReload = onReload;
+        entries.push_back(std::move(entry));
+        for (unsigned int i = 0; i < shader.getFiles().size(); i++)
+            modifiedTimes[shader.getFiles()[i]] = getModifiedTime(shader.getFiles()[i]);
+    }
+
+    // once per frame: look for saved files, then finish the programs the driver is done with (never blocks
+    // when the driver compiles in parallel)
+    void update()
+    {
+        CPU_PROFILE_SCOPE("ShaderReloader::update");
+        std::vector<std::string> changed = collectChanges();
+        for (unsigned int i = 0; i < entries.size(); i++)
+        {
+            Entry& entry = entries[i];
+            if (dependsOn(*entry.shader, changed))
+            {
+                // a file saved again while compiling: start over from the new version
+                discard(entry);
+                entry.candidate.reset(new Shader());
+                entry.candidate->submitLike(*entry.shader);
+            }
+            if (!entry.candidate || !entry.candidate->isReady())
+                continue;
+
+            if (entry.candidate->finish())
+            {
+                entry.shader->takeProgram(*entry.candidate);
+                if (entry.onReload)
+                    entry.onReload(*entry.shader);
+                std::cout << "Shader reloaded: " << entry.shader->getFiles()[1] << std::endl;
+            }
+            else
+            {
+                std::cout << "Shader reload failed, keeping the previous program: " << entry.shader->getFiles()[1] << std::endl;
+            }
+            discard(entry);
+        }
+    }
+
+private:
+    struct Entry
+    {
+        Shader* shader;
+        Callback onReload;
+        std::unique_ptr<Shader> candidate;
+    };
+
+    std::vector<std::string> collectChanges()
+    {
+        std::vector<std::string> changed;
+#ifdef __linux__
+        if (watchFD >= 0)
+        {
+            // an editor saving a file gives several events, they are all read at once
+            alignas(struct inotify_event) char buffer[4096];
+            ssize_t length;
+            while ((length = read(watchFD, buffer, sizeof(buffer))) > 0)
+            {
+                for (char* p = buffer; p < buffer + length; )
+                {
+                    const struct inotify_event* event = reinterpret_cast<const struct inotify_event*>(p);
+                    if (event->len > 0)
+                        changed.push_back(directory + "/" + event->name);
+                    p += sizeof(struct inotify_event) + event->len;
+                }
+            }
+            return changed;
+        }
+#endif
+        std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+        if (now - lastPoll < std::chrono::milliseconds(500))
+            return changed;
+        lastPoll = now;
+        for (std::map<std::string, long long>::iterator it = modifiedTimes.begin(); it != modifiedTimes.end(); ++it)
+        {
+            long long modifiedTime = getModifiedTime(it->first);
+            if (modifiedTime != it->second)
+            {
+                it->second = modifiedTime;
+                changed.push_back(it->first);
+            }
+        }
+        return changed;
+    }
+
+    static bool dependsOn(const Shader& shader, const std::vector<std::string>& changed)
+    {
+        for (unsigned int i = 0; i < changed.size(); i++)
+        {
+            for (unsigned int j = 0; j < shader.getFiles().size(); j++)
+            {
+                if (sameFile(shader.getFiles()[j], changed[i]))
+                    return true;
+            }
+        }
+        return false;
+    }
+
+    // compare the file names only: the watcher reports "shaders/<name>", the includes are relative to their parent
+    static bool sameFile(const std::string& a, const std::string& b)
+    {
+        return a.substr(a.find_last_of("/\\") + 1) == b.substr(b.find_last_of("/\\") + 1);
+    }
+
+    static void discard(Entry& entry)
+    {
+        if (!entry.candidate)
+            return;
+        // an in-flight compile is dropped, not waited for
+        entry.candidate->abandon();
+        entry.candidate.reset();
+    }
+
+    static long long getModifiedTime(const std::string& path)
+    {
+        struct stat status;
+        if (stat(path.c_str(), &status) != 0)
+            return 0;
+        return static_cast<long long>(status.st_mtime);
+    }
+
+    std::string directory;
+    int watchFD;
+    std::chrono::steady_clock::time_point lastPoll;
+    std::vector<Entry> entries;
+    std::map<std::string, long long> modifiedTimes;
+};
+
+#endif
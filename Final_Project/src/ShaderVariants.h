@@ -0,0 +1,136 @@
+#ifndef SHADER_VARIANTS_H
+#define SHADER_VARIANTS_H
+
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "Shader.h"
+#include "ShaderReloader.h"
+
+// Permutations of one shader source, selected by feature #defines
+// Each draw uses a program specialized for its features (no uniform branches in the fragment shader).
+// A variant is compiled the first time it's asked for, then cached by its key (features + PCF taps).
+class ShaderVariants
+{
+public:
+    enum Feature
+    {
+        TOON = 1 << 0,
+        SHADOW = 1 << 1,
+        INVISIBLE = 1 << 2,
+        MESH_TEXTURE = 1 << 3,
+        MATERIAL_ARRAYS = 1 << 4
+    };
+
+    ShaderVariants(const std::string& _vertexPath, const std::string& _fragmentPath, int _pcfTaps = 20)
+        : vertexPath(_vertexPath), fragmentPath(_fragmentPath), pcfTaps(_pcfTaps), reloader(nullptr) {}
+
+    // texture unit of a sampler, set on every variant when it's created
+    void setSampler(const std::string& name, int unit)
+    {
+        Sampler sampler = { name, unit };
+        samplers.push_back(sampler);
+    }
+
+    // rebuild the variants when their files change (the ones created later are watched too)
+    void setReloader(ShaderReloader* _reloader)
+    {
+        reloader = _reloader;
+        for (std::map<unsigned int, Variant>::iterator it = variants.begin(); it != variants.end(); ++it)
+            watch(it->second);
+    }
+
+    void setPCFTaps(int _pcfTaps)
+    {
+        pcfTaps = _pcfTaps;
+    }
+
+    // start compiling a variant without waiting (for the variants needed by the first frame)
+    void prepare(unsigned int features)
+    {
+        findOrSubmit(features);
+    }
+
+    // the program of these features, ready to use
+    Shader& get(unsigned int features)
+    {
+        Variant& variant = findOrSubmit(features);
+        if (!variant.configured)
+        {
+            variant.shader->use();
+            for (unsigned int i = 0; i < samplers.size(); i++)
+                variant.shader->setInt(samplers[i].name, samplers[i].unit);
+            variant.configured = true;
+        }
+        return *variant.shader;
+    }
+
+    std::string getDefines(unsigned int features) const
+    {
+        std::string defines;
+        if (features & TOON)
+            defines += "#define TOON\n";
+        if (features & SHADOW)
+            defines += "#define SHADOW\n";
+        if (features & INVISIBLE)
+            defines += "#define INVISIBLE\n";
+        if (features & MESH_TEXTURE)
+            defines += "#define MESH_TEXTURE\n";
+        if (features & MATERIAL_ARRAYS)
+            defines += "#define MATERIAL_ARRAYS\n";
+        defines += "#define PCF_TAPS " + std::to_string(pcfTaps) + "\n";
+        return defines;
+    }
+
+    unsigned int size() const
+    {
+        return static_cast<unsigned int>(variants.size());
+    }
+
+private:
+    struct Sampler
+    {
+        std::string name;
+        int unit;
+    };
+
+    struct Variant
+    {
+        std::unique_ptr<Shader> shader;
+        bool configured;
+    };
+
+    Variant& findOrSubmit(unsigned int features)
+    {
+        unsigned int key = features | (static_cast<unsigned int>(pcfTaps) << 16);
+        std::map<unsigned int, Variant>::iterator it = variants.find(key);
+        if (it != variants.end())
+            return it->second;
+
+        Variant& variant = variants[key];
+        variant.shader.reset(new Shader());
+        variant.shader->submit(vertexPath.c_str(), fragmentPath.c_str(), nullptr, getDefines(features));
+        variant.configured = false;
+        if (reloader != nullptr)
+            watch(variant);
+        return variant;
+    }
+
+    void watch(Variant& variant)
+    {
+        // a new program has none of the samplers set
+        reloader->watch(*variant.shader, [&variant](Shader&) { variant.configured = false; });
+    }
+
+    std::string vertexPath;
+    std::string fragmentPath;
+    int pcfTaps;
+
+    ShaderReloader* reloader;
+    std::vector<Sampler> samplers;
+    std::map<unsigned int, Variant> variants;
+};
+
+#endif
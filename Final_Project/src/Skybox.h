@@ -17,10 +17,19 @@
 #include <iostream>
 #include <vector>
 
+#include "CpuProfiler.h"
+#include "TextureCache.h"
+
 class Skybox 
 {
 public:
-	Skybox() {};  
+	Skybox() : cubeMapTextureID(0) {};  
+
+	~Skybox()
+	{
+		if (cubeMapTextureID != 0)
+			TextureCache::instance().release(cubeMapTextureID);
+	}
 
     // Vertices: [1, 1, 1] box
     void load_vertices()
@@ -105,6 +114,7 @@ public:
         glBindVertexArray(this->VAO);
         glActiveTexture(GL_TEXTURE0);
         glBindTexture(GL_TEXTURE_CUBE_MAP, this->cubeMapTextureID);
+        TextureCache::instance().touch(this->cubeMapTextureID);
         glDrawArrays(GL_TRIANGLES, 0, 36);
         glBindVertexArray(0);
         glDepthFunc(GL_LESS); // set depth function back to default
@@ -121,44 +131,9 @@ public:
     // -------------------------------------------------------
     void loadCubemap(std::vector<std::string> faces, const bool& alpha)
     {
-        // unsigned int textureID;
-        glGenTextures(1, &cubeMapTextureID);
-        glBindTexture(GL_TEXTURE_CUBE_MAP, cubeMapTextureID);
-        stbi_set_flip_vertically_on_load(false); // preventing from upside down
-        int width, height, nrChannels;
-
-        auto internalFormat = GL_RGB;
-        auto imageFormat = GL_RGB;
-        if (alpha)
-        {
-            internalFormat = GL_RGBA;
-            imageFormat = GL_RGBA;
-        }
-
-        for (unsigned int i = 0; i < faces.size(); i++)
-        {
-            unsigned char* data = stbi_load(faces[i].c_str(), &width, &height, &nrChannels, 0);
-        std:std::cout << "Index: " << i << std::endl;
-            std::cout << "Width: " << width << std::endl;
-            std::cout << "Width: " << height << std::endl;
-            if (data)
-            {
-                glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, 0, internalFormat, width, height, 0, imageFormat, GL_UNSIGNED_BYTE, data);
-                stbi_image_free(data);
-            }
-            else
-            {
-                std::cout << "Cubemap texture failed to load at path: " << faces[i] << std::endl;
-                stbi_image_free(data);
-            }
-        }
-        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
-
-        glBindTexture(GL_TEXTURE_CUBE_MAP, 0);
+        CPU_PROFILE_SCOPE("Skybox::loadCubemap");
+        // shared through the TextureCache (a face may also be used as a 2D texture, e.g. the floor)
+        cubeMapTextureID = TextureCache::instance().acquire(faces, TextureDesc::cubemap(alpha ? 4 : 3));
     }
 
 private:
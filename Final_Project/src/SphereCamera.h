@@ -99,6 +99,12 @@ public:
 		updateAll();
 	}
 
+	void setTheta(float angle)
+	{
+		theta = angle - 360.0f * glm::floor(angle / 360.0f);
+		updateAll();
+	}
+
 	void updatePhi(float angle)
 	{
 		phi += angle;
@@ -0,0 +1,203 @@
+#ifndef TEXTURE_ATLAS_H
+#define TEXTURE_ATLAS_H
+
+#include <algorithm>
+#include <climits>
+#include <vector>
+
+// Packing of the textures of several materials into one (see Model::buildAtlases)
+// The rectangles are placed with MaxRects (best short side fit). The atlas has the smallest area among the
+// widths tried, it doesn't need to be a power of two.
+// Each tile is surrounded by padding texels wrapped from its opposite side (what GL_REPEAT would sample),
+// and starts on a multiple of ALIGNMENT: the mip levels up to getMaxLevels() never mix two tiles.
+namespace TextureAtlas
+{
+    const int PADDING = 8;
+    const int ALIGNMENT = 16;
+
+    struct Rect
+    {
+        int x;
+        int y;
+        int width;
+        int height;
+    };
+
+    // levels 0 ... 3: at level 3 the padding is still one texel
+    inline int getMaxLevels()
+    {
+        int levels = 1;
+        for (int padding = PADDING; padding > 1; padding /= 2)
+            levels++;
+        return levels;
+    }
+
+    class MaxRectsPacker
+    {
+    public:
+        MaxRectsPacker(int width, int height)
+        {
+            Rect bin = { 0, 0, width, height };
+            freeRects.push_back(bin);
+        }
+
+        // false if it doesn't fit anymore
+        bool insert(int width, int height, Rect& placed)
+        {
+            int bestShort = INT_MAX, bestLong = INT_MAX;
+            for (unsigned int i = 0; i < freeRects.size(); i++)
+            {
+                const Rect& free = freeRects[i];
+                if (free.width < width || free.height < height)
+                    continue;
+                int leftoverX = free.width - width, leftoverY = free.height - height;
+                int shortSide = std::min(leftoverX, leftoverY), longSide = std::max(leftoverX, leftoverY);
+                if (shortSide < bestShort || (shortSide == bestShort && longSide < bestLong))
+                {
+                    Rect rect = { free.x, free.y, width, height };
+                    placed = rect;
+                    bestShort = shortSide;
+                    bestLong = longSide;
+                }
+            }
+            if (bestShort == INT_MAX)
+                return false;
+
+            // split every free rectangle the new one overlaps, then remove the ones inside another
+            std::vector<Rect> split;
+            for (unsigned int i = 0; i < freeRects.size(); i++)
+            {
+                const Rect& free = freeRects[i];
+                if (!overlaps(free, placed))
+                {
+                    split.push_back(free);
+                    continue;
+                }
+                if (placed.x > free.x)
+                    split.push_back(makeRect(free.x, free.y, placed.x - free.x, free.height));
+                if (placed.x + placed.width < free.x + free.width)
+                    split.push_back(makeRect(placed.x + placed.width, free.y, free.x + free.width - placed.x - placed.width, free.height));
+                if (placed.y > free.y)
+                    split.push_back(makeRect(free.x, free.y, free.width, placed.y - free.y));
+                if (placed.y + placed.height < free.y + free.height)
+                    split.push_back(makeRect(free.x, placed.y + placed.height, free.width, free.y + free.height - placed.y - placed.height));
+            }
+            freeRects.clear();
+            for (unsigned int i = 0; i < split.size(); i++)
+            {
+                bool contained = false;
+                for (unsigned int j = 0; j < split.size() && !contained; j++)
+                    contained = i != j && contains(split[j], split[i]) && (!contains(split[i], split[j]) || j < i);
+                if (!contained)
+                    freeRects.push_back(split[i]);
+            }
+            return true;
+        }
+
+    private:
+        static Rect makeRect(int x, int y, int width, int height)
+        {
+            Rect rect = { x, y, width, height };
+            return rect;
+        }
+
+        static bool overlaps(const Rect& a, const Rect& b)
+        {
+            return a.x < b.x + b.width && b.x < a.x + a.width && a.y < b.y + b.height && b.y < a.y + a.height;
+        }
+
+        static bool contains(const Rect& outer, const Rect& inner)
+        {
+            return inner.x >= outer.x && inner.y >= outer.y && inner.x + inner.width <= outer.x + outer.width && inner.y + inner.height <= outer.y + outer.height;
+        }
+
+        std::vector<Rect> freeRects;
+    };
+
+    inline int alignUp(int value)
+    {
+        return (value + ALIGNMENT - 1) / ALIGNMENT * ALIGNMENT;
+    }
+
+    inline Rect makeTile(int x, int y, int width, int height)
+    {
+        Rect rect = { x, y, width, height };
+        return rect;
+    }
+
+    // place the tiles (width & height without padding): tiles gets their position, width & height the atlas size
+    // false if they don't fit in maxSize x maxSize
+    inline bool pack(std::vector<Rect>& tiles, int maxSize, int& width, int& height)
+    {
+        // the largest tiles first
+        std::vector<unsigned int> order(tiles.size());
+        for (unsigned int i = 0; i < order.size(); i++)
+            order[i] = i;
+        std::sort(order.begin(), order.end(), [&](unsigned int a, unsigned int b) {
+            return std::max(tiles[a].width, tiles[a].height) > std::max(tiles[b].width, tiles[b].height);
+        });
+
+        int widest = 0;
+        for (unsigned int i = 0; i < tiles.size(); i++)
+            widest = std::max(widest, alignUp(tiles[i].width + 2 * PADDING));
+
+        long long bestArea = LLONG_MAX;
+        std::vector<Rect> best;
+        for (int binWidth = widest; binWidth <= maxSize; binWidth += 4 * ALIGNMENT)
+        {
+            MaxRectsPacker packer(binWidth, maxSize);
+            std::vector<Rect> placed(tiles.size());
+            int usedWidth = 0, usedHeight = 0;
+            bool fits = true;
+            for (unsigned int i = 0; i < order.size() && fits; i++)
+            {
+                const Rect& tile = tiles[order[i]];
+                Rect rect;
+                fits = packer.insert(alignUp(tile.width + 2 * PADDING), alignUp(tile.height + 2 * PADDING), rect);
+                placed[order[i]] = makeTile(rect.x + PADDING, rect.y + PADDING, tile.width, tile.height);
+                usedWidth = std::max(usedWidth, rect.x + rect.width);
+                usedHeight = std::max(usedHeight, rect.y + rect.height);
+            }
+            long long area = static_cast<long long>(usedWidth) * usedHeight;
+            if (fits && area < bestArea)
+            {
+                bestArea = area;
+                best = placed;
+                width = usedWidth;
+                height = usedHeight;
+            }
+        }
+        if (best.empty())
+            return false;
+        tiles = best;
+        return true;
+    }
+
+    // copy an image (RGBA, rows top to bottom) into its tile of the atlas (RGBA, rows bottom to top like OpenGL),
+    // with its padding
+    inline void blit(const unsigned char* image, const Rect& tile, unsigned char* atlas, int atlasWidth, int atlasHeight)
+    {
+        for (int y = -PADDING; y < tile.height + PADDING; y++)
+        {
+            int atlasY = tile.y + y;
+            if (atlasY < 0 || atlasY >= atlasHeight)
+                continue;
+            int sourceY = tile.height - 1 - ((y % tile.height + tile.height) % tile.height);
+            for (int x = -PADDING; x < tile.width + PADDING; x++)
+            {
+                int atlasX = tile.x + x;
+                if (atlasX < 0 || atlasX >= atlasWidth)
+                    continue;
+                int sourceX = (x % tile.width + tile.width) % tile.width;
+                const unsigned char* source = image + (static_cast<size_t>(sourceY) * tile.width + sourceX) * 4;
+                unsigned char* destination = atlas + (static_cast<size_t>(atlasY) * atlasWidth + atlasX) * 4;
+                destination[0] = source[0];
+                destination[1] = source[1];
+                destination[2] = source[2];
+                destination[3] = source[3];
+            }
+        }
+    }
+}
+
+#endif
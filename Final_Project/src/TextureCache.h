@@ -0,0 +1,802 @@
+#ifndef TEXTURE_CACHE_H
+#define TEXTURE_CACHE_H
+
+#include <glad/glad.h>
+
+#include <stbi_image.h>
+
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "CpuProfiler.h"
+#include "ThreadPool.h"
+#include "TextureStreamer.h"
+#include "DDSFile.h"
+#include "MipGenerator.h"
+#include "TextureResidency.h"
+
+// How a texture is created from its file(s)
+struct TextureDesc
+{
+    GLenum target;      // GL_TEXTURE_2D or GL_TEXTURE_CUBE_MAP (GL_TEXTURE_2D_ARRAY: acquireArray())
+    int channels;       // 0: as in the file, otherwise converted by stb_image (3: RGB, 4: RGBA)
+    bool flip;          // flip vertically (OpenGL's first row is the bottom one)
+    bool mipmaps;
+    GLenum wrap;
+    GLenum minFilter;
+    GLenum magFilter;
+
+    static TextureDesc texture2D(int channels, bool flip, bool mipmaps, GLenum wrap = GL_REPEAT)
+    {
+        TextureDesc desc = { GL_TEXTURE_2D, channels, flip, mipmaps, wrap, static_cast<GLenum>(mipmaps ? GL_LINEAR_MIPMAP_LINEAR : GL_LINEAR), GL_LINEAR };
+        return desc;
+    }
+
+    static TextureDesc cubemap(int channels)
+    {
+        TextureDesc desc = { GL_TEXTURE_CUBE_MAP, channels, false, false, GL_CLAMP_TO_EDGE, GL_LINEAR, GL_LINEAR };
+        return desc;
+    }
+};
+
+// Process-wide cache of the textures loaded from files
+// A texture is keyed by its normalized path(s) and its TextureDesc, so every Model, the floor and the skybox
+// share one GL texture per image. acquire() adds a reference, release() removes one and deletes the GL texture
+// with the last one.
+// The decoded images are also kept while loading (until trimDecoded()), so one file used both as a 2D texture
+// and as a cubemap face is only decoded once. prefetch() decodes a batch of files on the ThreadPool beforehand,
+// leaving only the uploads to the main thread.
+// When an image has been cooked (--cook, see TextureCooker), its DDS file is loaded instead: block-compressed,
+// with the mip chain computed offline.
+// With streaming on, acquireStreamed() returns a placeholder texture at once and the TextureStreamer replaces its
+// image in the following frames (update()).
+// With a budget (setBudget()), the textures not drawn for idleFrames frames lose their top mip level, least
+// recently used first, until the video memory fits (see TextureResidency). touch() marks a texture as used on
+// every bind: a shrunk texture is then streamed back at full resolution.
+// The arrays of acquireArray() (the material arrays) are part of the budget too: shrunk like the other textures,
+// they're restored by loading their layers again.
+class TextureCache
+{
+public:
+    struct Info
+    {
+        GLenum target;
+        int width;
+        int height;
+        int channels;
+        size_t bytes;
+        bool resident; // false while a streamed texture still shows the placeholder
+        int levels;         // mip levels on the GPU
+        int droppedLevels;  // top levels evicted by the budget
+    };
+
+    static TextureCache& instance()
+    {
+        static TextureCache cache;
+        return cache;
+    }
+
+    unsigned int acquire(const std::string& path, const TextureDesc& desc)
+    {
+        std::vector<std::string> files(1, path);
+        return acquire(files, desc);
+    }
+
+    // one file for a 2D texture, 6 faces (+X, -X, +Y, -Y, +Z, -Z) for a cubemap
+    unsigned int acquire(const std::vector<std::string>& files, const TextureDesc& desc)
+    {
+        CPU_PROFILE_SCOPE("TextureCache::acquire");
+        std::vector<std::string> paths(files.size());
+        for (unsigned int i = 0; i < files.size(); i++)
+            paths[i] = normalizePath(files[i]);
+
+        std::string key = makeKey(paths, desc);
+        std::unordered_map<std::string, Entry>::iterator it = entries.find(key);
+        if (it != entries.end())
+        {
+            hits++;
+            it->second.references++;
+            return it->second.id;
+        }
+        misses++;
+
+        Entry entry;
+        entry.id = create(paths, desc, entry.info);
+        entry.references = 1;
+        entry.paths = paths;
+        entry.desc = desc;
+        entry.lastUsed = frame;
+        entry.restoring = false;
+        entry.generated = false;
+        keys[entry.id] = key;
+        entries[key] = entry;
+        liveBytes += entry.info.bytes;
+        if (liveBytes > peakBytes)
+            peakBytes = liveBytes;
+        return entry.id;
+    }
+
+    // a 2D texture made on the CPU (e.g. an atlas, rows bottom to top), the name must be unique (not a file)
+    // with mipmaps, maxLevels limits the mip chain (0: down to 1x1). The budget never shrinks it (there's no file)
+    unsigned int acquireImage(const std::string& name, const unsigned char* pixels, int width, int height, int channels, const TextureDesc& desc,
+        const MipGenerator::Options& options, int maxLevels)
+    {
+        std::vector<std::string> paths(1, name);
+        std::string key = makeKey(paths, desc);
+        std::unordered_map<std::string, Entry>::iterator it = entries.find(key);
+        if (it != entries.end())
+        {
+            hits++;
+            it->second.references++;
+            return it->second.id;
+        }
+        misses++;
+
+        Entry entry;
+        glGenTextures(1, &entry.id);
+        glBindTexture(GL_TEXTURE_2D, entry.id);
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+        GLenum format = getFormat(channels);
+        size_t bytes = 0;
+        int levels = 1;
+        if (desc.mipmaps)
+        {
+            std::vector<unsigned char> mipPixels;
+            std::vector<MipGenerator::Level> mips = MipGenerator::generate(pixels, width, height, channels, options, mipPixels);
+            levels = maxLevels > 0 ? std::min(maxLevels, static_cast<int>(mips.size())) : static_cast<int>(mips.size());
+            for (int l = 0; l < levels; l++)
+            {
+                glTexImage2D(GL_TEXTURE_2D, l, format, mips[l].width, mips[l].height, 0, format, GL_UNSIGNED_BYTE, &mipPixels[mips[l].offset]);
+                bytes += mips[l].size;
+            }
+        }
+        else
+        {
+            glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, format, GL_UNSIGNED_BYTE, pixels);
+            bytes = static_cast<size_t>(width) * height * channels;
+        }
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, levels - 1);
+        setParameters(desc);
+        glBindTexture(GL_TEXTURE_2D, 0);
+
+        entry.references = 1;
+        entry.paths = paths;
+        entry.desc = desc;
+        entry.lastUsed = frame;
+        entry.restoring = false;
+        entry.generated = true;
+        entry.info.target = GL_TEXTURE_2D;
+        entry.info.width = width;
+        entry.info.height = height;
+        entry.info.channels = channels;
+        entry.info.bytes = bytes;
+        entry.info.resident = true;
+        entry.info.levels = levels;
+        entry.info.droppedLevels = 0;
+        keys[entry.id] = key;
+        entries[key] = entry;
+        liveBytes += bytes;
+        if (liveBytes > peakBytes)
+            peakBytes = liveBytes;
+        return entry.id;
+    }
+
+    // a GL_TEXTURE_2D_ARRAY whose layers are copies of textures of the cache (same size, format & levels), which
+    // can be released then. It's shrunk by the budget unless a layer can't be loaded again (acquireImage())
+    unsigned int acquireArray(const std::vector<unsigned int>& layers)
+    {
+        std::vector<std::string> paths;
+        TextureDesc desc = entries[keys[layers[0]]].desc;
+        desc.target = GL_TEXTURE_2D_ARRAY;
+        bool generated = false;
+        for (unsigned int i = 0; i < layers.size(); i++)
+        {
+            const Entry& layer = entries[keys[layers[i]]];
+            paths.push_back(layer.paths[0]);
+            generated = generated || layer.generated;
+        }
+
+        std::string key = makeKey(paths, desc);
+        std::unordered_map<std::string, Entry>::iterator it = entries.find(key);
+        if (it != entries.end())
+        {
+            hits++;
+            it->second.references++;
+            return it->second.id;
+        }
+        misses++;
+
+        const Info& first = entries[keys[layers[0]]].info;
+        Entry entry;
+        glGenTextures(1, &entry.id);
+        entry.references = 1;
+        entry.paths = paths;
+        entry.desc = desc;
+        entry.lastUsed = frame;
+        entry.restoring = false;
+        entry.generated = generated;
+        entry.info = first;
+        entry.info.target = GL_TEXTURE_2D_ARRAY;
+        entry.info.bytes = TextureResidency::copyLayers(entry.id, layers, getInternalFormat(layers[0]), first.channels, first.levels);
+        glBindTexture(GL_TEXTURE_2D_ARRAY, entry.id);
+        setParameters(desc);
+        glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+        keys[entry.id] = key;
+        entries[key] = entry;
+        liveBytes += entry.info.bytes;
+        if (liveBytes > peakBytes)
+            peakBytes = liveBytes;
+        return entry.id;
+    }
+
+    // like acquire() but never waits for the file: the texture is a 1x1 grey placeholder until it's streamed
+    // (synchronous when streaming is off, only for 2D textures)
+    unsigned int acquireStreamed(const std::string& file, const TextureDesc& desc)
+    {
+        if (!streaming || desc.target != GL_TEXTURE_2D)
+            return acquire(file, desc);
+
+        std::vector<std::string> paths(1, normalizePath(file));
+        std::string key = makeKey(paths, desc);
+        std::unordered_map<std::string, Entry>::iterator it = entries.find(key);
+        if (it != entries.end())
+        {
+            hits++;
+            it->second.references++;
+            return it->second.id;
+        }
+        misses++;
+
+        Entry entry;
+        entry.id = createPlaceholder(desc);
+        entry.references = 1;
+        entry.paths = paths;
+        entry.desc = desc;
+        entry.lastUsed = frame;
+        entry.restoring = false;
+        entry.generated = false;
+        entry.info.target = desc.target;
+        entry.info.width = entry.info.height = 1;
+        entry.info.channels = 4;
+        entry.info.bytes = 0;
+        entry.info.resident = false;
+        entry.info.levels = 1;
+        entry.info.droppedLevels = 0;
+        keys[entry.id] = key;
+        entries[key] = entry;
+
+        TextureStreamer::Request request = { entry.id, paths[0], desc.channels, desc.flip, desc.mipmaps, desc.minFilter };
+        streamer.request(request);
+        return entry.id;
+    }
+
+    void setStreaming(bool _streaming)
+    {
+        streaming = _streaming;
+    }
+
+    bool isStreaming() const
+    {
+        return streaming;
+    }
+
+    // video memory for the textures of the cache (0: no limit)
+    void setBudget(size_t _budget)
+    {
+        budget = _budget;
+    }
+
+    size_t getBudget() const
+    {
+        return budget;
+    }
+
+    // the texture is bound for drawing (called for every bind, ignores the textures not from the cache)
+    void touch(unsigned int id)
+    {
+        std::unordered_map<unsigned int, std::string>::iterator key = keys.find(id);
+        if (key == keys.end())
+            return;
+        Entry& entry = entries[key->second];
+        entry.lastUsed = frame;
+        if (entry.info.droppedLevels > 0 && !entry.restoring)
+            restore(entry);
+    }
+
+    // once per frame: the streamed textures uploaded this frame become resident, then the budget is enforced
+    void update()
+    {
+        frame++;
+        if (streamer.getPending() > 0)
+        {
+            std::vector<TextureStreamer::Uploaded> uploaded = streamer.update();
+            bool loaded = false;
+            for (unsigned int i = 0; i < uploaded.size(); i++)
+            {
+                std::unordered_map<unsigned int, std::string>::iterator key = keys.find(uploaded[i].texture);
+                if (key == keys.end())
+                    continue;
+                Entry& entry = entries[key->second];
+                Info& info = entry.info;
+                loaded = loaded || !entry.restoring;
+                if (entry.restoring)
+                    restored++;
+                liveBytes = liveBytes - info.bytes + uploaded[i].bytes;
+                info.width = uploaded[i].width;
+                info.height = uploaded[i].height;
+                info.channels = uploaded[i].channels;
+                info.bytes = uploaded[i].bytes;
+                info.resident = true;
+                info.levels = uploaded[i].levels;
+                info.droppedLevels = 0;
+                entry.restoring = false;
+                if (liveBytes > peakBytes)
+                    peakBytes = liveBytes;
+            }
+            if (loaded && streamer.getPending() == 0)
+                printStats();
+        }
+        enforceBudget();
+    }
+
+    // stop the uploads in flight & free the streaming buffer (before the context is destroyed)
+    void stopStreaming()
+    {
+        streamer.shutdown();
+    }
+
+    void addReference(unsigned int id)
+    {
+        std::unordered_map<unsigned int, std::string>::iterator key = keys.find(id);
+        if (key != keys.end())
+            entries[key->second].references++;
+    }
+
+    // the GL texture is deleted with the last reference
+    void release(unsigned int id)
+    {
+        std::unordered_map<unsigned int, std::string>::iterator key = keys.find(id);
+        if (key == keys.end())
+            return;
+        Entry& entry = entries[key->second];
+        if (--entry.references > 0)
+            return;
+
+        if (!entry.info.resident || entry.restoring)
+            streamer.cancel(entry.id);
+        glDeleteTextures(1, &entry.id);
+        liveBytes -= entry.info.bytes;
+        entries.erase(key->second);
+        keys.erase(key);
+    }
+
+    // size & format of a texture of the cache (nullptr if it isn't one)
+    const Info* getInfo(unsigned int id) const
+    {
+        std::unordered_map<unsigned int, std::string>::const_iterator key = keys.find(id);
+        if (key == keys.end())
+            return nullptr;
+        return &entries.find(key->second)->second.info;
+    }
+
+    // decode the files in parallel (CPU only), the textures created from them later don't decode again
+    void prefetch(const std::vector<std::string>& files, int channels)
+    {
+        CPU_PROFILE_SCOPE("TextureCache::prefetch");
+        std::vector<std::string> paths;
+        std::vector<Image*> images;
+        for (unsigned int i = 0; i < files.size(); i++)
+        {
+            std::string path = normalizePath(files[i]);
+            std::string key = path + "|" + std::to_string(channels);
+            if (decoded.count(key) > 0 || DDSFile::isCooked(path))
+                continue;
+            // the map is only modified here, the workers fill their own image
+            paths.push_back(path);
+            images.push_back(&decoded[key]);
+        }
+        if (paths.empty())
+            return;
+
+        long long start = CpuProfiler::instance().now();
+        ThreadPool::instance().parallelFor(static_cast<unsigned int>(paths.size()), [&](unsigned int i) {
+            decodeFile(paths[i], channels, *images[i]);
+        });
+        std::cout << "TextureCache: " << paths.size() << " images decoded in " << (CpuProfiler::instance().now() - start) / 1000
+            << " ms on " << ThreadPool::instance().size() << " threads" << std::endl;
+    }
+
+    // free the decoded images, once the assets are loaded
+    void trimDecoded()
+    {
+        decoded.clear();
+    }
+
+    void printStats() const
+    {
+        std::cout << "Texture cache: " << entries.size() << " textures, " << hits << " hits, " << misses << " misses, "
+            << decodeHits << " decodes shared, " << liveBytes / 1024 << " KB (peak " << peakBytes / 1024 << " KB)";
+        if (budget > 0)
+            std::cout << ", budget " << budget / 1024 << " KB (" << dropped << " levels dropped, " << restored << " textures restored)";
+        if (streamer.getPending() > 0)
+            std::cout << ", " << streamer.getPending() << " still streaming";
+        std::cout << std::endl;
+    }
+
+    // "a\b/./c/../d.png" -> "a/b/d.png"
+    static std::string normalizePath(const std::string& path)
+    {
+        std::vector<std::string> parts;
+        std::string part;
+        for (size_t i = 0; i <= path.size(); i++)
+        {
+            if (i < path.size() && path[i] != '/' && path[i] != '\\')
+            {
+                part += path[i];
+                continue;
+            }
+            if (part == "..")
+            {
+                if (!parts.empty() && parts.back() != "..")
+                    parts.pop_back();
+                else
+                    parts.push_back(part);
+            }
+            else if (!part.empty() && part != ".")
+                parts.push_back(part);
+            part.clear();
+        }
+
+        std::string normalized = (!path.empty() && (path[0] == '/' || path[0] == '\\')) ? "/" : "";
+        for (unsigned int i = 0; i < parts.size(); i++)
+            normalized += (i > 0 ? "/" : "") + parts[i];
+        return normalized;
+    }
+
+private:
+    struct Entry
+    {
+        unsigned int id;
+        int references;
+        Info info;
+
+        std::vector<std::string> paths; // to load it again
+        TextureDesc desc;
+        unsigned int lastUsed;  // frame
+        bool restoring;         // streamed back at full resolution
+        bool generated;         // by acquireImage() (or an array of such layers), can't be loaded again
+    };
+
+    // an image as decoded by stb_image (never flipped)
+    struct Image
+    {
+        Image() : width(0), height(0), channels(0), used(false) {}
+
+        int width;
+        int height;
+        int channels;
+        std::vector<unsigned char> pixels;
+        bool used; // uploaded at least once (a prefetched image isn't yet)
+    };
+
+    TextureCache()
+        : streaming(false), budget(0), idleFrames(30), dropsPerFrame(4), minSize(64), frame(0),
+          hits(0), misses(0), decodeHits(0), liveBytes(0), peakBytes(0), dropped(0), restored(0) {}
+
+    // shrink the least recently used idle textures, a few per frame, until the budget is met
+    void enforceBudget()
+    {
+        if (budget == 0 || liveBytes <= budget)
+            return;
+        CPU_PROFILE_SCOPE("TextureCache::enforceBudget");
+        std::vector<Entry*> candidates;
+        for (std::unordered_map<std::string, Entry>::iterator it = entries.begin(); it != entries.end(); ++it)
+        {
+            Entry& entry = it->second;
+            if (entry.info.resident && !entry.restoring && !entry.generated && frame - entry.lastUsed > idleFrames)
+                candidates.push_back(&entry);
+        }
+        std::sort(candidates.begin(), candidates.end(), [](const Entry* a, const Entry* b) { return a->lastUsed < b->lastUsed; });
+
+        unsigned int drops = 0;
+        for (unsigned int i = 0; i < candidates.size() && liveBytes > budget && drops < dropsPerFrame; i++)
+        {
+            Info& info = candidates[i]->info;
+            size_t bytes = 0;
+            if (!TextureResidency::dropTopLevel(candidates[i]->id, info.target, info.channels, candidates[i]->paths[0], minSize, info.levels, bytes))
+                continue;
+            liveBytes = liveBytes - info.bytes + bytes;
+            info.bytes = bytes;
+            info.width = std::max(info.width / 2, 1);
+            info.height = std::max(info.height / 2, 1);
+            info.droppedLevels++;
+            dropped++;
+            drops++;
+        }
+    }
+
+    // back to full resolution: streamed for 2D textures, loaded at once for cubemaps & arrays (the streamer only does 2D)
+    void restore(Entry& entry)
+    {
+        if (entry.info.target == GL_TEXTURE_2D_ARRAY)
+        {
+            restoreArray(entry);
+            return;
+        }
+        if (entry.info.target == GL_TEXTURE_2D)
+        {
+            TextureStreamer::Request request = { entry.id, entry.paths[0], entry.desc.channels, entry.desc.flip, entry.desc.mipmaps, entry.desc.minFilter };
+            streamer.request(request);
+            entry.restoring = true;
+            return;
+        }
+        size_t bytes = entry.info.bytes;
+        fill(entry.id, entry.paths, entry.desc, entry.info);
+        decoded.clear();
+        liveBytes = liveBytes - bytes + entry.info.bytes;
+        restored++;
+    }
+
+    // the layers are loaded again as 2D textures (entries kept by the cache are shared) and copied into the array
+    void restoreArray(Entry& entry)
+    {
+        TextureDesc layerDesc = entry.desc;
+        layerDesc.target = GL_TEXTURE_2D;
+        std::vector<unsigned int> layers;
+        for (unsigned int i = 0; i < entry.paths.size(); i++)
+            layers.push_back(acquire(entry.paths[i], layerDesc));
+
+        // the references to the entries stay valid while the map grows
+        const Info& first = entries[keys[layers[0]]].info;
+        bool complete = true;
+        for (unsigned int i = 0; i < layers.size() && complete; i++)
+        {
+            const Info& info = entries[keys[layers[i]]].info;
+            complete = info.resident && info.droppedLevels == 0 && info.width == first.width && info.height == first.height &&
+                info.channels == first.channels && info.levels == first.levels;
+        }
+        if (complete)
+        {
+            size_t bytes = TextureResidency::copyLayers(entry.id, layers, getInternalFormat(layers[0]), first.channels, first.levels);
+            liveBytes = liveBytes - entry.info.bytes + bytes;
+            entry.info.bytes = bytes;
+            entry.info.width = first.width;
+            entry.info.height = first.height;
+            entry.info.levels = first.levels;
+            entry.info.droppedLevels = 0;
+            restored++;
+        }
+        else
+        {
+            // a layer has changed (or is missing): the array keeps its size and isn't shrunk any more
+            std::cout << "TextureCache: can't restore the array of " << entry.paths[0] << ", its layers don't match" << std::endl;
+            entry.generated = true;
+        }
+        for (unsigned int i = 0; i < layers.size(); i++)
+            release(layers[i]);
+        decoded.clear();
+    }
+
+    static GLint getInternalFormat(unsigned int texture)
+    {
+        GLint internalFormat = 0;
+        glBindTexture(GL_TEXTURE_2D, texture);
+        glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_INTERNAL_FORMAT, &internalFormat);
+        glBindTexture(GL_TEXTURE_2D, 0);
+        return internalFormat;
+    }
+
+    static std::string makeKey(const std::vector<std::string>& paths, const TextureDesc& desc)
+    {
+        std::string key;
+        for (unsigned int i = 0; i < paths.size(); i++)
+            key += paths[i] + "|";
+        key += std::to_string(desc.target) + "," + std::to_string(desc.channels) + "," + std::to_string(desc.flip) + "," +
+            std::to_string(desc.mipmaps) + "," + std::to_string(desc.wrap) + "," + std::to_string(desc.minFilter) + "," + std::to_string(desc.magFilter);
+        return key;
+    }
+
+    const Image& decode(const std::string& path, int channels)
+    {
+        std::string key = path + "|" + std::to_string(channels);
+        std::unordered_map<std::string, Image>::iterator it = decoded.find(key);
+        if (it != decoded.end())
+        {
+            if (it->second.used)
+                decodeHits++;
+            it->second.used = true;
+            return it->second;
+        }
+
+        Image& image = decoded[key];
+        decodeFile(path, channels, image); // flipped when uploading, the same decode serves both orientations
+        image.used = true;
+        return image;
+    }
+
+    // thread safe: the flip flag of stb_image is only cleared for the calling thread, the global one isn't touched
+    static void decodeFile(const std::string& path, int channels, Image& image)
+    {
+        CPU_PROFILE_SCOPE("TextureCache::decode");
+        int fileChannels = 0;
+        stbi_set_flip_vertically_on_load_thread(false);
+        unsigned char* data = stbi_load(path.c_str(), &image.width, &image.height, &fileChannels, channels);
+        if (!data)
+        {
+            std::cout << "Texture failed to load at path: " << path << std::endl;
+            image.width = image.height = image.channels = 0;
+            return;
+        }
+        image.channels = channels != 0 ? channels : fileChannels;
+        image.pixels.assign(data, data + static_cast<size_t>(image.width) * image.height * image.channels);
+        stbi_image_free(data);
+    }
+
+    unsigned int create(const std::vector<std::string>& paths, const TextureDesc& desc, Info& info)
+    {
+        unsigned int id;
+        glGenTextures(1, &id);
+        fill(id, paths, desc, info);
+        return id;
+    }
+
+    // (re)specify the images of the texture
+    void fill(unsigned int id, const std::vector<std::string>& paths, const TextureDesc& desc, Info& info)
+    {
+        info.target = desc.target;
+        info.width = info.height = info.channels = 0;
+        info.bytes = 0;
+        info.resident = true;
+        info.levels = 1;
+        info.droppedLevels = 0;
+
+        glBindTexture(desc.target, id);
+        // the cooked files are used if every image has one
+        std::vector<DDSFile::Image> cooked(paths.size());
+        bool useCooked = true;
+        for (unsigned int i = 0; i < paths.size() && useCooked; i++)
+            useCooked = DDSFile::loadCooked(paths[i], desc.flip, cooked[i]);
+        if (useCooked)
+        {
+            createCompressed(cooked, desc, info);
+            glBindTexture(desc.target, 0);
+            return;
+        }
+
+        // the rows of RGB images with an odd width aren't 4-byte aligned
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+
+        std::vector<unsigned char> flipped, mipPixels;
+        for (unsigned int i = 0; i < paths.size(); i++)
+        {
+            const Image& image = decode(paths[i], desc.channels);
+            if (image.pixels.empty())
+                continue;
+
+            const unsigned char* pixels = image.pixels.data();
+            if (desc.flip)
+            {
+                size_t rowSize = static_cast<size_t>(image.width) * image.channels;
+                flipped.resize(image.pixels.size());
+                for (int y = 0; y < image.height; y++)
+                    std::memcpy(&flipped[y * rowSize], &image.pixels[(image.height - 1 - y) * rowSize], rowSize);
+                pixels = flipped.data();
+            }
+
+            GLenum format = getFormat(image.channels);
+            GLenum target = desc.target == GL_TEXTURE_CUBE_MAP ? GL_TEXTURE_CUBE_MAP_POSITIVE_X + i : desc.target;
+            if (desc.mipmaps)
+            {
+                // built on the CPU (sRGB correct, unlike glGenerateMipmap on these linear formats)
+                std::vector<MipGenerator::Level> mips = MipGenerator::generate(pixels, image.width, image.height, image.channels,
+                    MipGenerator::getOptions(paths[i], image.channels, pixels, image.width * image.height), mipPixels);
+                for (unsigned int l = 0; l < mips.size(); l++)
+                    glTexImage2D(target, l, format, mips[l].width, mips[l].height, 0, format, GL_UNSIGNED_BYTE, &mipPixels[mips[l].offset]);
+                glTexParameteri(desc.target, GL_TEXTURE_MAX_LEVEL, static_cast<GLint>(mips.size()) - 1);
+                info.bytes += mipPixels.size();
+                info.levels = static_cast<int>(mips.size());
+            }
+            else
+            {
+                glTexImage2D(target, 0, format, image.width, image.height, 0, format, GL_UNSIGNED_BYTE, pixels);
+                info.bytes += image.pixels.size();
+            }
+
+            info.width = image.width;
+            info.height = image.height;
+            info.channels = image.channels;
+        }
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+        setParameters(desc);
+        glBindTexture(desc.target, 0);
+    }
+
+    // upload the cooked levels (all of them with mipmaps, only the first one otherwise) to the bound texture
+    static void createCompressed(const std::vector<DDSFile::Image>& images, const TextureDesc& desc, Info& info)
+    {
+        unsigned int numLevels = desc.mipmaps ? static_cast<unsigned int>(images[0].levels.size()) : 1;
+        for (unsigned int i = 0; i < images.size(); i++)
+        {
+            GLenum target = desc.target == GL_TEXTURE_CUBE_MAP ? GL_TEXTURE_CUBE_MAP_POSITIVE_X + i : desc.target;
+            for (unsigned int l = 0; l < numLevels && l < images[i].levels.size(); l++)
+            {
+                const DDSFile::Level& level = images[i].levels[l];
+                glCompressedTexImage2D(target, l, images[i].format, level.width, level.height, 0, static_cast<GLsizei>(level.size), &images[i].data[level.offset]);
+                info.bytes += level.size;
+            }
+        }
+        glTexParameteri(desc.target, GL_TEXTURE_MAX_LEVEL, numLevels - 1);
+        info.levels = static_cast<int>(numLevels);
+        info.width = images[0].levels[0].width;
+        info.height = images[0].levels[0].height;
+        info.channels = images[0].format == GL_COMPRESSED_RG_RGTC2 ? 2 : images[0].format == GL_COMPRESSED_RGB_S3TC_DXT1_EXT ? 3 : 4;
+        setParameters(desc);
+    }
+
+    static void setParameters(const TextureDesc& desc)
+    {
+        glTexParameteri(desc.target, GL_TEXTURE_WRAP_S, desc.wrap);
+        glTexParameteri(desc.target, GL_TEXTURE_WRAP_T, desc.wrap);
+        if (desc.target == GL_TEXTURE_CUBE_MAP)
+            glTexParameteri(desc.target, GL_TEXTURE_WRAP_R, desc.wrap);
+        glTexParameteri(desc.target, GL_TEXTURE_MIN_FILTER, desc.minFilter);
+        glTexParameteri(desc.target, GL_TEXTURE_MAG_FILTER, desc.magFilter);
+    }
+
+    // mid grey, with the sampling parameters of the texture it stands for
+    static unsigned int createPlaceholder(const TextureDesc& desc)
+    {
+        const unsigned char grey[4] = { 128, 128, 128, 255 };
+        unsigned int id;
+        glGenTextures(1, &id);
+        glBindTexture(GL_TEXTURE_2D, id);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, 1, 1, 0, GL_RGBA, GL_UNSIGNED_BYTE, grey);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, desc.wrap);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, desc.wrap);
+        // no mip chain yet
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, desc.mipmaps ? GL_LINEAR : desc.minFilter);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, desc.magFilter);
+        glBindTexture(GL_TEXTURE_2D, 0);
+        return id;
+    }
+
+    static GLenum getFormat(int channels)
+    {
+        switch (channels)
+        {
+        case 1: return GL_RED;
+        case 2: return GL_RG;
+        case 3: return GL_RGB;
+        default: return GL_RGBA;
+        }
+    }
+
+    std::unordered_map<std::string, Entry> entries;  // key (paths + desc) -> texture
+    std::unordered_map<unsigned int, std::string> keys;  // GL texture -> key
+    std::unordered_map<std::string, Image> decoded;
+
+    bool streaming;
+    TextureStreamer streamer;
+
+    size_t budget;
+    unsigned int idleFrames;    // a texture drawn more recently is never shrunk
+    unsigned int dropsPerFrame;
+    int minSize;                // the budget doesn't shrink a texture below this (pixels)
+    unsigned int frame;
+
+    unsigned int hits;
+    unsigned int misses;
+    unsigned int decodeHits;
+    size_t liveBytes;
+    size_t peakBytes;
+    unsigned int dropped;
+    unsigned int restored;
+};
+
+#endif
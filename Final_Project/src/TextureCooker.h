@@ -0,0 +1,343 @@
+#ifndef TEXTURE_COOKER_H
+#define TEXTURE_COOKER_H
+
+#include <stbi_image.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <dirent.h>
+#endif
+
+#include "DDSFile.h"
+#include "MipGenerator.h"
+#include "ThreadPool.h"
+
+// Offline conversion of the PNG/JPG images into block-compressed DDS files with their mip chain (--cook)
+// The format depends on the image:
+//   normal maps (*_ddn.*, *_normal.*): BC5, only X & Y are kept: a shader sampling them has to rebuild
+//                                      Z = sqrt(1 - X^2 - Y^2) (none of the current shaders samples texture_normal)
+//   images with transparent pixels:    BC3
+//   the others (the skyboxes too):     BC1
+// The encoders fit the endpoints of each 4x4 block along its principal axis (no exhaustive search):
+// fast enough to cook everything at once, with a quality close to the usual offline compressors.
+namespace TextureCooker
+{
+    struct Stats
+    {
+        unsigned int cooked;
+        unsigned int skipped;
+        size_t sourceBytes; // RGBA8 with mips, what the GPU stored before
+        size_t cookedBytes;
+    };
+
+    inline unsigned short packRGB565(const float color[3])
+    {
+        int r = static_cast<int>(std::min(std::max(color[0], 0.0f), 255.0f) * 31.0f / 255.0f + 0.5f);
+        int g = static_cast<int>(std::min(std::max(color[1], 0.0f), 255.0f) * 63.0f / 255.0f + 0.5f);
+        int b = static_cast<int>(std::min(std::max(color[2], 0.0f), 255.0f) * 31.0f / 255.0f + 0.5f);
+        return static_cast<unsigned short>((r << 11) | (g << 5) | b);
+    }
+
+    inline void unpackRGB565(unsigned short packed, int color[3])
+    {
+        int r = (packed >> 11) & 31, g = (packed >> 5) & 63, b = packed & 31;
+        color[0] = (r << 3) | (r >> 2);
+        color[1] = (g << 2) | (g >> 4);
+        color[2] = (b << 3) | (b >> 2);
+    }
+
+    // BC1 (4 color mode): the endpoints are the extremes of the colors along their principal axis
+    inline void encodeColorBlock(const unsigned char block[16 * 4], unsigned char out[8])
+    {
+        float mean[3] = { 0.0f, 0.0f, 0.0f };
+        for (int i = 0; i < 16; i++)
+            for (int c = 0; c < 3; c++)
+                mean[c] += block[i * 4 + c] / 16.0f;
+
+        float covariance[6] = { 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f }; // rr rg rb gg gb bb
+        for (int i = 0; i < 16; i++)
+        {
+            float r = block[i * 4] - mean[0], g = block[i * 4 + 1] - mean[1], b = block[i * 4 + 2] - mean[2];
+            covariance[0] += r * r; covariance[1] += r * g; covariance[2] += r * b;
+            covariance[3] += g * g; covariance[4] += g * b; covariance[5] += b * b;
+        }
+        // power iteration
+        float axis[3] = { 1.0f, 1.0f, 1.0f };
+        for (int iteration = 0; iteration < 8; iteration++)
+        {
+            float next[3] = {
+                covariance[0] * axis[0] + covariance[1] * axis[1] + covariance[2] * axis[2],
+                covariance[1] * axis[0] + covariance[3] * axis[1] + covariance[4] * axis[2],
+                covariance[2] * axis[0] + covariance[4] * axis[1] + covariance[5] * axis[2] };
+            float length = std::max(std::max(std::fabs(next[0]), std::fabs(next[1])), std::fabs(next[2]));
+            if (length < 1e-6f)
+                break;
+            for (int c = 0; c < 3; c++)
+                axis[c] = next[c] / length;
+        }
+
+        float minProjection = 1e30f, maxProjection = -1e30f;
+        for (int i = 0; i < 16; i++)
+        {
+            float projection = (block[i * 4] - mean[0]) * axis[0] + (block[i * 4 + 1] - mean[1]) * axis[1] + (block[i * 4 + 2] - mean[2]) * axis[2];
+            minProjection = std::min(minProjection, projection);
+            maxProjection = std::max(maxProjection, projection);
+        }
+        float axisLength2 = axis[0] * axis[0] + axis[1] * axis[1] + axis[2] * axis[2];
+        float endpoint0[3], endpoint1[3];
+        for (int c = 0; c < 3; c++)
+        {
+            endpoint0[c] = mean[c] + axis[c] * maxProjection / std::max(axisLength2, 1e-6f);
+            endpoint1[c] = mean[c] + axis[c] * minProjection / std::max(axisLength2, 1e-6f);
+        }
+
+        unsigned short color0 = packRGB565(endpoint0);
+        unsigned short color1 = packRGB565(endpoint1);
+        if (color0 < color1)
+            std::swap(color0, color1);
+        unsigned int indices = 0;
+        if (color0 != color1)
+        {
+            int palette[4][3];
+            unpackRGB565(color0, palette[0]);
+            unpackRGB565(color1, palette[1]);
+            for (int c = 0; c < 3; c++)
+            {
+                palette[2][c] = (2 * palette[0][c] + palette[1][c]) / 3;
+                palette[3][c] = (palette[0][c] + 2 * palette[1][c]) / 3;
+            }
+            for (int i = 0; i < 16; i++)
+            {
+                int best = 0, bestError = 1 << 30;
+                for (int p = 0; p < 4; p++)
+                {
+                    int dr = block[i * 4] - palette[p][0], dg = block[i * 4 + 1] - palette[p][1], db = block[i * 4 + 2] - palette[p][2];
+                    int error = dr * dr + dg * dg + db * db;
+                    if (error < bestError)
+                    {
+                        bestError = error;
+                        best = p;
+                    }
+                }
+                indices |= static_cast<unsigned int>(best) << (2 * i);
+            }
+        }
+        out[0] = color0 & 0xFF; out[1] = color0 >> 8;
+        out[2] = color1 & 0xFF; out[3] = color1 >> 8;
+        for (int i = 0; i < 4; i++)
+            out[4 + i] = (indices >> (8 * i)) & 0xFF;
+    }
+
+    // BC4 (8 value mode) of one channel of the block
+    inline void encodeValueBlock(const unsigned char block[16 * 4], int channel, unsigned char out[8])
+    {
+        int minValue = 255, maxValue = 0;
+        for (int i = 0; i < 16; i++)
+        {
+            minValue = std::min(minValue, static_cast<int>(block[i * 4 + channel]));
+            maxValue = std::max(maxValue, static_cast<int>(block[i * 4 + channel]));
+        }
+        out[0] = static_cast<unsigned char>(maxValue);
+        out[1] = static_cast<unsigned char>(minValue);
+        unsigned long long indices = 0;
+        if (maxValue != minValue)
+        {
+            int palette[8] = { maxValue, minValue };
+            for (int p = 2; p < 8; p++)
+                palette[p] = ((8 - p) * maxValue + (p - 1) * minValue) / 7;
+            for (int i = 0; i < 16; i++)
+            {
+                int best = 0, bestError = 1 << 30;
+                for (int p = 0; p < 8; p++)
+                {
+                    int error = std::abs(block[i * 4 + channel] - palette[p]);
+                    if (error < bestError)
+                    {
+                        bestError = error;
+                        best = p;
+                    }
+                }
+                indices |= static_cast<unsigned long long>(best) << (3 * i);
+            }
+        }
+        for (int i = 0; i < 6; i++)
+            out[2 + i] = (indices >> (8 * i)) & 0xFF;
+    }
+
+    inline void encodeLevel(const unsigned char* pixels, int width, int height, GLenum format, unsigned char* out)
+    {
+        int blockSize = DDSFile::getBlockSize(format);
+        unsigned char block[16 * 4];
+        for (int by = 0; by < (height + 3) / 4; by++)
+        {
+            for (int bx = 0; bx < (width + 3) / 4; bx++)
+            {
+                // the blocks over the border repeat the last row / column
+                for (int y = 0; y < 4; y++)
+                    for (int x = 0; x < 4; x++)
+                        std::memcpy(&block[(y * 4 + x) * 4], &pixels[(std::min(by * 4 + y, height - 1) * width + std::min(bx * 4 + x, width - 1)) * 4], 4);
+
+                if (format == GL_COMPRESSED_RGB_S3TC_DXT1_EXT)
+                    encodeColorBlock(block, out);
+                else if (format == GL_COMPRESSED_RGBA_S3TC_DXT5_EXT)
+                {
+                    encodeValueBlock(block, 3, out);
+                    encodeColorBlock(block, out + 8);
+                }
+                else
+                {
+                    encodeValueBlock(block, 0, out);
+                    encodeValueBlock(block, 1, out + 8);
+                }
+                out += blockSize;
+            }
+        }
+    }
+
+    inline GLenum chooseFormat(const std::string& path, const unsigned char* pixels, int width, int height)
+    {
+        std::string name = path.substr(path.find_last_of("/\\") + 1);
+        if (name.find("_ddn") != std::string::npos || name.find("_normal") != std::string::npos)
+            return GL_COMPRESSED_RG_RGTC2;
+        if (MipGenerator::hasTranslucentAlpha(pixels, width * height))
+            return GL_COMPRESSED_RGBA_S3TC_DXT5_EXT;
+        return GL_COMPRESSED_RGB_S3TC_DXT1_EXT;
+    }
+
+    // source -> source.dds (e.g. a.png.dds), returns the size of the DDS data (0 on failure)
+    // (called by the workers: the stb_image flip flag is only cleared for the calling thread)
+    inline size_t cookFile(const std::string& path, size_t& sourceBytes)
+    {
+        int width, height, channels;
+        stbi_set_flip_vertically_on_load_thread(false);
+        unsigned char* pixels = stbi_load(path.c_str(), &width, &height, &channels, 4);
+        if (!pixels)
+        {
+            std::cout << "TextureCooker: can't read " << path << std::endl;
+            return 0;
+        }
+
+        DDSFile::Image image;
+        image.format = chooseFormat(path, pixels, width, height);
+        std::vector<unsigned char> mipPixels;
+        std::vector<MipGenerator::Level> mips = MipGenerator::generate(pixels, width, height, 4, MipGenerator::getOptions(path, 4, pixels, width * height), mipPixels);
+        stbi_image_free(pixels);
+
+        sourceBytes = mipPixels.size();
+        for (unsigned int l = 0; l < mips.size(); l++)
+        {
+            DDSFile::Level level = { mips[l].width, mips[l].height, image.data.size(), DDSFile::getLevelSize(image.format, mips[l].width, mips[l].height) };
+            image.levels.push_back(level);
+            image.data.resize(image.data.size() + level.size);
+            encodeLevel(&mipPixels[mips[l].offset], mips[l].width, mips[l].height, image.format, &image.data[level.offset]);
+        }
+        if (!DDSFile::write(DDSFile::getCookedPath(path), image))
+            return 0;
+        return image.data.size();
+    }
+
+    inline bool isImage(const std::string& name)
+    {
+        size_t dot = name.find_last_of('.');
+        if (dot == std::string::npos)
+            return false;
+        std::string extension = name.substr(dot + 1);
+        std::transform(extension.begin(), extension.end(), extension.begin(), ::tolower);
+        return extension == "png" || extension == "jpg" || extension == "jpeg" || extension == "tga" || extension == "bmp";
+    }
+
+    // every file under directory (recursively) whose name is accepted
+    inline void findFiles(const std::string& directory, bool (*accept)(const std::string&), std::vector<std::string>& files)
+    {
+#ifdef _WIN32
+        WIN32_FIND_DATAA data;
+        HANDLE find = FindFirstFileA((directory + "/*").c_str(), &data);
+        if (find == INVALID_HANDLE_VALUE)
+            return;
+        do
+        {
+            std::string name(data.cFileName);
+            if (name == "." || name == "..")
+                continue;
+            if (data.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY)
+                findFiles(directory + "/" + name, accept, files);
+            else if (accept(name))
+                files.push_back(directory + "/" + name);
+        } while (FindNextFileA(find, &data));
+        FindClose(find);
+#else
+        DIR* dir = opendir(directory.c_str());
+        if (dir == NULL)
+            return;
+        while (struct dirent* entry = readdir(dir))
+        {
+            std::string name(entry->d_name);
+            if (name == "." || name == "..")
+                continue;
+            std::string path = directory + "/" + name;
+            struct stat status;
+            if (stat(path.c_str(), &status) != 0)
+                continue;
+            if (S_ISDIR(status.st_mode))
+                findFiles(path, accept, files);
+            else if (accept(name))
+                files.push_back(path);
+        }
+        closedir(dir);
+#endif
+    }
+
+    inline void findImages(const std::string& directory, std::vector<std::string>& images)
+    {
+        findFiles(directory, isImage, images);
+    }
+
+    // cook the images of the directories which changed since they were cooked (all of them with force)
+    inline Stats cookDirectories(const std::vector<std::string>& directories, bool force)
+    {
+        std::vector<std::string> images;
+        for (unsigned int i = 0; i < directories.size(); i++)
+            findImages(directories[i], images);
+
+        Stats stats = { 0, 0, 0, 0 };
+        std::vector<std::string> toCook;
+        for (unsigned int i = 0; i < images.size(); i++)
+        {
+            if (!force && DDSFile::isCooked(images[i]))
+                stats.skipped++;
+            else
+                toCook.push_back(images[i]);
+        }
+
+        std::vector<size_t> sourceBytes(toCook.size(), 0), cookedBytes(toCook.size(), 0);
+        ThreadPool::instance().parallelFor(static_cast<unsigned int>(toCook.size()), [&](unsigned int i) {
+            cookedBytes[i] = cookFile(toCook[i], sourceBytes[i]);
+        });
+        for (unsigned int i = 0; i < toCook.size(); i++)
+        {
+            if (cookedBytes[i] == 0)
+                continue;
+            stats.cooked++;
+            stats.sourceBytes += sourceBytes[i];
+            stats.cookedBytes += cookedBytes[i];
+            std::cout << "  " << DDSFile::getCookedPath(toCook[i]) << " (" << sourceBytes[i] / 1024 << " KB -> " << cookedBytes[i] / 1024 << " KB)" << std::endl;
+        }
+        std::cout << "TextureCooker: " << stats.cooked << " cooked, " << stats.skipped << " up to date, "
+            << stats.sourceBytes / 1024 << " KB -> " << stats.cookedBytes / 1024 << " KB" << std::endl;
+        return stats;
+    }
+}
+
+#endif
@@ -0,0 +1,196 @@
+#ifndef TEXTURE_RESIDENCY_H
+#define TEXTURE_RESIDENCY_H
+
+#include <glad/glad.h>
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include "MipGenerator.h"
+
+// Shrinking of the textures evicted by the TextureCache (see TextureCache::setBudget)
+// The top level of a texture is dropped without going back to the files: its other levels are read back and
+// uploaded one level lower (level 1 becomes level 0...). A texture without mip chain is halved on the CPU instead.
+// Reading back waits for the GPU to be done with the texture: only idle textures are shrunk, a few per frame.
+// A GL_TEXTURE_2D_ARRAY (see MaterialArrays) is shrunk the same way, all of its layers at once.
+namespace TextureResidency
+{
+    struct Level
+    {
+        int width;
+        int height;
+        int depth; // layers of a GL_TEXTURE_2D_ARRAY level (1 otherwise)
+        GLint internalFormat;
+        bool compressed;
+        std::vector<unsigned char> data;
+    };
+
+    inline GLenum getFormat(int channels)
+    {
+        return channels == 1 ? GL_RED : channels == 2 ? GL_RG : channels == 3 ? GL_RGB : GL_RGBA;
+    }
+
+    // face: GL_TEXTURE_2D, GL_TEXTURE_2D_ARRAY (every layer) or one face of the bound cubemap
+    inline void readLevel(GLenum face, int level, int channels, Level& out)
+    {
+        GLint compressed = 0;
+        glGetTexLevelParameteriv(face, level, GL_TEXTURE_WIDTH, &out.width);
+        glGetTexLevelParameteriv(face, level, GL_TEXTURE_HEIGHT, &out.height);
+        out.depth = 1;
+        if (face == GL_TEXTURE_2D_ARRAY)
+            glGetTexLevelParameteriv(face, level, GL_TEXTURE_DEPTH, &out.depth);
+        glGetTexLevelParameteriv(face, level, GL_TEXTURE_INTERNAL_FORMAT, &out.internalFormat);
+        glGetTexLevelParameteriv(face, level, GL_TEXTURE_COMPRESSED, &compressed);
+        out.compressed = compressed != 0;
+        if (out.compressed)
+        {
+            GLint size = 0;
+            glGetTexLevelParameteriv(face, level, GL_TEXTURE_COMPRESSED_IMAGE_SIZE, &size);
+            out.data.resize(size);
+            glGetCompressedTexImage(face, level, out.data.data());
+            return;
+        }
+        out.data.resize(static_cast<size_t>(out.width) * out.height * out.depth * channels);
+        glPixelStorei(GL_PACK_ALIGNMENT, 1);
+        glGetTexImage(face, level, getFormat(channels), GL_UNSIGNED_BYTE, out.data.data());
+        glPixelStorei(GL_PACK_ALIGNMENT, 4);
+    }
+
+    inline void writeLevel(GLenum face, int level, int channels, const Level& in)
+    {
+        if (face == GL_TEXTURE_2D_ARRAY)
+        {
+            if (in.compressed)
+                glCompressedTexImage3D(face, level, in.internalFormat, in.width, in.height, in.depth, 0, static_cast<GLsizei>(in.data.size()), in.data.data());
+            else
+            {
+                glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+                glTexImage3D(face, level, in.internalFormat, in.width, in.height, in.depth, 0, getFormat(channels), GL_UNSIGNED_BYTE, in.data.data());
+                glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+            }
+            return;
+        }
+        if (in.compressed)
+        {
+            glCompressedTexImage2D(face, level, in.internalFormat, in.width, in.height, 0, static_cast<GLsizei>(in.data.size()), in.data.data());
+            return;
+        }
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+        glTexImage2D(face, level, in.internalFormat, in.width, in.height, 0, getFormat(channels), GL_UNSIGNED_BYTE, in.data.data());
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    }
+
+    // halve the texture: levels (on the GPU) is updated, bytes is its new size in video memory
+    // false if it can't shrink: smaller than minSize, or without mip chain and block-compressed or an array
+    inline bool dropTopLevel(unsigned int texture, GLenum target, int channels, const std::string& path, int minSize, int& levels, size_t& bytes)
+    {
+        int faces = target == GL_TEXTURE_CUBE_MAP ? 6 : 1;
+        GLenum firstFace = target == GL_TEXTURE_CUBE_MAP ? GL_TEXTURE_CUBE_MAP_POSITIVE_X : target;
+        glBindTexture(target, texture);
+
+        GLint width = 0, height = 0, compressed = 0;
+        glGetTexLevelParameteriv(firstFace, 0, GL_TEXTURE_WIDTH, &width);
+        glGetTexLevelParameteriv(firstFace, 0, GL_TEXTURE_HEIGHT, &height);
+        glGetTexLevelParameteriv(firstFace, 0, GL_TEXTURE_COMPRESSED, &compressed);
+        if (std::max(width, height) / 2 < minSize || (levels == 1 && (compressed || target == GL_TEXTURE_2D_ARRAY)))
+        {
+            glBindTexture(target, 0);
+            return false;
+        }
+
+        bytes = 0;
+        std::vector<Level> kept;
+        for (int f = 0; f < faces; f++)
+        {
+            GLenum face = firstFace + f;
+            if (levels > 1)
+            {
+                kept.resize(levels - 1);
+                for (int l = 1; l < levels; l++)
+                    readLevel(face, l, channels, kept[l - 1]);
+            }
+            else
+            {
+                Level top;
+                readLevel(face, 0, channels, top);
+                kept.resize(1);
+                kept[0].depth = 1;
+                kept[0].internalFormat = top.internalFormat;
+                kept[0].compressed = false;
+                MipGenerator::downsample(top.data.data(), top.width, top.height, channels, MipGenerator::getOptions(path, channels),
+                    kept[0].data, kept[0].width, kept[0].height);
+            }
+            for (unsigned int l = 0; l < kept.size(); l++)
+            {
+                writeLevel(face, l, channels, kept[l]);
+                bytes += kept[l].data.size();
+            }
+        }
+        levels = static_cast<int>(kept.size());
+        // the old last level is still allocated but out of range (1x1)
+        glTexParameteri(target, GL_TEXTURE_MAX_LEVEL, levels - 1);
+        glBindTexture(target, 0);
+        return true;
+    }
+
+    // (re)allocate every level of the GL_TEXTURE_2D_ARRAY and copy the 2D textures (same size, format & levels)
+    // into its layers, returns its size in video memory
+    // The layers are copied on the GPU (glCopyImageSubData, GL 4.3), or read back and uploaded again before 4.3.
+    inline size_t copyLayers(unsigned int array, const std::vector<unsigned int>& textures, GLint internalFormat, int channels, int levels)
+    {
+        GLsizei layers = static_cast<GLsizei>(textures.size());
+        size_t bytes = 0;
+        for (int l = 0; l < levels; l++)
+        {
+            // undefined content, the size of one layer of the level
+            GLint width = 0, height = 0, compressed = 0, size = 0;
+            glBindTexture(GL_TEXTURE_2D, textures[0]);
+            glGetTexLevelParameteriv(GL_TEXTURE_2D, l, GL_TEXTURE_WIDTH, &width);
+            glGetTexLevelParameteriv(GL_TEXTURE_2D, l, GL_TEXTURE_HEIGHT, &height);
+            glGetTexLevelParameteriv(GL_TEXTURE_2D, l, GL_TEXTURE_COMPRESSED, &compressed);
+            if (compressed)
+                glGetTexLevelParameteriv(GL_TEXTURE_2D, l, GL_TEXTURE_COMPRESSED_IMAGE_SIZE, &size);
+            glBindTexture(GL_TEXTURE_2D_ARRAY, array);
+            if (compressed)
+            {
+                glCompressedTexImage3D(GL_TEXTURE_2D_ARRAY, l, internalFormat, width, height, layers, 0, size * layers, NULL);
+                bytes += static_cast<size_t>(size) * layers;
+            }
+            else
+            {
+                glTexImage3D(GL_TEXTURE_2D_ARRAY, l, internalFormat, width, height, layers, 0, getFormat(channels), GL_UNSIGNED_BYTE, NULL);
+                bytes += static_cast<size_t>(width) * height * channels * layers;
+            }
+
+            for (GLsizei t = 0; t < layers; t++)
+            {
+                if (GLAD_GL_VERSION_4_3)
+                {
+                    glCopyImageSubData(textures[t], GL_TEXTURE_2D, l, 0, 0, 0, array, GL_TEXTURE_2D_ARRAY, l, 0, 0, t, width, height, 1);
+                    continue;
+                }
+                Level level;
+                glBindTexture(GL_TEXTURE_2D, textures[t]);
+                readLevel(GL_TEXTURE_2D, l, channels, level);
+                glBindTexture(GL_TEXTURE_2D_ARRAY, array);
+                if (level.compressed)
+                    glCompressedTexSubImage3D(GL_TEXTURE_2D_ARRAY, l, 0, 0, t, level.width, level.height, 1, internalFormat,
+                        static_cast<GLsizei>(level.data.size()), level.data.data());
+                else
+                {
+                    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+                    glTexSubImage3D(GL_TEXTURE_2D_ARRAY, l, 0, 0, t, level.width, level.height, 1, getFormat(channels), GL_UNSIGNED_BYTE, level.data.data());
+                    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+                }
+            }
+        }
+        glBindTexture(GL_TEXTURE_2D, 0);
+        glBindTexture(GL_TEXTURE_2D_ARRAY, array);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAX_LEVEL, levels - 1);
+        glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+        return bytes;
+    }
+}
+
+#endif
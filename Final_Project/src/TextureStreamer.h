@@ -0,0 +1,450 @@
+#ifndef TEXTURE_STREAMER_H
+#define TEXTURE_STREAMER_H
+
+#include <glad/glad.h>
+
+#include <stbi_image.h>
+
+#include <chrono>
+#include <cstring>
+#include <future>
+#include <iostream>
+#include <list>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "GLExtensions.h"
+#include "DDSFile.h"
+#include "MipGenerator.h"
+#include "ThreadPool.h"
+#include "CpuProfiler.h"
+
+// Asynchronous texture uploads through a ring of pixel buffer objects
+// request() returns at once, the texture keeps its placeholder until update() has uploaded the image:
+//   1. a worker decodes the file, flips it and builds its mip chain (MipGenerator)
+//   2. the main thread allocates the image in the ring buffer (at most bytesPerFrame per frame), then a worker
+//      copies the levels into it: the buffer is persistently mapped (ARB_buffer_storage)
+//   3. the main thread uploads from the buffer (glTexImage2D reads the PBO, no copy from client memory)
+//      and puts a fence after it: that part of the ring is reused once the fence is signaled
+// Without ARB_buffer_storage the ring is mapped for each image on the main thread, and filled there.
+// A cooked image (DDS file) is streamed as it is, block-compressed with its mip chain.
+// Only GL_TEXTURE_2D textures are streamed.
+class TextureStreamer
+{
+public:
+    struct Request
+    {
+        unsigned int texture;
+        std::string path;
+        int channels;   // 0: as in the file
+        bool flip;
+        bool mipmaps;
+        GLenum minFilter; // set once the mip chain exists
+    };
+
+    // a texture whose image has been uploaded
+    struct Uploaded
+    {
+        unsigned int texture;
+        int width;
+        int height;
+        int channels;
+        size_t bytes; // in video memory, with the mip chain
+        int levels;
+    };
+
+    TextureStreamer(size_t _capacity = 32 << 20, size_t _bytesPerFrame = 8 << 20)
+        : capacity(_capacity), bytesPerFrame(_bytesPerFrame), buffer(0), mapped(nullptr), persistent(false), head(0) {}
+
+    ~TextureStreamer()
+    {
+        shutdown();
+    }
+
+    void setBytesPerFrame(size_t _bytesPerFrame)
+    {
+        bytesPerFrame = _bytesPerFrame;
+    }
+
+    void request(const Request& request)
+    {
+        if (buffer == 0)
+            init();
+
+        std::unique_ptr<Job> job(new Job());
+        job->request = request;
+        job->state = DECODING;
+        job->cancelled = false;
+        Job* decoding = job.get();
+        // the workers flip the images themselves, after the loading the main thread is waiting for
+        job->work = ThreadPool::instance().submit([decoding]() { decode(*decoding); }, ThreadPool::BACKGROUND);
+        jobs.push_back(std::move(job));
+    }
+
+    // the texture has been deleted before its image arrived
+    void cancel(unsigned int texture)
+    {
+        for (std::list<std::unique_ptr<Job>>::iterator it = jobs.begin(); it != jobs.end(); ++it)
+        {
+            if ((*it)->request.texture == texture)
+                (*it)->cancelled = true;
+        }
+    }
+
+    unsigned int getPending() const
+    {
+        return static_cast<unsigned int>(jobs.size());
+    }
+
+    // once per frame: never waits for the workers nor the GPU
+    std::vector<Uploaded> update()
+    {
+        CPU_PROFILE_SCOPE("TextureStreamer::update");
+        std::vector<Uploaded> uploaded;
+        retireRegions();
+
+        size_t budget = bytesPerFrame;
+        bool allocated = false;
+        std::list<std::unique_ptr<Job>>::iterator it = jobs.begin();
+        while (it != jobs.end())
+        {
+            Job& job = **it;
+            if (job.state != DECODED && !isReady(job.work))
+            {
+                ++it;
+                continue;
+            }
+            if (job.state != DECODED)
+                job.work.get();
+
+            if (job.cancelled || job.pixels.empty())
+            {
+                // a cancelled copy leaves its region unused: fence it right away
+                if (job.state == COPYING)
+                    fenceRegion(job.offset);
+                it = jobs.erase(it);
+                continue;
+            }
+
+            if (job.state == DECODING)
+                job.state = DECODED;
+            if (job.state == DECODED)
+            {
+                // at least one image per frame, even bigger than the budget
+                size_t size = job.pixels.size();
+                if (allocated && size > budget)
+                {
+                    ++it;
+                    continue;
+                }
+                if (size > capacity)
+                {
+                    // doesn't fit in the ring
+                    uploadFromMemory(job);
+                }
+                else if (!allocate(size, job.offset))
+                {
+                    ++it;
+                    continue;
+                }
+                else if (persistent)
+                {
+                    job.state = COPYING;
+                    Job* copying = &job;
+                    unsigned char* destination = mapped + job.offset;
+                    job.work = ThreadPool::instance().submit([copying, destination]() { copy(*copying, destination); });
+                }
+                else
+                {
+                    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, buffer);
+                    void* destination = glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, job.offset, size, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT | GL_MAP_UNSYNCHRONIZED_BIT);
+                    copy(job, static_cast<unsigned char*>(destination));
+                    glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+                    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+                    uploadFromBuffer(job);
+                }
+                budget = size > budget ? 0 : budget - size;
+                allocated = true;
+                if (job.state == COPYING)
+                {
+                    ++it;
+                    continue;
+                }
+            }
+            else
+            {
+                // COPYING, and the worker is done
+                uploadFromBuffer(job);
+            }
+
+            Uploaded done = { job.request.texture, job.width, job.height, job.channels, getVideoMemory(job), job.request.mipmaps ? static_cast<int>(job.levels.size()) : 1 };
+            uploaded.push_back(done);
+            it = jobs.erase(it);
+        }
+        return uploaded;
+    }
+
+    // wait for the workers & the GPU, then free the ring (before the context is destroyed)
+    void shutdown()
+    {
+        if (buffer == 0)
+            return;
+        for (std::list<std::unique_ptr<Job>>::iterator it = jobs.begin(); it != jobs.end(); ++it)
+        {
+            if ((*it)->work.valid())
+                (*it)->work.wait();
+        }
+        jobs.clear();
+        for (unsigned int i = 0; i < regions.size(); i++)
+        {
+            if (regions[i].fence != 0)
+                glDeleteSync(regions[i].fence);
+        }
+        regions.clear();
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, buffer);
+        if (persistent)
+            glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+        glDeleteBuffers(1, &buffer);
+        buffer = 0;
+        mapped = nullptr;
+        head = 0;
+    }
+
+private:
+    enum State
+    {
+        DECODING,
+        DECODED,
+        COPYING
+    };
+
+    struct Job
+    {
+        Request request;
+        State state;
+        bool cancelled;
+        std::future<void> work;
+
+        int width;
+        int height;
+        int channels;
+        std::vector<unsigned char> pixels; // every level, flipped, ready to be uploaded
+        size_t offset; // in the ring
+
+        bool compressed;
+        GLenum format;
+        std::vector<DDSFile::Level> levels; // in pixels
+    };
+
+    // a part of the ring the GPU may still read
+    struct Region
+    {
+        size_t begin;
+        size_t end;
+        GLsync fence; // 0 while the image isn't uploaded yet
+    };
+
+    void init()
+    {
+        glGenBuffers(1, &buffer);
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, buffer);
+        persistent = GLExtensions::get().bufferStorage;
+        if (persistent)
+        {
+            GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+            GLExtensions::get().glBufferStorage(GL_PIXEL_UNPACK_BUFFER, capacity, NULL, flags);
+            mapped = static_cast<unsigned char*>(glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, capacity, flags));
+            persistent = mapped != nullptr;
+        }
+        if (!persistent)
+            glBufferData(GL_PIXEL_UNPACK_BUFFER, capacity, NULL, GL_STREAM_DRAW);
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+        std::cout << "Texture streaming: " << (capacity >> 20) << " MB ring, " << (bytesPerFrame >> 20) << " MB per frame"
+            << (persistent ? " (persistently mapped)" : " (mapped per upload)") << std::endl;
+    }
+
+    static bool isReady(const std::future<void>& work)
+    {
+        return work.wait_for(std::chrono::seconds(0)) == std::future_status::ready;
+    }
+
+    // worker
+    static void decode(Job& job)
+    {
+        CPU_PROFILE_SCOPE("TextureStreamer::decode");
+        DDSFile::Image cooked;
+        job.compressed = DDSFile::loadCooked(job.request.path, job.request.flip, cooked);
+        if (job.compressed)
+        {
+            job.format = cooked.format;
+            job.levels = cooked.levels;
+            job.pixels.swap(cooked.data);
+            job.width = job.levels[0].width;
+            job.height = job.levels[0].height;
+            job.channels = job.format == GL_COMPRESSED_RG_RGTC2 ? 2 : job.format == GL_COMPRESSED_RGB_S3TC_DXT1_EXT ? 3 : 4;
+            return;
+        }
+
+        int fileChannels = 0;
+        stbi_set_flip_vertically_on_load_thread(false); // this worker only
+        unsigned char* data = stbi_load(job.request.path.c_str(), &job.width, &job.height, &fileChannels, job.request.channels);
+        if (!data)
+        {
+            std::cout << "Texture failed to load at path: " << job.request.path << std::endl;
+            return;
+        }
+        job.channels = job.request.channels != 0 ? job.request.channels : fileChannels;
+        size_t rowSize = static_cast<size_t>(job.width) * job.channels;
+        std::vector<unsigned char> image(rowSize * job.height);
+        for (int y = 0; y < job.height; y++)
+        {
+            int source = job.request.flip ? job.height - 1 - y : y;
+            std::memcpy(&image[y * rowSize], data + source * rowSize, rowSize);
+        }
+        stbi_image_free(data);
+
+        if (job.request.mipmaps)
+        {
+            std::vector<MipGenerator::Level> mips = MipGenerator::generate(image.data(), job.width, job.height, job.channels,
+                MipGenerator::getOptions(job.request.path, job.channels, image.data(), job.width * job.height), job.pixels);
+            for (unsigned int l = 0; l < mips.size(); l++)
+            {
+                DDSFile::Level level = { mips[l].width, mips[l].height, mips[l].offset, mips[l].size };
+                job.levels.push_back(level);
+            }
+        }
+        else
+        {
+            DDSFile::Level level = { job.width, job.height, 0, image.size() };
+            job.levels.push_back(level);
+            job.pixels.swap(image);
+        }
+    }
+
+    // worker (or the main thread without persistent mapping)
+    static void copy(Job& job, unsigned char* destination)
+    {
+        CPU_PROFILE_SCOPE("TextureStreamer::copy");
+        std::memcpy(destination, job.pixels.data(), job.pixels.size());
+    }
+
+    void uploadFromBuffer(Job& job)
+    {
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, buffer);
+        upload(job, reinterpret_cast<const void*>(job.offset));
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+        fenceRegion(job.offset);
+    }
+
+    void uploadFromMemory(Job& job)
+    {
+        upload(job, job.pixels.data());
+    }
+
+    // replace the placeholder (glTexImage2D reads from the bound PBO, data is then an offset)
+    static void upload(const Job& job, const void* data)
+    {
+        if (job.compressed)
+        {
+            uploadCompressed(job, static_cast<const unsigned char*>(data));
+            return;
+        }
+        GLenum format = job.channels == 1 ? GL_RED : job.channels == 2 ? GL_RG : job.channels == 3 ? GL_RGB : GL_RGBA;
+        glBindTexture(GL_TEXTURE_2D, job.request.texture);
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+        for (unsigned int l = 0; l < job.levels.size(); l++)
+        {
+            const DDSFile::Level& level = job.levels[l];
+            glTexImage2D(GL_TEXTURE_2D, l, format, level.width, level.height, 0, format, GL_UNSIGNED_BYTE, static_cast<const unsigned char*>(data) + level.offset);
+        }
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, static_cast<GLint>(job.levels.size()) - 1);
+        if (job.request.mipmaps)
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, job.request.minFilter);
+        glBindTexture(GL_TEXTURE_2D, 0);
+    }
+
+    static void uploadCompressed(const Job& job, const unsigned char* data)
+    {
+        unsigned int numLevels = job.request.mipmaps ? static_cast<unsigned int>(job.levels.size()) : 1;
+        glBindTexture(GL_TEXTURE_2D, job.request.texture);
+        for (unsigned int l = 0; l < numLevels; l++)
+        {
+            const DDSFile::Level& level = job.levels[l];
+            glCompressedTexImage2D(GL_TEXTURE_2D, l, job.format, level.width, level.height, 0, static_cast<GLsizei>(level.size), data + level.offset);
+        }
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, numLevels - 1);
+        if (job.request.mipmaps)
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, job.request.minFilter);
+        glBindTexture(GL_TEXTURE_2D, 0);
+    }
+
+    static size_t getVideoMemory(const Job& job)
+    {
+        return job.request.mipmaps ? job.pixels.size() : job.levels[0].size;
+    }
+
+    // the next free part of the ring (wraps to the beginning), false if the GPU still reads it
+    bool allocate(size_t size, size_t& offset)
+    {
+        size_t start = head + size > capacity ? 0 : head;
+        for (unsigned int i = 0; i < regions.size(); i++)
+        {
+            if (start < regions[i].end && regions[i].begin < start + size)
+                return false;
+        }
+        Region region = { start, start + size, 0 };
+        regions.push_back(region);
+        // the uploads read the PBO with an alignment of 1, but keep the regions 4-byte aligned
+        head = (start + size + 3) & ~static_cast<size_t>(3);
+        offset = start;
+        return true;
+    }
+
+    void fenceRegion(size_t offset)
+    {
+        for (unsigned int i = 0; i < regions.size(); i++)
+        {
+            if (regions[i].begin == offset && regions[i].fence == 0)
+            {
+                regions[i].fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+                return;
+            }
+        }
+    }
+
+    void retireRegions()
+    {
+        unsigned int kept = 0;
+        for (unsigned int i = 0; i < regions.size(); i++)
+        {
+            Region& region = regions[i];
+            if (region.fence != 0)
+            {
+                GLenum status = glClientWaitSync(region.fence, 0, 0);
+                if (status == GL_ALREADY_SIGNALED || status == GL_CONDITION_SATISFIED)
+                {
+                    glDeleteSync(region.fence);
+                    continue;
+                }
+            }
+            regions[kept++] = region;
+        }
+        regions.resize(kept);
+    }
+
+    size_t capacity;
+    size_t bytesPerFrame;
+
+    unsigned int buffer;
+    unsigned char* mapped;
+    bool persistent;
+
+    size_t head;
+    std::vector<Region> regions;
+    std::list<std::unique_ptr<Job>> jobs;
+};
+
+#endif
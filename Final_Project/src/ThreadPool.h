@@ -0,0 +1,108 @@
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+#include <condition_variable>
+#include <functional>
+#include <future>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <vector>
+
+// Worker threads for the CPU side of the loading (image decoding...)
+// The tasks must not call OpenGL: the context is only current on the main thread.
+// Background tasks (streaming) only run when no normal task is queued, so the loading which the main
+// thread waits for (parallelFor) isn't queued behind them.
+class ThreadPool
+{
+public:
+    enum Priority
+    {
+        NORMAL,
+        BACKGROUND
+    };
+
+    // one worker per core, the main thread waits (or does the GL work) meanwhile
+    static ThreadPool& instance()
+    {
+        static ThreadPool pool(std::thread::hardware_concurrency());
+        return pool;
+    }
+
+    explicit ThreadPool(unsigned int numThreads) : stopping(false)
+    {
+        if (numThreads == 0)
+            numThreads = 1;
+        for (unsigned int i = 0; i < numThreads; i++)
+            workers.push_back(std::thread(&ThreadPool::work, this));
+    }
+
+    ~ThreadPool()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        wakeUp.notify_all();
+        for (unsigned int i = 0; i < workers.size(); i++)
+            workers[i].join();
+    }
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    std::future<void> submit(std::function<void()> task, Priority priority = NORMAL)
+    {
+        std::shared_ptr<std::packaged_task<void()>> packaged = std::make_shared<std::packaged_task<void()>>(task);
+        std::future<void> result = packaged->get_future();
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            (priority == NORMAL ? tasks : backgroundTasks).push([packaged]() { (*packaged)(); });
+        }
+        wakeUp.notify_one();
+        return result;
+    }
+
+    // run task(0) ... task(count - 1) on the workers and wait for all of them
+    void parallelFor(unsigned int count, const std::function<void(unsigned int)>& task)
+    {
+        std::vector<std::future<void>> results;
+        for (unsigned int i = 0; i < count; i++)
+            results.push_back(submit([&task, i]() { task(i); }));
+        for (unsigned int i = 0; i < results.size(); i++)
+            results[i].get();
+    }
+
+    unsigned int size() const
+    {
+        return static_cast<unsigned int>(workers.size());
+    }
+
+private:
+    void work()
+    {
+        while (true)
+        {
+            std::function<void()> task;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                wakeUp.wait(lock, [this]() { return stopping || !tasks.empty() || !backgroundTasks.empty(); });
+                if (stopping && tasks.empty() && backgroundTasks.empty())
+                    return;
+                std::queue<std::function<void()>>& queue = !tasks.empty() ? tasks : backgroundTasks;
+                task = std::move(queue.front());
+                queue.pop();
+            }
+            task();
+        }
+    }
+
+    std::vector<std::thread> workers;
+    std::queue<std::function<void()>> tasks;
+    std::queue<std::function<void()>> backgroundTasks;
+    std::mutex mutex;
+    std::condition_variable wakeUp;
+    bool stopping;
+};
+
+#endif
@@ -23,6 +23,26 @@
 #include "Camera.h"
 #include "Skybox.h"
 #include "Model.h"
+#include "DynamicResolution.h"
+#include "GpuProfiler.h"
+#include "CpuProfiler.h"
+#include "Renderer.h"
+#include "Headless.h"
+#include "ImageWriter.h"
+#include "Benchmark.h"
+#include "GoldenImage.h"
+#include "InputLog.h"
+#include "GLExtensions.h"
+#include "TextureCooker.h"
+#include "MipGenerator.h"
+
+#include <cstdio>
+#include <cstdlib>
+#ifdef _WIN32
+#include <direct.h>
+#else
+#include <sys/stat.h>
+#endif
 
 
 
@@ -41,8 +61,6 @@ void mouse_button_callback(GLFWwindow* window, int button, int action, int mods)
 // settings
 const unsigned int SCR_WIDTH = 800;
 const unsigned int SCR_HEIGHT = 600;
-const unsigned int SHADOW_WIDTH = 1024;
-const unsigned int SHADOW_HEIGHT = 1024;
 
 // timing
 float deltaTime = 0.0f;
@@ -62,11 +80,14 @@ bool stencil = false;
 bool bloom = true;
 std::string skybox_name("rock");
 
-// Skyboxs
-Skybox skybox;
+// Dynamic resolution (target: 60 fps)
+DynamicResolution dynamicResolution(SCR_WIDTH, SCR_HEIGHT, 16.6f);
+
+// GPU time of each pass (toggle with P)
+GpuProfiler gpuProfiler(240);
 
-// Meshs
-Mesh floorMesh(glm::vec3(0.0f));
+// Input recording & replay (--record / --replay)
+InputLog inputLog;
 
 // Camera & lights
 //SphereCamera camera(glm::vec3(0.0f, 0.0f, 0.0f), 8.0);
@@ -81,16 +102,131 @@ float trackballSize = static_cast<float>(SCR_HEIGHT);
 Trackball trackball(trackballSize, SCR_WIDTH, SCR_HEIGHT, camera.getFront(), camera.getUp());
 
 int mouseState = GLFW_RELEASE;
+bool pickRequested = false; // by a click, done in the render loop (the renderer isn't global)
 
 float mousePosX = static_cast<float>(SCR_WIDTH);
 float mousePosY = static_cast<float>(SCR_HEIGHT);
 
-myTexture2D loadTextureFromFile(const char* file, bool alpha);
+bool createHeadlessContext(HeadlessContext& context);
+int runHeadless(unsigned int frames, const std::string& outputDir);
+int runBenchmark(unsigned int frames, const std::string& outputPrefix);
+int runGolden(const std::string& goldenDir, bool update);
+FrameSettings makeFrameSettings(const glm::mat4& view, const glm::vec3& viewPos);
+void makeDirectory(const std::string& path);
 
-void renderQuad();
-
-int main()
+int main(int argc, char** argv)
 {
+    // command line options
+    // --trace <file>: record CPU timings (startup & every frame) and write them as a Chrome trace at exit
+    // --headless <frames>: render <frames> frames of a scripted orbit without window and save them as PNG
+    // --output <dir>: directory of the headless frames (default: frames)
+    // --benchmark <frames>: headless deterministic benchmark, timings written to <prefix>.csv & <prefix>.json
+    // --benchmark-output <prefix>: output files of the benchmark (default: benchmark)
+    // --golden <dir>: render every effect combination and compare with the golden images of <dir> (exit code 1 on failure)
+    // --update-goldens <dir>: render every effect combination and save them as the new golden images
+    // --record <file>: record the input of every frame into a binary log
+    // --replay <file>: play a recorded log back instead of the real input
+    // --no-program-cache: always compile the shaders (don't read or write shader_cache/)
+    // --cook: convert the images of textures/ & meshs/ which changed into compressed DDS files, then exit
+    // --cook-all: same for every image
+    // --mip-benchmark: measure the CPU mip generation (megapixels/s of each filter), then exit
+    // --texture-budget <MB>: video memory of the textures, the idle ones are shrunk beyond it (default: no limit)
+    // --mesh-report: vertex cache efficiency (ACMR/ATVR) of every mesh of meshs/ before and after the optimization, then exit
+    std::string tracePath;
+    unsigned int headlessFrames = 0;
+    std::string outputDir("frames");
+    unsigned int benchmarkFrames = 0;
+    std::string benchmarkOutput("benchmark");
+    std::string goldenDir;
+    bool updateGoldens = false;
+    std::string recordPath;
+    std::string replayPath;
+    bool cook = false;
+    bool cookAll = false;
+    bool mipBenchmark = false;
+    bool meshReport = false;
+    for (int i = 1; i < argc; i++)
+    {
+        std::string arg(argv[i]);
+        if (arg == "--trace" && i + 1 < argc)
+            tracePath = argv[++i];
+        else if (arg == "--headless" && i + 1 < argc)
+            headlessFrames = static_cast<unsigned int>(std::atoi(argv[++i]));
+        else if (arg == "--output" && i + 1 < argc)
+            outputDir = argv[++i];
+        else if (arg == "--benchmark" && i + 1 < argc)
+            benchmarkFrames = static_cast<unsigned int>(std::atoi(argv[++i]));
+        else if (arg == "--benchmark-output" && i + 1 < argc)
+            benchmarkOutput = argv[++i];
+        else if ((arg == "--golden" || arg == "--update-goldens") && i + 1 < argc)
+        {
+            updateGoldens = arg == "--update-goldens";
+            goldenDir = argv[++i];
+        }
+        else if (arg == "--record" && i + 1 < argc)
+            recordPath = argv[++i];
+        else if (arg == "--replay" && i + 1 < argc)
+            replayPath = argv[++i];
+        else if (arg == "--no-program-cache")
+            ProgramCache::instance().setEnabled(false);
+        else if (arg == "--cook" || arg == "--cook-all")
+        {
+            cook = true;
+            cookAll = arg == "--cook-all";
+        }
+        else if (arg == "--mip-benchmark")
+            mipBenchmark = true;
+        else if (arg == "--mesh-report")
+            meshReport = true;
+        else if (arg == "--texture-budget" && i + 1 < argc)
+            TextureCache::instance().setBudget(static_cast<size_t>(std::atoi(argv[++i])) << 20);
+    }
+    CpuProfiler::instance().registerMainThread();
+    CpuProfiler::instance().setEnabled(!tracePath.empty());
+
+    if (mipBenchmark)
+    {
+        MipGenerator::runBenchmark(2048, 5);
+        return 0;
+    }
+
+    if (meshReport)
+    {
+        // CPU only, no OpenGL context
+        std::vector<std::string> files;
+        TextureCooker::findFiles("meshs", [](const std::string& name) { return name.size() > 4 && name.substr(name.size() - 4) == ".obj"; }, files);
+        bool loaded = !files.empty();
+        for (unsigned int i = 0; i < files.size(); i++)
+            loaded = Model::printOptimizationReport(files[i]) && loaded;
+        return loaded ? 0 : 1;
+    }
+
+    if (cook)
+    {
+        // CPU only, no OpenGL context
+        std::vector<std::string> directories;
+        directories.push_back("textures");
+        directories.push_back("meshs");
+        TextureCooker::Stats stats = TextureCooker::cookDirectories(directories, cookAll);
+        if (!tracePath.empty())
+            CpuProfiler::instance().writeChromeTrace(tracePath);
+        return stats.cooked + stats.skipped > 0 ? 0 : 1;
+    }
+
+    if (headlessFrames > 0 || benchmarkFrames > 0 || !goldenDir.empty())
+    {
+        int result;
+        if (!goldenDir.empty())
+            result = runGolden(goldenDir, updateGoldens);
+        else if (benchmarkFrames > 0)
+            result = runBenchmark(benchmarkFrames, benchmarkOutput);
+        else
+            result = runHeadless(headlessFrames, outputDir);
+        if (!tracePath.empty())
+            CpuProfiler::instance().writeChromeTrace(tracePath);
+        return result;
+    }
+
     // glfw: initialize and configure
     // ------------------------------
     glfwInit();
@@ -113,9 +249,19 @@ int main()
     }
     glfwMakeContextCurrent(window);
     glfwSetFramebufferSizeCallback(window, framebuffer_size_callback);
-    glfwSetCursorPosCallback(window, mouse_callback);
-    glfwSetMouseButtonCallback(window, mouse_button_callback);
-    glfwSetScrollCallback(window, scroll_callback);
+    if (!replayPath.empty() && inputLog.startReplay(replayPath))
+    {
+        // the input comes from the log only: the log calls the handlers instead of GLFW
+        inputLog.setCallbacks(mouse_callback, mouse_button_callback, scroll_callback);
+    }
+    else
+    {
+        glfwSetCursorPosCallback(window, mouse_callback);
+        glfwSetMouseButtonCallback(window, mouse_button_callback);
+        glfwSetScrollCallback(window, scroll_callback);
+        if (!recordPath.empty())
+            inputLog.startRecording(recordPath);
+    }
     glfwSetInputMode(window, GLFW_STICKY_MOUSE_BUTTONS, GLFW_TRUE);
 
 
@@ -129,333 +275,320 @@ int main()
         std::cout << "Failed to initialize GLAD" << std::endl;
         return -1;
     }
+    GLExtensions::load((GLADloadproc)glfwGetProcAddress);
 
     // tell stb_image.h to flip loaded texture's on the y-axis (before loading model).
     stbi_set_flip_vertically_on_load(true);
 
-    // configure global opengl state
-    // -----------------------------
-    glEnable(GL_DEPTH_TEST);
-    
-    glDepthFunc(GL_LESS);
-    glEnable(GL_STENCIL_TEST);
-    glStencilFunc(GL_NOTEQUAL, 1, 0xFF);
-    glStencilOp(GL_KEEP, GL_KEEP, GL_REPLACE);
-
-    glEnable(GL_CULL_FACE);
+    // the renderer (and the textures of the cache) are released in this block, before the context is destroyed
+    {
+        // shaders, textures, models & framebuffers (the model textures are streamed during the first frames)
+        TextureCache::instance().setStreaming(true);
+        Renderer renderer(SCR_WIDTH, SCR_HEIGHT, dynamicResolution, gpuProfiler);
+        renderer.enableHotReload();
 
-    // build and compile shaders
-    Shader singleColorShader("shaders/singleColorShader.vert", "shaders/singleColorShader.frag");
-    std::cout << "SingleColorShader end" << std::endl;
+        dynamicResolution.init();
 
-    Shader pointShadowToonShader("shaders/pointShadowToonShader.vert", "shaders/pointShadowToonShader.frag");
-    std::cout << "pointShadowToonShader end" << std::endl;
-    Shader pointShadowShader("shaders/pointShadowShader.vert", "shaders/pointShadowShader.frag");
-    std::cout << "pointShadowShader end" << std::endl;
+        // render loop
+        // -----------
+        while (!glfwWindowShouldClose(window))
+        {
+            CPU_PROFILE_SCOPE("frame");
+            CpuStageTimer stage;
+
+            // per-frame time logic
+            // --------------------
+            float currentFrame = static_cast<float>(glfwGetTime());
+            deltaTime = currentFrame - lastFrame;
+            lastFrame = currentFrame;
+            // record the frame, or take the recorded deltaTime & keys
+            if (!inputLog.beginFrame(window, deltaTime))
+                break;
+            timer += deltaTime;
+
+            // input
+            // -----
+            stage.next("processInput");
+            processInput(window);
+
+            // the trackball rotates the mesh under the crosshair (the cursor is captured by the camera), or the whole model
+            if (pickRequested)
+            {
+                pickRequested = false;
+                renderer.ourModel.select(renderer.pick(camera.getPosition(), camera.getFront()));
+            }
 
-    Shader simplePointDepthShader("shaders/simplePointDepthShader.vert", "shaders/simplePointDepthShader.frag", "shaders/simplePointDepthShader.geo");
-    std::cout << "simplePointDepthShader end" << std::endl;
+            // update rotation by trackball
+            if (mouseState == GLFW_PRESS)
+            {
+                auto p = trackball.getRotation(mousePosX, mousePosY);
+                renderer.ourModel.updateRotation(p);
+            }
 
-    Shader bloomShader("shaders/bloomShader.vert", "shaders/bloomShader.frag"); // Final bloom shader
-    std::cout << "bloomShader end" << std::endl;
-    Shader blurShader("shaders/blurShader.vert", "shaders/blurShader.frag");
-    std::cout << "blurShader end" << std::endl;
+            // render
+            // ------
+            stage.next("render");
+            renderer.renderFrame(makeFrameSettings(camera.GetViewMatrix(), camera.getPosition()), 0);
+
+            // glfw: swap buffers and poll IO events (keys pressed/released, mouse moved etc.)
+            // -------------------------------------------------------------------------------
+            stage.next("swap & poll");
+            glfwSwapBuffers(window);
+            glfwPollEvents();
+            inputLog.dispatchEvents(window);
+        }
+        inputLog.close();
+        renderer.ourModel.printMeshletStats();
+        renderer.getBvh().printTimings(std::cout);
+    }
 
-    Shader skyboxShader("shaders/skyboxShader.vert", "shaders/skyboxShader.frag");
-    std::cout << "skyboxShader end" << std::endl;
+    if (!tracePath.empty())
+        CpuProfiler::instance().writeChromeTrace(tracePath);
 
-    pointShadowToonShader.use();
-    pointShadowToonShader.setInt("meshTexture", 0);
-    pointShadowToonShader.setInt("shadowMap", 1);
-    pointShadowToonShader.setInt("scene", 2);
+    // glfw: terminate, clearing all previously allocated GLFW resources.
+    // ------------------------------------------------------------------
+    glfwTerminate();
+    return 0;
+}
 
-    pointShadowShader.use();
-    pointShadowShader.setInt("meshTexture", 0);
-    pointShadowShader.setInt("shadowMap", 1);
-    pointShadowShader.setInt("scene", 2);
+// Render frames without window: the camera orbits around the model and the light turns the other way,
+// each frame is rendered into an offscreen FBO and written to <outputDir>/frame_XXXX.png
+int runHeadless(unsigned int frames, const std::string& outputDir)
+{
+    HeadlessContext context;
+    if (!createHeadlessContext(context))
+        return -1;
+    makeDirectory(outputDir);
 
-    blurShader.use();
-    blurShader.setInt("image", 0);
+    {
+        Renderer renderer(SCR_WIDTH, SCR_HEIGHT, dynamicResolution, gpuProfiler);
+        OffscreenTarget target(SCR_WIDTH, SCR_HEIGHT);
 
-    bloomShader.use();
-    bloomShader.setInt("scene", 0);
-    bloomShader.setInt("bloomBlur", 1);
+        SphereCamera orbit(glm::vec3(0.0f, 0.0f, 0.0f), 14.0f, 90.0f, 35.0f);
+        float stepAngle = 360.0f / frames;
 
-    skyboxShader.setInt("skybox", 0);
+        std::vector<unsigned char> pixels;
+        char fileName[32];
+        for (unsigned int frame = 0; frame < frames; frame++)
+        {
+            CPU_PROFILE_SCOPE("headless frame");
 
-    // load textures
+            glm::vec3 viewPos = orbit.getPosition();
+            glm::mat4 view = glm::lookAt(viewPos, glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+            renderer.renderFrame(makeFrameSettings(view, viewPos), target.getFBO());
 
-    myTexture2D spotTexture = loadTextureFromFile("textures/others/spot_texture.png", false);
-    myTexture2D hmap = loadTextureFromFile("textures/others/hmap.jpg", false); //test
-    myTexture2D floorTexture = loadTextureFromFile("textures/skybox_rock/bottom.png", true);
+            target.readPixels(pixels);
+            std::snprintf(fileName, sizeof(fileName), "/frame_%04u.png", frame);
+            if (!ImageWriter::writePNG(outputDir + fileName, target.getWidth(), target.getHeight(), 4, pixels.data(), true))
+                std::cout << "Can't write " << outputDir + fileName << std::endl;
 
-    // load models
-    floorMesh.load_vtn("meshs/others/floor.obj");
-    
-    Model ourModel("meshs/nanosuit/nanosuit.obj");
+            orbit.updateTheta(stepAngle);
+            pointLight.updateTheta(-stepAngle);
+        }
+        std::cout << frames << " frames written to " << outputDir << std::endl;
+    }
 
-    // load skybox's texture & vertices
+    context.destroy();
+    return 0;
+}
 
-    skybox.load_vertices();
+// Render a scripted run without window (fixed timestep, effects toggled at fixed frames)
+// and write the CPU & GPU time of every frame
+int runBenchmark(unsigned int frames, const std::string& outputPrefix)
+{
+    HeadlessContext context;
+    if (!createHeadlessContext(context))
+        return -1;
 
-    std::vector<std::string> faces
     {
-        "textures/skybox_rock/right.png",
-        "textures/skybox_rock/left.png",
-        "textures/skybox_rock/top.png",
-        "textures/skybox_rock/bottom.png",
-        "textures/skybox_rock/front.png",
-        "textures/skybox_rock/back.png"
-    };
-
-    skybox.loadCubemap(faces, true);
-
-    // Cube depth map (For point shadow)
-     
-    // Create FBO for storing depth map(cube)    
-    unsigned int depthCubeMapFBO;
-    glGenFramebuffers(1, &depthCubeMapFBO);
-    // Create depth cubemap texture
-    unsigned int depthCubemap;
-    glGenTextures(1, &depthCubemap);
-    glBindTexture(GL_TEXTURE_CUBE_MAP, depthCubemap);
-    for (unsigned int i = 0; i < 6; ++i)
-        glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, 0, GL_DEPTH_COMPONENT, SHADOW_WIDTH, SHADOW_HEIGHT, 0, GL_DEPTH_COMPONENT, GL_FLOAT, NULL);
-    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
-    //Attach texture to FBO
-    glBindFramebuffer(GL_FRAMEBUFFER, depthCubeMapFBO);
-    glFramebufferTexture(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, depthCubemap, 0);
-    glDrawBuffer(GL_NONE);
-    glReadBuffer(GL_NONE);
-    glBindFramebuffer(GL_FRAMEBUFFER, 0);
-    
+        Renderer renderer(SCR_WIDTH, SCR_HEIGHT, dynamicResolution, gpuProfiler);
+        OffscreenTarget target(SCR_WIDTH, SCR_HEIGHT);
 
-    // Create FBO for post-processing
-    unsigned int blurFBO;
-    glGenFramebuffers(1, &blurFBO);
-    glBindFramebuffer(GL_FRAMEBUFFER, blurFBO);
+        Benchmark benchmark(frames);
+        benchmark.addDefaultToggles();
+        benchmark.init();
 
-    // Create 2 color attachment to this FBO. One for the real scene, and the other for the bright part
-    unsigned int colorBuffers[2];
-    glGenTextures(2, colorBuffers);
-    for (unsigned int i = 0; i < 2; i++)
-    {
-        glBindTexture(GL_TEXTURE_2D, colorBuffers[i]);
-        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA16F, SCR_WIDTH, SCR_HEIGHT, 0, GL_RGBA, GL_FLOAT, NULL);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);  // we clamp to the edge as the blur filter would otherwise sample repeated texture values!
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-        // attach texture to framebuffer
-        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0 + i, GL_TEXTURE_2D, colorBuffers[i], 0);
-    }
+        SphereCamera orbit(glm::vec3(0.0f, 0.0f, 0.0f), 14.0f, 90.0f, 35.0f);
+        deltaTime = benchmark.getTimeStep();
+        for (unsigned int frame = 0; frame < frames; frame++)
+        {
+            CPU_PROFILE_SCOPE("benchmark frame");
 
-    // create depth & stencil buffer (renderbuffer)
-    // note that we need both depth and stencil buffer
-    unsigned int rboDepthStencil;
-    glGenRenderbuffers(1, &rboDepthStencil);
-    glBindRenderbuffer(GL_RENDERBUFFER, rboDepthStencil);
-    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH24_STENCIL8, SCR_WIDTH, SCR_HEIGHT);
-    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_RENDERBUFFER, rboDepthStencil);
-    
-    // tell OpenGL which color attachments we'll use (of this framebuffer) for rendering 
-    unsigned int attachments[2] = { GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1 };
-    glDrawBuffers(2, attachments);
-    // finally check if framebuffer is complete
-    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
-        std::cout << "Framebuffer not complete!" << std::endl;
-    glBindFramebuffer(GL_FRAMEBUFFER, 0);
-
-    // ping-pong-framebuffer for blurring
-    // ping-pong: blur horizentally and then vertically, repeat these 2 steps to save the blur time(Ex. 1024 -> 32+32)
-    unsigned int pingpongFBO[2];
-    unsigned int pingpongColorbuffers[2];
-    glGenFramebuffers(2, pingpongFBO);
-    glGenTextures(2, pingpongColorbuffers);
-    // Create 2 color attachment to ping-pong FBO
-    for (unsigned int i = 0; i < 2; i++)
-    {
-        glBindFramebuffer(GL_FRAMEBUFFER, pingpongFBO[i]);
-        glBindTexture(GL_TEXTURE_2D, pingpongColorbuffers[i]);
-        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA16F, SCR_WIDTH, SCR_HEIGHT, 0, GL_RGBA, GL_FLOAT, NULL);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE); // we clamp to the edge as the blur filter would otherwise sample repeated texture values!
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, pingpongColorbuffers[i], 0);
-        // also check if framebuffers are complete (no need for depth buffer)
-        if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
-            std::cout << "Framebuffer not complete!" << std::endl;
+            std::vector<Benchmark::Effect> effects = benchmark.getToggles(frame);
+            for (unsigned int i = 0; i < effects.size(); i++)
+            {
+                switch (effects[i])
+                {
+                case Benchmark::EFFECT_TOON:
+                    toon = !toon;
+                    break;
+                case Benchmark::EFFECT_STENCIL:
+                    stencil = !stencil;
+                    break;
+                case Benchmark::EFFECT_BLOOM:
+                    bloom = !bloom;
+                    break;
+                case Benchmark::EFFECT_INVISIBLE:
+                    invisible = invisible > 0.1f ? 0.0f : 0.85f;
+                    break;
+                }
+            }
+
+            orbit.setTheta(benchmark.getCameraTheta(frame));
+            pointLight.setTheta(benchmark.getLightTheta(frame));
+            glm::vec3 viewPos = orbit.getPosition();
+            glm::mat4 view = glm::lookAt(viewPos, glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+
+            benchmark.beginFrame(frame);
+            renderer.renderFrame(makeFrameSettings(view, viewPos), target.getFBO());
+            benchmark.endFrame(frame);
+        }
+
+        benchmark.finish();
+        benchmark.printSummary(std::cout);
+        renderer.ourModel.printMeshletStats();
+        renderer.getBvh().printTimings(std::cout);
+        if (benchmark.writeCSV(outputPrefix + ".csv") && benchmark.writeJSON(outputPrefix + ".json"))
+            std::cout << "Benchmark results written to " << outputPrefix << ".csv & " << outputPrefix << ".json" << std::endl;
     }
 
-    // render loop
-    // -----------
-    while (!glfwWindowShouldClose(window))
+    context.destroy();
+    return 0;
+}
+
+// Golden image regression: every combination of toon/stencil/bloom/invisible is rendered from fixed poses
+// and compared with <goldenDir>/<name>.png. The failing frames and their heatmaps go to golden_failures/.
+int runGolden(const std::string& goldenDir, bool update)
+{
+    HeadlessContext context;
+    if (!createHeadlessContext(context))
+        return -1;
+    makeDirectory(goldenDir);
+
+    // camera (theta, phi) and light theta of each pose
+    const glm::vec3 poses[] = { glm::vec3(90.0f, 35.0f, 0.0f), glm::vec3(200.0f, 20.0f, 120.0f) };
+    const int numPoses = sizeof(poses) / sizeof(poses[0]);
+    const GoldenImage::Tolerance tolerance = GoldenImage::defaultTolerance();
+
+    unsigned int failures = 0, missing = 0, total = 0;
     {
-        // per-frame time logic
-        // --------------------
-        float currentFrame = static_cast<float>(glfwGetTime());
-        deltaTime = currentFrame - lastFrame;
-        lastFrame = currentFrame;
-        timer += deltaTime;
-
-        // input
-        // -----
-        processInput(window);
-
-        // render
-        // ------
-        glClearColor(0.3f, 0.3f, 0.3f, 1.0f);
-        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT | GL_STENCIL_BUFFER_BIT); // stencil buffer
-
-        // update rotation by trackball
-        if (mouseState == GLFW_PRESS)
-        {
-            auto p = trackball.getRotation(mousePosX, mousePosY);
-            ourModel.updateRotation(p);
-        }
-        
-        // projection & view
-        glm::mat4 projection = glm::perspective(glm::radians(45.0f), (float)SCR_WIDTH / (float)SCR_HEIGHT, 0.1f, 100.0f);
-        glm::mat4 view = camera.GetViewMatrix();
-        glm::vec3 viewPos = camera.getPosition();
-        glm::vec3 lightPos = pointLight.getPosition();
-
-        // Step 1. Render to depth map
-        // Setting transform matrices
-        float point_near_plane = 1.0f;
-        float point_far_plane = 250.0f;
-        glm::mat4 shadowProj = glm::perspective(glm::radians(90.0f), (float)SHADOW_WIDTH / (float)SHADOW_HEIGHT, point_near_plane, point_far_plane);
-        std::vector<glm::mat4> shadowTransforms;
-        // Light will face 6 different direction and record the depth of objects on cubemap
-        shadowTransforms.push_back(shadowProj * glm::lookAt(lightPos, lightPos + glm::vec3(1.0f, 0.0f, 0.0f), glm::vec3(0.0f, -1.0f, 0.0f)));
-        shadowTransforms.push_back(shadowProj * glm::lookAt(lightPos, lightPos + glm::vec3(-1.0f, 0.0f, 0.0f), glm::vec3(0.0f, -1.0f, 0.0f)));
-        shadowTransforms.push_back(shadowProj * glm::lookAt(lightPos, lightPos + glm::vec3(0.0f, 1.0f, 0.0f), glm::vec3(0.0f, 0.0f, 1.0f)));
-        shadowTransforms.push_back(shadowProj * glm::lookAt(lightPos, lightPos + glm::vec3(0.0f, -1.0f, 0.0f), glm::vec3(0.0f, 0.0f, -1.0f)));
-        shadowTransforms.push_back(shadowProj * glm::lookAt(lightPos, lightPos + glm::vec3(0.0f, 0.0f, 1.0f), glm::vec3(0.0f, -1.0f, 0.0f)));
-        shadowTransforms.push_back(shadowProj * glm::lookAt(lightPos, lightPos + glm::vec3(0.0f, 0.0f, -1.0f), glm::vec3(0.0f, -1.0f, 0.0f)));
-
-        glViewport(0, 0, SHADOW_WIDTH, SHADOW_HEIGHT);
-        simplePointDepthShader.use();
-        for (unsigned int i = 0; i < 6; ++i)
-            simplePointDepthShader.setMat4("shadowMatrices[" + std::to_string(i) + "]", shadowTransforms[i]);
-        simplePointDepthShader.setFloat("far_plane", point_far_plane);
-        simplePointDepthShader.setVec3("lightPos", lightPos);
-
-        // Bind the framebuffer to depth FBO to store the depth of objects
-        glBindFramebuffer(GL_FRAMEBUFFER, depthCubeMapFBO);
-        glClear(GL_DEPTH_BUFFER_BIT);
-
-        // Draw to store the depths
-        floorMesh.draw_only_model(simplePointDepthShader, false);
-        ourModel.draw_only_model(simplePointDepthShader);
-        glBindFramebuffer(GL_FRAMEBUFFER, 0);
-
-        // Step 2. Draw the scene onto the blurFBO. Using the depthFBO to create shadow
-
-        // Bind the framebuffer to blurFBO
-        glBindFramebuffer(GL_FRAMEBUFFER, blurFBO);
-        glViewport(0, 0, SCR_WIDTH, SCR_HEIGHT);
-        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT | GL_STENCIL_BUFFER_BIT);
-        glEnable(GL_DEPTH_TEST);
-
-        
-        // Draw the skybox
-        skybox.draw(skyboxShader, view, projection);
-        glClear(GL_STENCIL_BUFFER_BIT);
-
-        // Draw the real scene
-        Shader& pointShader = toon ? pointShadowToonShader : pointShadowShader;
-        floorMesh.draw_point_shadow(pointShader, singleColorShader, projection, view, viewPos, lightPos, floorTexture, depthCubemap, colorBuffers[0], 0.0f, point_far_plane, false, false, (invisible < 0.1f));
-        glClear(GL_STENCIL_BUFFER_BIT);
-        ourModel.draw_point_shadow(pointShader, singleColorShader, projection, view, viewPos, lightPos, floorTexture, depthCubemap, colorBuffers[0], invisible, point_far_plane, stencil, true);;
-
-        glBindFramebuffer(GL_FRAMEBUFFER, 0);
-
-        // Step 3. Blur. Use the hdrFBO, which contain normal scene and bloom part, to create the blur effect.
-
-        // Use ping-pong skill to blur the bloom part of the FBO(using gauss blur)
-        bool horizontal = true, first_iteration = true;
-        if (bloom)
+        Renderer renderer(SCR_WIDTH, SCR_HEIGHT, dynamicResolution, gpuProfiler);
+        OffscreenTarget target(SCR_WIDTH, SCR_HEIGHT);
+        std::vector<unsigned char> pixels, heatmap;
+
+        for (int pose = 0; pose < numPoses; pose++)
         {
-            unsigned int amount = 14;
-            blurShader.use();
-            for (unsigned int i = 0; i < amount; i++)
+            SphereCamera orbit(glm::vec3(0.0f, 0.0f, 0.0f), 14.0f, poses[pose].x, poses[pose].y);
+            pointLight.setTheta(poses[pose].z);
+            glm::vec3 viewPos = orbit.getPosition();
+            glm::mat4 view = glm::lookAt(viewPos, glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+
+            for (int mode = 0; mode < 16; mode++)
             {
-                glBindFramebuffer(GL_FRAMEBUFFER, pingpongFBO[horizontal]);
-                blurShader.setInt("horizontal", horizontal);
-                glActiveTexture(GL_TEXTURE0);
-                glBindTexture(GL_TEXTURE_2D, first_iteration ? colorBuffers[1] : pingpongColorbuffers[!horizontal]);  // bind texture of other framebuffer (or scene if first iteration)
-                renderQuad();
-                horizontal = !horizontal;
-                if (first_iteration)
-                    first_iteration = false;
+                toon = (mode & 1) != 0;
+                stencil = (mode & 2) != 0;
+                bloom = (mode & 4) != 0;
+                invisible = (mode & 8) != 0 ? 0.85f : 0.0f;
+                std::string name = "pose" + std::to_string(pose) + "_toon" + std::to_string(toon) + "_stencil" + std::to_string(stencil)
+                    + "_bloom" + std::to_string(bloom) + "_invisible" + std::to_string(invisible > 0.0f);
+
+                // the invisible effect samples the previous scene, so the first frame of a mode isn't stable
+                FrameSettings settings = makeFrameSettings(view, viewPos);
+                renderer.renderFrame(settings, target.getFBO());
+                renderer.renderFrame(settings, target.getFBO());
+                target.readPixels(pixels);
+                total++;
+
+                std::string goldenPath = goldenDir + "/" + name + ".png";
+                if (update)
+                {
+                    if (!ImageWriter::writePNG(goldenPath, target.getWidth(), target.getHeight(), 4, pixels.data(), true))
+                        std::cout << "Can't write " << goldenPath << std::endl;
+                    continue;
+                }
+
+                // stbi flips the golden image, so both images are bottom-up like glReadPixels (the texture decodes
+                // clear the flag of their thread, which may be this one)
+                int width, height, numChannels;
+                stbi_set_flip_vertically_on_load_thread(true);
+                unsigned char* golden = stbi_load(goldenPath.c_str(), &width, &height, &numChannels, 4);
+                if (!golden || width != static_cast<int>(target.getWidth()) || height != static_cast<int>(target.getHeight()))
+                {
+                    std::cout << "MISSING " << name << " (no golden image of the right size)" << std::endl;
+                    missing++;
+                    if (golden)
+                        stbi_image_free(golden);
+                    continue;
+                }
+
+                GoldenImage::DiffResult diff = GoldenImage::compare(pixels.data(), golden, width, height, tolerance, heatmap);
+                stbi_image_free(golden);
+                std::cout << (diff.passed ? "PASS " : "FAIL ") << name << ": max delta " << diff.maxDelta << ", mean delta " << diff.meanDelta
+                    << ", bad pixels " << diff.badPixels * 100.0f << "%, SSIM " << diff.ssim << std::endl;
+                if (!diff.passed)
+                {
+                    failures++;
+                    makeDirectory("golden_failures");
+                    ImageWriter::writePNG("golden_failures/" + name + ".png", width, height, 4, pixels.data(), true);
+                    ImageWriter::writePNG("golden_failures/" + name + "_heatmap.png", width, height, 4, heatmap.data(), true);
+                }
             }
-            glBindFramebuffer(GL_FRAMEBUFFER, 0);
         }
+    }
+    context.destroy();
 
+    if (update)
+    {
+        std::cout << total << " golden images written to " << goldenDir << std::endl;
+        return 0;
+    }
+    std::cout << "Golden images: " << total - failures - missing << "/" << total << " passed, " << failures << " failed, " << missing << " missing" << std::endl;
+    return failures + missing > 0 ? 1 : 0;
+}
 
-        // Step 4. Render the blurred scene onto the screen.
-        glClear(GL_COLOR_BUFFER_BIT);
-        bloomShader.use();
-        glActiveTexture(GL_TEXTURE0);
-        glBindTexture(GL_TEXTURE_2D, colorBuffers[0]);
-        glActiveTexture(GL_TEXTURE1);
-        if (bloom)
-        {
-            glBindTexture(GL_TEXTURE_2D, pingpongColorbuffers[!horizontal]);
-        }
-        else
-        {
-            glBindTexture(GL_TEXTURE_2D, colorBuffers[1]);
-        }
-        renderQuad();
+// Create the headless context and load OpenGL (shared by the headless modes)
+bool createHeadlessContext(HeadlessContext& context)
+{
+    if (!context.create(SCR_WIDTH, SCR_HEIGHT))
+        return false;
 
-        // glfw: swap buffers and poll IO events (keys pressed/released, mouse moved etc.)
-        // -------------------------------------------------------------------------------
-        glfwSwapBuffers(window);
-        glfwPollEvents();
+    if (!gladLoadGLLoader((GLADloadproc)HeadlessContext::getProcAddress))
+    {
+        std::cout << "Failed to initialize GLAD" << std::endl;
+        return false;
     }
+    GLExtensions::load((GLADloadproc)HeadlessContext::getProcAddress);
+    std::cout << "Headless rendering with " << context.getBackendName() << ": " << glGetString(GL_RENDERER) << std::endl;
 
-    // glfw: terminate, clearing all previously allocated GLFW resources.
-    // ------------------------------------------------------------------
-    glfwTerminate();
-    return 0;
+    stbi_set_flip_vertically_on_load(true);
+
+    // every frame must have the full resolution (and be comparable between runs)
+    dynamicResolution.setEnabled(false);
+    return true;
 }
 
+// Settings of the current frame, from the camera and the effect switches
+FrameSettings makeFrameSettings(const glm::mat4& view, const glm::vec3& viewPos)
+{
+    FrameSettings settings;
+    settings.projection = glm::perspective(glm::radians(45.0f), (float)SCR_WIDTH / (float)SCR_HEIGHT, 0.1f, 100.0f);
+    settings.view = view;
+    settings.viewPos = viewPos;
+    settings.lightPos = pointLight.getPosition();
+    settings.toon = toon;
+    settings.stencil = stencil;
+    settings.bloom = bloom;
+    settings.invisible = invisible;
+    return settings;
+}
 
-// Render the recorded texture/framebuffer.
-unsigned int quadVAO = 0;
-unsigned int quadVBO;
-void renderQuad()
+void makeDirectory(const std::string& path)
 {
-    if (quadVAO == 0)
-    {
-        float quadVertices[] = {
-            // positions        // texture Coords
-            -1.0f,  1.0f, 0.0f, 0.0f, 1.0f,
-            -1.0f, -1.0f, 0.0f, 0.0f, 0.0f,
-             1.0f,  1.0f, 0.0f, 1.0f, 1.0f,
-             1.0f, -1.0f, 0.0f, 1.0f, 0.0f,
-        };
-        // setup plane VAO
-        glGenVertexArrays(1, &quadVAO);
-        glGenBuffers(1, &quadVBO);
-        glBindVertexArray(quadVAO);
-        glBindBuffer(GL_ARRAY_BUFFER, quadVBO);
-        glBufferData(GL_ARRAY_BUFFER, sizeof(quadVertices), &quadVertices, GL_STATIC_DRAW);
-        glEnableVertexAttribArray(0);
-        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 5 * sizeof(float), (void*)0);
-        glEnableVertexAttribArray(1);
-        glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 5 * sizeof(float), (void*)(3 * sizeof(float)));
-    }
-    glBindVertexArray(quadVAO);
-    glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
-    glBindVertexArray(0);
+#ifdef _WIN32
+    _mkdir(path.c_str());
+#else
+    mkdir(path.c_str(), 0755);
+#endif
 }
 
 // process all input: query GLFW whether relevant keys are pressed/released this frame and react accordingly
@@ -463,78 +596,98 @@ void renderQuad()
 void processInput(GLFWwindow* window)
 {
     // rotate by trackball
-    if (glfwGetKey(window, GLFW_KEY_ESCAPE) == GLFW_PRESS)
+    if (inputLog.getKey(window, GLFW_KEY_ESCAPE) == GLFW_PRESS)
         glfwSetWindowShouldClose(window, true);
     
-    if (glfwGetKey(window, GLFW_KEY_UP) == GLFW_PRESS && timer > updateTimeMax)
+    if (inputLog.getKey(window, GLFW_KEY_UP) == GLFW_PRESS && timer > updateTimeMax)
     {
         timer = 0.0f;
         pointLight.updatePhi(deltaAngle);
     }
-    if (glfwGetKey(window, GLFW_KEY_DOWN) == GLFW_PRESS && timer > updateTimeMax)
+    if (inputLog.getKey(window, GLFW_KEY_DOWN) == GLFW_PRESS && timer > updateTimeMax)
     {
         timer = 0.0f;
         pointLight.updatePhi(-deltaAngle);
     }
-    if (glfwGetKey(window, GLFW_KEY_RIGHT) == GLFW_PRESS && timer > updateTimeMax)
+    if (inputLog.getKey(window, GLFW_KEY_RIGHT) == GLFW_PRESS && timer > updateTimeMax)
     {
         timer = 0.0f;
         pointLight.updateTheta(deltaAngle);
     }
-    if (glfwGetKey(window, GLFW_KEY_LEFT) == GLFW_PRESS && timer > updateTimeMax)
+    if (inputLog.getKey(window, GLFW_KEY_LEFT) == GLFW_PRESS && timer > updateTimeMax)
     {
         timer = 0.0f;
         pointLight.updateTheta(-deltaAngle);
     }
-    if (glfwGetKey(window, GLFW_KEY_W) == GLFW_PRESS && timer > updateTimeMax)
+    if (inputLog.getKey(window, GLFW_KEY_W) == GLFW_PRESS && timer > updateTimeMax)
     {
         timer = 0.0f;
         camera.ProcessKeyboard(FORWARD, deltaTime);
     }
-    if (glfwGetKey(window, GLFW_KEY_S) == GLFW_PRESS && timer > updateTimeMax)
+    if (inputLog.getKey(window, GLFW_KEY_S) == GLFW_PRESS && timer > updateTimeMax)
     {
         timer = 0.0f;
         camera.ProcessKeyboard(BACKWARD, deltaTime);
     }
-    if (glfwGetKey(window, GLFW_KEY_A) == GLFW_PRESS && timer > updateTimeMax)
+    if (inputLog.getKey(window, GLFW_KEY_A) == GLFW_PRESS && timer > updateTimeMax)
     {
         timer = 0.0f;
         camera.ProcessKeyboard(LEFT, deltaTime);
     }
-    if (glfwGetKey(window, GLFW_KEY_D) == GLFW_PRESS && timer > updateTimeMax)
+    if (inputLog.getKey(window, GLFW_KEY_D) == GLFW_PRESS && timer > updateTimeMax)
     {
         timer = 0.0f;
         camera.ProcessKeyboard(RIGHT, deltaTime);
     }
-    if (glfwGetKey(window, GLFW_KEY_R) == GLFW_PRESS && timer > buttonTimeMax)
+    if (inputLog.getKey(window, GLFW_KEY_R) == GLFW_PRESS && timer > buttonTimeMax)
     {
         timer = 0.0f;
         toon = !toon;
         std::cout << "Shading type: " << (toon ? "Toon" : "Blinn-phong") << std::endl;
     }
-    if (glfwGetKey(window, GLFW_KEY_E) == GLFW_PRESS && timer > buttonTimeMax)
+    if (inputLog.getKey(window, GLFW_KEY_E) == GLFW_PRESS && timer > buttonTimeMax)
     {
         timer = 0.0f;
         stencil = !stencil;
         std::cout << "Frame: "<< (stencil ? "On" : "Off") << std::endl;
     }
-    if (glfwGetKey(window, GLFW_KEY_Q) == GLFW_PRESS && timer > buttonTimeMax)
+    if (inputLog.getKey(window, GLFW_KEY_Q) == GLFW_PRESS && timer > buttonTimeMax)
     {
         timer = 0.0f;
         bloom = !bloom;
         std::cout << "Blur: "<< (bloom ? "On" : "Off") << std::endl;
     }
-    if (glfwGetKey(window, GLFW_KEY_T) == GLFW_PRESS && timer > buttonTimeMax)
+    if (inputLog.getKey(window, GLFW_KEY_T) == GLFW_PRESS && timer > buttonTimeMax)
     {
         timer = 0.0f;
         invisible = invisible > 0.1f ? 0.0f : 0.85f;
         std::cout << "Invisible: " << (invisible > 0.0f ? "On" : "Off") << std::endl;
     }
+    if (inputLog.getKey(window, GLFW_KEY_F) == GLFW_PRESS && timer > buttonTimeMax)
+    {
+        timer = 0.0f;
+        dynamicResolution.toggle();
+        std::cout << "Dynamic resolution: " << (dynamicResolution.isEnabled() ? "On" : "Off") << std::endl;
+    }
+    if (inputLog.getKey(window, GLFW_KEY_P) == GLFW_PRESS && timer > buttonTimeMax)
+    {
+        timer = 0.0f;
+        if (gpuProfiler.isEnabled())
+        {
+            // show & save what was measured before turning it off
+            gpuProfiler.printTable(std::cout);
+            gpuProfiler.exportCSV("gpu_profile.csv");
+        }
+        gpuProfiler.toggle();
+        std::cout << "GPU profiler: " << (gpuProfiler.isEnabled() ? "On" : "Off") << std::endl;
+    }
 }
 
 
 void mouse_callback(GLFWwindow* window, double xposIn, double yposIn)
 {
+    inputLog.recordCursor(xposIn, yposIn);
+
     float xpos = static_cast<float>(xposIn);
     float ypos = static_cast<float>(yposIn);
 
@@ -563,42 +716,17 @@ void framebuffer_size_callback(GLFWwindow* window, int width, int height)
     glViewport(0, 0, width, height);
 }
 
-myTexture2D loadTextureFromFile(const char* file, bool alpha)
-{
-    // create texture 
-    myTexture2D texture;
-
-    // change format if the image has the alpha channel
-    if (alpha)
-    {
-        texture.internalFormat = GL_RGBA;
-        texture.imageFormat = GL_RGBA;
-    }
-
-    // load image
-    int width, height, numChannels;
-    stbi_set_flip_vertically_on_load(true); // preventing from upside down
-    unsigned char* data = stbi_load(file, &width, &height, &numChannels, 0);
-
-    // error check
-    if (!data) std::cout << "load fail, file: " << file << std::endl;
-
-    // generate texture
-    texture.generate(width, height, data);
-
-    // free image data
-    stbi_image_free(data);
-    return texture;
-}
-
 void mouse_button_callback(GLFWwindow* window, int button, int action, int mods)
 {
+    inputLog.recordButton(button, action, mods);
+
     if (button == GLFW_MOUSE_BUTTON_LEFT && action != mouseState)
     {
         mouseState = action;
         if (action == GLFW_PRESS)
         {
             trackball.refreshScreenCoord(mousePosX, mousePosY);
+            pickRequested = true;
         }
     }
 }
@@ -607,5 +735,7 @@ void mouse_button_callback(GLFWwindow* window, int button, int action, int mods)
 // ----------------------------------------------------------------------
 void scroll_callback(GLFWwindow* window, double xoffset, double yoffset)
 {
+    inputLog.recordScroll(xoffset, yoffset);
+
     camera.ProcessMouseScroll(static_cast<float>(yoffset));
 }
\ No newline at end of file
@@ -1,4 +1,5 @@
 #include "my_texture_2d.h"
+#include "TextureCache.h"
 
 myTexture2D::myTexture2D() 
     : width(0), height(0), internalFormat(GL_RGB), imageFormat(GL_RGB), wrapS(GL_REPEAT), wrapT(GL_REPEAT), filterMin(GL_LINEAR), filterMax(GL_LINEAR)
@@ -6,6 +7,11 @@ myTexture2D::myTexture2D()
     glGenTextures(1, &this->textureID);
 }
 
+myTexture2D::myTexture2D(unsigned int _textureID)
+    : textureID(_textureID), height(0), width(0), internalFormat(GL_RGB), imageFormat(GL_RGB), wrapS(GL_REPEAT), wrapT(GL_REPEAT), filterMin(GL_LINEAR), filterMax(GL_LINEAR)
+{
+}
+
 void myTexture2D::generate(unsigned int _width, unsigned int _height, unsigned char* data)
 {
     // assign width & height
@@ -29,4 +35,6 @@ void myTexture2D::generate(unsigned int _width, unsigned int _height, unsigned c
 void myTexture2D::bind()
 {
     glBindTexture(GL_TEXTURE_2D, this->textureID);
+    // keeps it resident (and restores it if the budget shrank it)
+    TextureCache::instance().touch(this->textureID);
 }
@@ -7,6 +7,8 @@ class myTexture2D
 {
 public:
 	myTexture2D();
+	// wraps an existing texture (no new GL texture)
+	explicit myTexture2D(unsigned int _textureID);
 
 	// generate texture data
 	void generate(unsigned int _width, unsigned int _height, unsigned char* data);